@@ -1,6 +1,9 @@
 #include "AnalyticsService.h"
 #include <ctime>
 
+#define FLUSH_TIMEOUT_MS 10000
+#define FLUSH_MAX_REDIRECTS 2
+
 // Anonymous namespace: helpers used only within this .cpp file 
 namespace
 {
@@ -49,15 +52,6 @@ namespace
                                        utcTime.tm_sec,
                                        millisPart);
     }
-
-    /// HTTP options for POST request: 10s timeout, 2 redirects, capture status code 
-    juce::URL::InputStreamOptions makeDefaultOptions(int* statusCode)
-    {
-        return juce::URL::InputStreamOptions(juce::URL::ParameterHandling::inAddress)
-            .withConnectionTimeoutMs(10'000)
-            .withNumRedirectsToFollow(2)
-            .withStatusCode(statusCode);
-    }
 }
 
 AnalyticsService::AnalyticsService()
@@ -276,15 +270,12 @@ void AnalyticsService::flushOnBackgroundThread()
 
     // Create JSON-formatted string and send to API via HTTP POST request 
     juce::String json = juce::JSON::toString(juce::var(payload.get()));
-    juce::URL url(endpoint);
-    url = url.withPOSTData(json);
 
     int status = 0;
     juce::String headers = "Content-Type: application/json\r\n";
 
-    auto options = makeDefaultOptions(&status).withExtraHeaders(headers);
-
-    std::unique_ptr<juce::InputStream> stream(url.createInputStream(options));
+    // Shared client, so uploads go through the same request path as generation 
+    std::unique_ptr<juce::InputStream> stream(httpClient->post(endpoint, json, headers, FLUSH_TIMEOUT_MS, FLUSH_MAX_REDIRECTS, &status));
     if (stream == nullptr)
         return;  // Network error; events stay in file, will retry next flush
 
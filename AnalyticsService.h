@@ -1,6 +1,7 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "HttpClient.h"
 
 /**
  * AnalyticsService - Event tracking for the Kiwi plugin.
@@ -49,5 +50,7 @@ private:
 
     int eventCount = 0; 
 
+    juce::SharedResourcePointer<HttpClient> httpClient; /// Shared with the Generator
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AnalyticsService)
 };
@@ -1,14 +1,17 @@
 #pragma once
 #include <JuceHeader.h>
+#include "NoteSpec.h"
+#include "MidiExport.h"
 
 struct ChatEntry
 {
     juce::String prompt;
     juce::String response;
-    juce::File midiFile;
+    MidiExportPtr midiExport; // The entry's MIDI file, written to the store when dragged out and referenced while the entry lives; null if there is none
     juce::Time timestamp;
+    NoteSpecArray notes; // The generated notes, kept so they can be sent back as compact context
     
-    ChatEntry(const juce::String& p, const juce::String& r, const juce::File& f)
-        : prompt(p), response(r), midiFile(f), timestamp(juce::Time::getCurrentTime())
+    ChatEntry(const juce::String& p, const juce::String& r, MidiExportPtr m, NoteSpecArray n = nullptr)
+        : prompt(p), response(r), midiExport(std::move(m)), timestamp(juce::Time::getCurrentTime()), notes(std::move(n))
     {}
 };
\ No newline at end of file
@@ -1,14 +1,19 @@
 #include "ChatHistoryComponent.h"
 
+#define CHAT_PAGE_SIZE 50       // Entries fetched from the history at a time
+#define MAX_LOADED_ENTRIES 200  // New entries push the oldest loaded ones out past this; scrolling up brings them back
+
 ChatHistoryComponent::ChatHistoryComponent()
 {
     viewport.setViewedComponent(&container, false);
     viewport.setScrollBarsShown(true, false);
+    viewport.getVerticalScrollBar().addListener(this);
     addAndMakeVisible(viewport);
 }
 
 ChatHistoryComponent::~ChatHistoryComponent()
 {
+    viewport.getVerticalScrollBar().removeListener(this);
     container.deleteAllChildren();
 }
 
@@ -17,20 +22,151 @@ void ChatHistoryComponent::addChatEntry(const ChatEntry& entry)
     // Ensure we're on the message thread when modifying the component hierarchy
     jassert(juce::MessageManager::getInstance()->isThisTheMessageThread());
     
-    // Limit to 10 entries
-    if (entries.size() >= 10)
-        entries.erase(entries.begin());
-    
+    // A window scrolled back into older pages jumps back to the newest entries, which the new one follows
+    if (lastLoadedIndex < historySize)
+        loadNewestEntries(CHAT_PAGE_SIZE - 1);
+
+    historySize++;
     entries.push_back(entry);
+    lastLoadedIndex = historySize;
+
+    // Keep the loaded window bounded; the entries pushed out stay in the history
+    while (entries.size() > MAX_LOADED_ENTRIES)
+    {
+        entries.pop_front();
+        firstLoadedIndex++;
+    }
+    
     rebuildChatView();
 }
 
-void ChatHistoryComponent::loadFromHistory(const std::vector<ChatEntry>& history)
+/**
+ * @brief Replaces an entry where it stands. An entry outside the loaded window is left to the page source 
+ * @param entryIndex History index of the entry, 0 being the oldest
+ * @param entry The entry that takes its place
+ */
+void ChatHistoryComponent::replaceChatEntry(int entryIndex, const ChatEntry& entry)
 {
-    entries = history;
+    jassert(juce::MessageManager::getInstance()->isThisTheMessageThread());
+
+    if (entryIndex < firstLoadedIndex || entryIndex >= lastLoadedIndex)
+        return;
+
+    entries[(size_t) (entryIndex - firstLoadedIndex)] = entry;
+
+    // A view following the newest entries keeps following them; one scrolled back stays where it is
+    const bool atBottom = viewport.getViewPositionY() + viewport.getViewHeight() >= container.getHeight() - 1;
+    rebuildChatView(atBottom);
+}
+
+/**
+ * @brief Shows the newest page of a history 
+ * @param numEntries Number of entries in the whole history
+ * @param source Decodes pages of the history, e.g. from the processor's ChatHistoryStore
+ */
+void ChatHistoryComponent::loadFromHistory(int numEntries, PageSource source)
+{
+    pageSource = std::move(source);
+    historySize = numEntries;
+    loadNewestEntries(CHAT_PAGE_SIZE);
     rebuildChatView();
 }
 
+/**
+ * @brief Replaces the loaded window with the newest entries of the history 
+ * @param count How many entries to load
+ */
+void ChatHistoryComponent::loadNewestEntries(int count)
+{
+    firstLoadedIndex = juce::jmax(0, historySize - count);
+    lastLoadedIndex = firstLoadedIndex;
+
+    entries.clear();
+    if (pageSource != nullptr)
+        for (auto& entry : pageSource(firstLoadedIndex, historySize - firstLoadedIndex))
+            entries.push_back(std::move(entry));
+
+    lastLoadedIndex = firstLoadedIndex + (int) entries.size();
+}
+
+/**
+ * @brief Prepends the page before the loaded window and drops the newest entries past the window's limit, keeping the
+ *        entries on screen where they were 
+ */
+void ChatHistoryComponent::loadEarlierPage()
+{
+    if (pageSource == nullptr || firstLoadedIndex <= 0 || loadingPage || container.getNumChildComponents() == 0)
+        return;
+
+    const juce::ScopedValueSetter<bool> loading(loadingPage, true);
+
+    const int first = juce::jmax(0, firstLoadedIndex - CHAT_PAGE_SIZE);
+    auto page = pageSource(first, firstLoadedIndex - first);
+    firstLoadedIndex = first;
+    entries.insert(entries.begin(), page.begin(), page.end());
+
+    while (entries.size() > MAX_LOADED_ENTRIES)
+    {
+        entries.pop_back();
+        lastLoadedIndex--;
+    }
+
+    // The entry that was at the top stays put
+    keepEntryInView((int) page.size(), container.getChildComponent(0)->getY(), viewport.getViewPositionY());
+}
+
+/**
+ * @brief Appends the page after the loaded window and drops the oldest entries past the window's limit, keeping the
+ *        entries on screen where they were 
+ */
+void ChatHistoryComponent::loadLaterPage()
+{
+    if (pageSource == nullptr || lastLoadedIndex >= historySize || loadingPage || container.getNumChildComponents() == 0)
+        return;
+
+    const juce::ScopedValueSetter<bool> loading(loadingPage, true);
+
+    const int anchorBefore = container.getNumChildComponents() - 1;
+    const int anchorY = container.getChildComponent(anchorBefore)->getY();
+
+    auto page = pageSource(lastLoadedIndex, juce::jmin(CHAT_PAGE_SIZE, historySize - lastLoadedIndex));
+    lastLoadedIndex += (int) page.size();
+    entries.insert(entries.end(), page.begin(), page.end());
+
+    int numDropped = 0;
+    while (entries.size() > MAX_LOADED_ENTRIES)
+    {
+        entries.pop_front();
+        firstLoadedIndex++;
+        numDropped++;
+    }
+
+    // The entry that was at the bottom stays put
+    keepEntryInView(anchorBefore - numDropped, anchorY, viewport.getViewPositionY());
+}
+
+/**
+ * @brief Rebuilds the view after the loaded window changed, scrolling so that one entry stays where it was on screen 
+ * @param anchorIndex Index of the entry among the loaded entries after the change
+ * @param anchorY Its position in the container before the change
+ * @param viewY The view position before the change
+ */
+void ChatHistoryComponent::keepEntryInView(int anchorIndex, int anchorY, int viewY)
+{
+    rebuildChatView(false);
+
+    if (auto* anchor = container.getChildComponent(anchorIndex))
+        viewport.setViewPosition(0, viewY + anchor->getY() - anchorY);
+}
+
+void ChatHistoryComponent::scrollBarMoved(juce::ScrollBar*, double newRangeStart)
+{
+    if (newRangeStart <= 0.0)
+        loadEarlierPage();
+    else if (newRangeStart + viewport.getViewHeight() >= container.getHeight() - 1)
+        loadLaterPage();
+}
+
 void ChatHistoryComponent::setOnMidiDragged(std::function<void(const ChatEntry&)> callback)
 {
     onMidiDraggedCallback = std::move(callback);
@@ -47,7 +183,7 @@ void ChatHistoryComponent::resized()
     rebuildChatView(); // Rebuild with correct width
 }
 
-void ChatHistoryComponent::rebuildChatView()
+void ChatHistoryComponent::rebuildChatView(bool scrollToBottom)
 {
     // Must be called from message thread since we're modifying component hierarchy
     jassert(juce::MessageManager::getInstance()->isThisTheMessageThread());
@@ -85,7 +221,8 @@ void ChatHistoryComponent::rebuildChatView()
     
     updateContainerSize();
     // Scroll to bottom to show most recent
-    viewport.setViewPosition(0, juce::jmax(0, container.getHeight() - viewport.getHeight()));
+    if (scrollToBottom)
+        viewport.setViewPosition(0, juce::jmax(0, container.getHeight() - viewport.getHeight()));
 }
 
 void ChatHistoryComponent::updateContainerSize()
@@ -126,23 +263,28 @@ void ChatHistoryComponent::ChatEntryComponent::paint(juce::Graphics& g)
     y += promptHeight + 20;
     
     // Draw MIDI file info below the bubble
-    if (entry.midiFile.existsAsFile())
+    if (entry.midiExport != nullptr)
     {
         g.setColour(juce::Colours::black);
         juce::Font midiFont (getLookAndFeel().getTypefaceForFont (juce::Font()));
         midiFont.setHeight(10.0f);
         midiFont.setItalic(true);
         g.setFont(midiFont);
-        g.drawText("MIDI: " + entry.midiFile.getFileName(), padding + 5, y, getWidth() - 2 * padding, 15, juce::Justification::left);
+        g.drawText("MIDI: " + entry.midiExport->getFile().getFileName(), padding + 5, y, getWidth() - 2 * padding, 15, juce::Justification::left);
     }
 }
 
 void ChatHistoryComponent::ChatEntryComponent::mouseDrag(const juce::MouseEvent& e)
 {
-    if (entry.midiFile.existsAsFile() && e.mouseWasDraggedSinceMouseDown())
+    if (entry.midiExport != nullptr && e.mouseWasDraggedSinceMouseDown())
     {
+        // Written now, before the OS drag starts, so the host never sees a missing or partial file 
+        const auto midiFile = entry.midiExport->materialise();
+        if (midiFile == juce::File())
+            return;
+
         juce::StringArray files;
-        files.add(entry.midiFile.getFullPathName());
+        files.add(midiFile.getFullPathName());
         juce::DragAndDropContainer::performExternalDragDropOfFiles(files, true);
 
         if (onMidiDragged)
@@ -154,7 +296,7 @@ int ChatHistoryComponent::ChatEntryComponent::getIdealHeight(int width) const
 {
     int height = 20; // Top padding
     height += getTextHeight(entry.prompt, width) + 10; // Prompt bubble
-    if (entry.midiFile.existsAsFile())
+    if (entry.midiExport != nullptr)
         height += 25; // MIDI file info
     height += 10; // Bottom padding
     return height;
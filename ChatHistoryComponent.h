@@ -2,22 +2,38 @@
 #include <JuceHeader.h>
 #include "ChatEntry.h"
 #include <functional>
+#include <deque>
 
-class ChatHistoryComponent : public juce::Component
+class ChatHistoryComponent : public juce::Component,
+                             private juce::ScrollBar::Listener
 {
 public:
+    /// Decodes up to count entries of the full history starting at first, oldest first
+    using PageSource = std::function<std::vector<ChatEntry>(int first, int count)>;
+
     ChatHistoryComponent();
     ~ChatHistoryComponent();
     
     void addChatEntry(const ChatEntry& entry);
-    void loadFromHistory(const std::vector<ChatEntry>& history);
+
+    /// Replace the entry at a history index, e.g. a local draft with its refined result
+    void replaceChatEntry(int entryIndex, const ChatEntry& entry);
+
+    /// Show the newest page of a history. Earlier and later pages are fetched from source when the view is scrolled
+    /// to the top or bottom, keeping at most a bounded window of entries loaded
+    void loadFromHistory(int historySize, PageSource source);
     void setOnMidiDragged(std::function<void(const ChatEntry&)> callback);
     void paint(juce::Graphics& g) override;
     void resized() override;
     
 private:
-    void rebuildChatView();
+    void rebuildChatView(bool scrollToBottom = true);
     void updateContainerSize();
+    void loadEarlierPage();
+    void loadLaterPage();
+    void loadNewestEntries(int count);
+    void keepEntryInView(int anchorIndex, int anchorY, int viewY);
+    void scrollBarMoved(juce::ScrollBar* scrollBar, double newRangeStart) override;
     
     class ChatEntryComponent : public juce::Component
     {
@@ -34,7 +50,12 @@ private:
         std::function<void(const ChatEntry&)> onMidiDragged;
     };
     
-    std::vector<ChatEntry> entries;
+    std::deque<ChatEntry> entries; // The loaded window of the history
+    int firstLoadedIndex = 0;      // History index of entries.front()
+    int lastLoadedIndex = 0;       // History index just past entries.back()
+    int historySize = 0;           // Entries in the whole history, loaded or not
+    PageSource pageSource;
+    bool loadingPage = false;
     juce::Viewport viewport;
     juce::Component container;
 
@@ -0,0 +1,351 @@
+#include "ChatHistoryStore.h"
+
+#define LOG_FILE_EXTENSION ".log"
+#define RECORD_LENGTH_BYTES 4
+#define STALE_LOG_DAYS 7 // Logs left behind by a crash are removed once they haven't been touched for this long
+
+ChatHistoryStore::ChatHistoryStore(ExportFactory exportFactory)
+    : makeExport(std::move(exportFactory))
+{
+    openLog();
+}
+
+ChatHistoryStore::~ChatHistoryStore()
+{
+    releaseAll();
+    log.reset();
+    logFile.deleteFile();
+}
+
+/**
+ * @brief Creates this store's log file, clearing out logs that earlier sessions failed to delete
+ */
+void ChatHistoryStore::openLog()
+{
+    auto dir = juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+                   .getChildFile("KiwiPlugin")
+                   .getChildFile("chat_history");
+    dir.createDirectory();
+
+    const auto staleBefore = juce::Time::getCurrentTime() - juce::RelativeTime::days(STALE_LOG_DAYS);
+    for (const auto& staleLog : dir.findChildFiles(juce::File::findFiles, false, "*" LOG_FILE_EXTENSION))
+        if (staleLog.getLastModificationTime().toMilliseconds() < staleBefore.toMilliseconds())
+            staleLog.deleteFile();
+
+    logFile = dir.getChildFile(juce::Uuid().toString() + LOG_FILE_EXTENSION);
+    log = std::make_unique<juce::FileOutputStream>(logFile);
+
+    if (log->failedToOpen())
+    {
+        DBG("Failed to open chat history log, keeping history in memory: " + logFile.getFullPathName());
+        log.reset();
+    }
+}
+
+/**
+ * @brief Appends an entry: one write to the end of the log and one index record, whatever the history's length
+ * @param entry The entry; its notes and MIDI export are remembered for as long as something else holds them
+ */
+void ChatHistoryStore::append(const ChatEntry& entry)
+{
+    PluginState::Entry parsed;
+    juce::int64 recordOffset = 0;
+    if (! appendRecord(entry, parsed, recordOffset))
+        return;
+
+    addToIndex(parsed, recordOffset);
+
+    index.back().notes = entry.notes;
+    index.back().midiExport = entry.midiExport;
+}
+
+/**
+ * @brief Replaces an entry, e.g. a local draft with its refined result. The log is never rewritten: the new record is
+ *        appended and the entry's index record points at it, leaving the old record unused
+ * @param entryIndex Index of the entry, 0 being the oldest
+ * @param entry The entry that takes its place
+ */
+void ChatHistoryStore::replace(int entryIndex, const ChatEntry& entry)
+{
+    jassert(entryIndex >= 0 && entryIndex < size());
+    if (entryIndex < 0 || entryIndex >= size())
+        return;
+
+    PluginState::Entry parsed;
+    juce::int64 recordOffset = 0;
+    if (! appendRecord(entry, parsed, recordOffset))
+        return;
+
+    auto& indexEntry = index[(size_t) entryIndex];
+    auto replacement = makeIndexEntry(parsed, recordOffset);
+    replacement.notes = entry.notes;
+    replacement.midiExport = entry.midiExport;
+
+    holdMidiFile(indexEntry, {});
+    indexEntry = std::move(replacement);
+    numUnusedRecords++;
+}
+
+/**
+ * @brief Decodes a page of the history, e.g. the entries the chat view shows
+ * @param first Index of the first entry, 0 being the oldest
+ * @param count Maximum number of entries
+ * @return The entries, oldest first; fewer than count at the end of the history
+ */
+std::vector<ChatEntry> ChatHistoryStore::getPage(int first, int count) const
+{
+    std::vector<ChatEntry> page;
+    first = juce::jlimit(0, size(), first);
+    const int end = juce::jlimit(first, size(), first + count);
+    page.reserve((size_t) (end - first));
+
+    // One flush and one open for the whole page; its records follow each other in the log, so reads mostly move forward
+    auto logIn = openLogForReading();
+    if (log != nullptr && logIn == nullptr)
+        return page;
+
+    juce::MemoryBlock record;
+    for (int i = first; i < end; ++i)
+    {
+        const auto& indexEntry = index[(size_t) i];
+
+        record.setSize(indexEntry.recordBytes);
+        PluginState::Entry entry;
+        juce::MemoryInputStream in(record, false);
+        if (! readFromLog(indexEntry.recordOffset, record.getData(), record.getSize(), logIn.get())
+            || ! PluginState::readEntry(in, entry))
+        {
+            DBG("Unreadable chat history record " + juce::String(i));
+            continue;
+        }
+
+        auto notes = indexEntry.notes.lock();
+        if (notes == nullptr && entry.numNotes > 0)
+        {
+            juce::MemoryInputStream notesIn(static_cast<const char*>(record.getData()) + entry.recordOffset + entry.notesOffset,
+                                            (size_t) entry.numNotes * NoteSpecs::packedNoteBytes, false);
+            notes = NoteSpecs::fromVector(NoteSpecs::readPacked(notesIn, entry.numNotes));
+            indexEntry.notes = notes;
+        }
+
+        auto midiExport = indexEntry.midiExport.lock();
+        if (midiExport == nullptr && indexEntry.hasMidiFile && makeExport != nullptr)
+        {
+            midiExport = makeExport(notes);
+            indexEntry.midiExport = midiExport;
+        }
+
+        // An export rebuilt with different part names has a different key; the entry's reference follows it
+        if (midiExport != nullptr)
+            holdMidiFile(indexEntry, midiExport->getKey());
+
+        ChatEntry chatEntry(entry.prompt, entry.response, midiExport, notes);
+        chatEntry.timestamp = entry.timestamp;
+        page.push_back(std::move(chatEntry));
+    }
+
+    return page;
+}
+
+NoteSpecArray ChatHistoryStore::getNotes(int entryIndex) const
+{
+    const auto& indexEntry = index[(size_t) entryIndex];
+    if (auto notes = indexEntry.notes.lock())
+        return notes;
+
+    if (indexEntry.numNotes <= 0)
+        return nullptr;
+
+    juce::MemoryBlock packed((size_t) indexEntry.numNotes * NoteSpecs::packedNoteBytes);
+    if (! readFromLog(indexEntry.notesOffset, packed.getData(), packed.getSize()))
+        return nullptr;
+
+    juce::MemoryInputStream in(packed, false);
+    NoteSpecArray notes = NoteSpecs::fromVector(NoteSpecs::readPacked(in, indexEntry.numNotes));
+    indexEntry.notes = notes;
+    return notes;
+}
+
+/**
+ * @brief Copies the log into a saved state. The log already holds PluginState records, so nothing is decoded
+ * @param out Stream positioned just after PluginState::writeHeader
+ */
+void ChatHistoryStore::writeRecords(juce::OutputStream& out) const
+{
+    // Replaced entries left unused records behind: only the records the index points at are saved, in history order
+    if (numUnusedRecords > 0)
+    {
+        auto logIn = openLogForReading();
+        juce::MemoryBlock record;
+        for (const auto& indexEntry : index)
+        {
+            record.setSize(indexEntry.recordBytes);
+            if (readFromLog(indexEntry.recordOffset, record.getData(), record.getSize(), logIn.get()))
+                out.write(record.getData(), record.getSize());
+        }
+        return;
+    }
+
+    if (log == nullptr)
+    {
+        out.write(memoryLog.getData(), (size_t) logSize);
+        return;
+    }
+
+    log->flush();
+    juce::FileInputStream in(logFile);
+    if (in.openedOk())
+        out.writeFromInputStream(in, logSize);
+}
+
+/**
+ * @brief Replaces the history with a saved one. The records are copied into the log in one write and indexed from
+ *        the headers PluginState already read; no notes are decoded
+ * @param state A state that read successfully
+ */
+void ChatHistoryStore::restore(const PluginState& state)
+{
+    releaseAll();
+    index.clear();
+    memoryLog.reset();
+    logSize = 0;
+    numUnusedRecords = 0;
+
+    if (log != nullptr)
+    {
+        log->setPosition(0);
+        log->truncate();
+    }
+
+    const auto recordsStart = state.getRecordsStart();
+    appendToLog(static_cast<const char*>(state.getData().getData()) + recordsStart, state.getRecordsEnd() - recordsStart);
+
+    index.reserve(state.getEntries().size());
+    for (const auto& entry : state.getEntries())
+        addToIndex(entry, (juce::int64) (entry.recordOffset - RECORD_LENGTH_BYTES - recordsStart));
+}
+
+/**
+ * @brief Encodes an entry and appends its record to the log
+ * @param parsed Filled in with the record's header, as PluginState reads it
+ * @param recordOffset Set to where the record, starting with its length, was appended
+ * @return false if the record couldn't be encoded
+ */
+bool ChatHistoryStore::appendRecord(const ChatEntry& entry, PluginState::Entry& parsed, juce::int64& recordOffset)
+{
+    juce::MemoryOutputStream record;
+    PluginState::writeEntry(record, entry);
+
+    juce::MemoryInputStream in(record.getData(), record.getDataSize(), false);
+    if (! PluginState::readEntry(in, parsed))
+        return false;
+
+    recordOffset = logSize;
+    appendToLog(record.getData(), record.getDataSize());
+    return true;
+}
+
+void ChatHistoryStore::appendToLog(const void* bytes, size_t numBytes)
+{
+    if (log == nullptr || ! log->write(bytes, numBytes))
+    {
+        if (log != nullptr)
+        {
+            DBG("Chat history log write failed, keeping history in memory from now on");
+            log->flush();
+            memoryLog.reset();
+            logFile.loadFileAsData(memoryLog);
+            memoryLog.setSize((size_t) logSize);
+            log.reset();
+            logFile.deleteFile();
+        }
+
+        memoryLog.append(bytes, numBytes);
+    }
+
+    logSize += (juce::int64) numBytes;
+}
+
+/**
+ * @brief Flushes the log and opens it for reading, so several records can be read through one stream
+ * @return The stream, or nullptr if the history is kept in memory or the log can't be opened
+ */
+std::unique_ptr<juce::FileInputStream> ChatHistoryStore::openLogForReading() const
+{
+    if (log == nullptr)
+        return nullptr;
+
+    log->flush();
+    auto logIn = std::make_unique<juce::FileInputStream>(logFile);
+    if (logIn->openedOk())
+        return logIn;
+
+    DBG("Failed to open chat history log: " + logFile.getFullPathName());
+    return nullptr;
+}
+
+/**
+ * @brief Reads bytes back from the log
+ * @param logIn A stream the caller opened on the log after flushing it, or nullptr to flush and open one for this read
+ * @return false if the bytes lie outside the log or can't be read
+ */
+bool ChatHistoryStore::readFromLog(juce::int64 offset, void* dest, size_t numBytes, juce::FileInputStream* logIn) const
+{
+    if (offset < 0 || offset + (juce::int64) numBytes > logSize)
+        return false;
+
+    if (log == nullptr)
+    {
+        memcpy(dest, static_cast<const char*>(memoryLog.getData()) + offset, numBytes);
+        return true;
+    }
+
+    if (logIn != nullptr)
+        return logIn->setPosition(offset) && logIn->read(dest, (int) numBytes) == (int) numBytes;
+
+    log->flush();
+    juce::FileInputStream in(logFile);
+    return in.openedOk() && in.setPosition(offset) && in.read(dest, (int) numBytes) == (int) numBytes;
+}
+
+void ChatHistoryStore::addToIndex(const PluginState::Entry& entry, juce::int64 recordOffset)
+{
+    index.push_back(makeIndexEntry(entry, recordOffset));
+}
+
+ChatHistoryStore::IndexEntry ChatHistoryStore::makeIndexEntry(const PluginState::Entry& entry, juce::int64 recordOffset) const
+{
+    IndexEntry indexEntry;
+    indexEntry.prompt = entry.prompt;
+    indexEntry.recordOffset = recordOffset;
+    indexEntry.recordBytes = RECORD_LENGTH_BYTES + entry.recordBytes;
+    indexEntry.notesOffset = recordOffset + RECORD_LENGTH_BYTES + (juce::int64) entry.notesOffset;
+    indexEntry.numNotes = entry.numNotes;
+    indexEntry.hasMidiFile = entry.hasMidiFile;
+    if (entry.hasMidiFile)
+        holdMidiFile(indexEntry, entry.midiKey);
+
+    return indexEntry;
+}
+
+/**
+ * @brief Points an entry's reference in the MidiFileStore at a key, releasing the one it held before 
+ */
+void ChatHistoryStore::holdMidiFile(const IndexEntry& indexEntry, const juce::String& key) const
+{
+    if (key == indexEntry.midiKey)
+        return;
+
+    if (key.isNotEmpty())
+        midiFiles->retain(key);
+    if (indexEntry.midiKey.isNotEmpty())
+        midiFiles->release(indexEntry.midiKey);
+
+    indexEntry.midiKey = key;
+}
+
+void ChatHistoryStore::releaseAll()
+{
+    for (const auto& indexEntry : index)
+        holdMidiFile(indexEntry, {});
+}
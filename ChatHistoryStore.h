@@ -0,0 +1,88 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "ChatEntry.h"
+#include "PluginState.h"
+#include "MidiFileStore.h"
+
+/**
+ * ChatHistoryStore - Unbounded chat history kept in an append-only log with a small in-memory index.
+ *
+ * Each entry is appended to a log file in %AppData%/KiwiPlugin/chat_history (or equivalent on macOS/Linux) as a
+ * PluginState record, and the index keeps only its prompt and where its record lies. Appending is one write to the
+ * end of the log; nothing is ever erased or moved. Replacing an entry appends its new record and points the index at
+ * it. Entries are decoded back into ChatEntry objects a page at a time, and entries that are still alive elsewhere
+ * (e.g. shown in the editor) are handed out again instead of being decoded twice. Every entry with a MIDI file holds a reference to it in the MidiFileStore for as long as it is in
+ * the history, whether or not it is loaded, so the collector never deletes a file the user can still scroll to and
+ * drag. The log belongs to one processor and is deleted with it; projects keep their history through
+ * writeRecords() and restore(). If the log file can't be created the records are kept in memory instead. Not
+ * thread-safe: the owner locks around every call.
+ */
+class ChatHistoryStore
+{
+public:
+    /// Builds the MIDI export of a decoded entry's notes
+    using ExportFactory = std::function<MidiExportPtr(const NoteSpecArray&)>;
+
+    explicit ChatHistoryStore(ExportFactory exportFactory);
+    ~ChatHistoryStore();
+
+    /// Append an entry to the end of the history
+    void append(const ChatEntry& entry);
+
+    /// Replace an entry in place; later entries keep their indices
+    void replace(int entryIndex, const ChatEntry& entry);
+
+    int size() const { return (int) index.size(); }
+
+    /// Decode up to count entries starting at first, oldest first
+    std::vector<ChatEntry> getPage(int first, int count) const;
+
+    /// The prompt of one entry, from the index
+    const juce::String& getPrompt(int entryIndex) const { return index[(size_t) entryIndex].prompt; }
+
+    /// The notes of one entry, decoded from the log unless they are still alive
+    NoteSpecArray getNotes(int entryIndex) const;
+
+    /// Append every record, oldest first, as saved in a PluginState
+    void writeRecords(juce::OutputStream& out) const;
+
+    /// Replace the history with the records of a saved state, copied as they are
+    void restore(const PluginState& state);
+
+private:
+    struct IndexEntry
+    {
+        juce::String prompt;
+        juce::int64 recordOffset = 0; // Where the record, starting with its length, is in the log
+        size_t recordBytes = 0;       // Including the length
+        juce::int64 notesOffset = 0;  // Where its packed notes are in the log
+        int numNotes = 0;
+        bool hasMidiFile = false;
+        mutable juce::String midiKey; // The MidiFileStore key this entry holds a reference to; empty if none
+        mutable std::weak_ptr<const std::vector<NoteSpec>> notes; // Decoded notes, while anything still holds them
+        mutable std::weak_ptr<MidiExport> midiExport;              // Export of those notes, likewise
+    };
+
+    void openLog();
+    bool appendRecord(const ChatEntry& entry, PluginState::Entry& parsed, juce::int64& recordOffset);
+    void appendToLog(const void* bytes, size_t numBytes);
+    std::unique_ptr<juce::FileInputStream> openLogForReading() const;
+    bool readFromLog(juce::int64 offset, void* dest, size_t numBytes, juce::FileInputStream* logIn = nullptr) const;
+    void addToIndex(const PluginState::Entry& entry, juce::int64 recordOffset);
+    IndexEntry makeIndexEntry(const PluginState::Entry& entry, juce::int64 recordOffset) const;
+    void holdMidiFile(const IndexEntry& indexEntry, const juce::String& key) const;
+    void releaseAll();
+
+    ExportFactory makeExport;
+    juce::SharedResourcePointer<MidiFileStore> midiFiles;
+    std::vector<IndexEntry> index;
+
+    juce::File logFile;
+    std::unique_ptr<juce::FileOutputStream> log;
+    juce::MemoryBlock memoryLog;  /// Used instead of the file when it can't be opened
+    juce::int64 logSize = 0;
+    int numUnusedRecords = 0;     /// Records in the log that replaced entries no longer point at
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ChatHistoryStore)
+};
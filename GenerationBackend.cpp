@@ -0,0 +1,243 @@
+#include "GenerationBackend.h"
+
+#define MAX_CONSECUTIVE_FAILURES 3 // Failures in a row before a backend counts as unhealthy
+#define FAILURE_COOLDOWN_MS 30000  // How long an unhealthy backend is skipped before it is tried again
+#define MIN_ROUTING_SAMPLES 3      // Latency samples needed before a backend is compared with the others
+#define ROUTING_PERCENTILE 0.5
+
+GenerationBackend::GenerationBackend(const juce::String& backendName, const juce::String& backendEndpoint,
+                                     const juce::String& backendModel, const juce::String& key)
+    : name(backendName), endpoint(backendEndpoint), model(backendModel), apiKey(key)
+{
+}
+
+juce::String GenerationBackend::getHeaders() const
+{
+    juce::String headers = "Content-Type: application/json";
+    if (apiKey.isNotEmpty())
+        headers << "\r\nAuthorization: Bearer " << apiKey;
+    return headers;
+}
+
+/**
+ * @brief Records a request that produced a result
+ * @param latencyMs Time from sending the request to its first result
+ */
+void GenerationBackend::recordSuccess(double latencyMs)
+{
+    latency.record(latencyMs);
+    consecutiveFailures = 0;
+}
+
+/**
+ * @brief Records a request that failed to connect, returned an error status or reported a failure mid-stream
+ */
+void GenerationBackend::recordFailure()
+{
+    consecutiveFailures++;
+    lastFailureMs = juce::Time::getMillisecondCounter();
+}
+
+bool GenerationBackend::isHealthy() const
+{
+    if (consecutiveFailures.load() < MAX_CONSECUTIVE_FAILURES)
+        return true;
+
+    return juce::Time::getMillisecondCounter() - lastFailureMs.load() > (juce::uint32) FAILURE_COOLDOWN_MS;
+}
+
+//==============================================================================
+/**
+ * @brief Builds a Responses API body: the instructions and input as one text, and a JSON-object output format
+ */
+juce::String OpenAIResponsesBackend::buildRequestBody(const juce::String& instructions, const juce::String& input, bool streaming) const
+{
+    juce::DynamicObject::Ptr jsonBody = new juce::DynamicObject();
+    jsonBody->setProperty("model", model);
+    jsonBody->setProperty("input", instructions + "\n\n" + input);
+
+    // Create nested JSON object to force API to return a JSON response that can be easily parsed
+    juce::DynamicObject::Ptr formatConfig = new juce::DynamicObject();
+    formatConfig->setProperty("type", "json_object");
+    juce::DynamicObject::Ptr textConfig = new juce::DynamicObject();
+    textConfig->setProperty("format", juce::var(formatConfig.get()));
+    jsonBody->setProperty("text", juce::var(textConfig.get()));
+
+    if (streaming)
+        jsonBody->setProperty("stream", true);
+
+    return juce::JSON::toString(juce::var(jsonBody.get()));
+}
+
+/**
+ * @brief Returns the text of the first message item in a Responses API body
+ */
+juce::String OpenAIResponsesBackend::extractOutputText(const juce::var& response) const
+{
+    if (! response.isObject())
+        return {};
+
+    auto output = response.getDynamicObject()->getProperty("output");
+    if (! output.isArray())
+        return {};
+
+    for (auto& item : *output.getArray())
+    {
+        if (!item.isObject()) continue;
+
+        auto* itemObj = item.getDynamicObject();
+        if (itemObj->getProperty("type").toString() != "message")
+            continue;
+
+        auto contentArr = itemObj->getProperty("content");
+        if (!contentArr.isArray() || contentArr.size() == 0)
+            continue;
+
+        auto first = contentArr[0];
+        if (first.isObject())
+            return first.getDynamicObject()->getProperty("text").toString();
+    }
+
+    return {};
+}
+
+/**
+ * @brief Reads usage.output_tokens from a response body, or from the response inside a response.completed event
+ */
+int OpenAIResponsesBackend::readOutputTokens(const juce::var& responseOrEvent) const
+{
+    const auto& response = responseOrEvent.hasProperty("response") ? responseOrEvent["response"] : responseOrEvent;
+    return (int) response["usage"]["output_tokens"];
+}
+
+bool OpenAIResponsesBackend::readStreamEvent(const juce::var& event, juce::String& delta) const
+{
+    const auto type = event["type"].toString();
+    if (type == "response.output_text.delta")
+        delta << event["delta"].toString();
+
+    return ! (type == "response.failed" || type == "error");
+}
+
+//==============================================================================
+/**
+ * @brief Builds a Chat Completions body: the instructions as the system message and the input as the user message
+ */
+juce::String OpenAICompatibleBackend::buildRequestBody(const juce::String& instructions, const juce::String& input, bool streaming) const
+{
+    juce::DynamicObject::Ptr systemMessage = new juce::DynamicObject();
+    systemMessage->setProperty("role", "system");
+    systemMessage->setProperty("content", instructions);
+
+    juce::DynamicObject::Ptr userMessage = new juce::DynamicObject();
+    userMessage->setProperty("role", "user");
+    userMessage->setProperty("content", input);
+
+    juce::Array<juce::var> messages;
+    messages.add(juce::var(systemMessage.get()));
+    messages.add(juce::var(userMessage.get()));
+
+    juce::DynamicObject::Ptr jsonBody = new juce::DynamicObject();
+    jsonBody->setProperty("model", model);
+    jsonBody->setProperty("messages", messages);
+
+    // Servers that support it constrain sampling to valid JSON; others ignore the field
+    juce::DynamicObject::Ptr formatConfig = new juce::DynamicObject();
+    formatConfig->setProperty("type", "json_object");
+    jsonBody->setProperty("response_format", juce::var(formatConfig.get()));
+
+    if (streaming)
+    {
+        jsonBody->setProperty("stream", true);
+
+        juce::DynamicObject::Ptr streamOptions = new juce::DynamicObject();
+        streamOptions->setProperty("include_usage", true); // So output token counts can be compared across formats
+        jsonBody->setProperty("stream_options", juce::var(streamOptions.get()));
+    }
+
+    return juce::JSON::toString(juce::var(jsonBody.get()));
+}
+
+/**
+ * @brief Returns choices[0].message.content of a Chat Completions body
+ */
+juce::String OpenAICompatibleBackend::extractOutputText(const juce::var& response) const
+{
+    auto choices = response["choices"];
+    if (! choices.isArray() || choices.size() == 0)
+        return {};
+
+    return choices[0]["message"]["content"].toString();
+}
+
+/**
+ * @brief Reads usage.completion_tokens, which streams arrive with in their final chunk when include_usage is set
+ */
+int OpenAICompatibleBackend::readOutputTokens(const juce::var& responseOrEvent) const
+{
+    return (int) responseOrEvent["usage"]["completion_tokens"];
+}
+
+bool OpenAICompatibleBackend::readStreamEvent(const juce::var& event, juce::String& delta) const
+{
+    if (event.hasProperty("error"))
+        return false;
+
+    auto choices = event["choices"];
+    if (choices.isArray() && choices.size() > 0)
+        delta << choices[0]["delta"]["content"].toString();
+
+    return true;
+}
+
+//==============================================================================
+void BackendRouter::addBackend(std::shared_ptr<GenerationBackend> backend)
+{
+    DBG("Generation backend '" + backend->name + "': " + backend->endpoint + (backend->isConfigured() ? "" : " (not configured)"));
+    backends.push_back(std::move(backend));
+}
+
+bool BackendRouter::hasConfiguredBackend() const
+{
+    for (const auto& backend : backends)
+        if (backend->isConfigured())
+            return true;
+
+    return false;
+}
+
+/**
+ * @brief Picks the backend for the next request
+ * @return The pinned backend, an unmeasured healthy backend, or the healthy backend with the lowest median latency.
+ *         nullptr if no backend is configured
+ */
+std::shared_ptr<GenerationBackend> BackendRouter::choose() const
+{
+    std::shared_ptr<GenerationBackend> fastestHealthy, fastestAny;
+
+    for (const auto& backend : backends)
+    {
+        if (! backend->isConfigured())
+            continue;
+
+        if (pinnedBackend.isNotEmpty())
+        {
+            if (backend->name == pinnedBackend)
+                return backend;
+            continue;
+        }
+
+        const auto& latency = backend->getLatency();
+        if (backend->isHealthy() && latency.getNumSamples() < MIN_ROUTING_SAMPLES)
+            return backend; // Measure it before comparing
+
+        const auto medianMs = latency.getPercentile(ROUTING_PERCENTILE);
+        if (fastestAny == nullptr || medianMs < fastestAny->getLatency().getPercentile(ROUTING_PERCENTILE))
+            fastestAny = backend;
+
+        if (backend->isHealthy() && (fastestHealthy == nullptr || medianMs < fastestHealthy->getLatency().getPercentile(ROUTING_PERCENTILE)))
+            fastestHealthy = backend;
+    }
+
+    return fastestHealthy != nullptr ? fastestHealthy : fastestAny;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include "LatencyTracker.h"
+
+/**
+ * GenerationBackend - One remote model service that can turn a prompt into note JSON.
+ *
+ * A backend knows its endpoint, request payload shape, auth headers and how to pull the model's text out of a full
+ * response or a server-sent event. Its configuration is fixed at construction, so worker threads can share it
+ * freely; latency and health are tracked per backend with thread-safe counters so the BackendRouter can compare them.
+ */
+class GenerationBackend
+{
+public:
+    GenerationBackend(const juce::String& name, const juce::String& endpoint, const juce::String& model, const juce::String& apiKey);
+    virtual ~GenerationBackend() = default;
+
+    const juce::String name;        // Short identifier for logs and analytics, e.g. "openai" or "local"
+    const juce::String endpoint;
+    const juce::String model;
+
+    /// False if the backend is missing something it needs to be asked at all (e.g. an API key)
+    virtual bool isConfigured() const { return endpoint.isNotEmpty(); }
+
+    /// Serialised request body for the fixed instructions and the per-request input (context plus prompt)
+    virtual juce::String buildRequestBody(const juce::String& instructions, const juce::String& input, bool streaming) const = 0;
+
+    /// Header lines for HttpClient::post, separated by "\r\n"
+    virtual juce::String getHeaders() const;
+
+    /// The model's text in a parsed complete (non-streamed) response body, or an empty string if there is none
+    virtual juce::String extractOutputText(const juce::var& response) const = 0;
+
+    /// Output tokens reported in a parsed response body or stream event, or 0 if it carries no usage
+    virtual int readOutputTokens(const juce::var& responseOrEvent) const = 0;
+
+    /// Reads one server-sent event, appending any model text to delta. Returns false if the event reports a failure
+    virtual bool readStreamEvent(const juce::var& event, juce::String& delta) const = 0;
+
+    //==============================================================================
+    void recordSuccess(double latencyMs);
+    void recordFailure();
+
+    /// Healthy unless the last few requests all failed; a failing backend is tried again after a cool-down
+    bool isHealthy() const;
+
+    LatencyTracker& getLatency() { return latency; }
+    const LatencyTracker& getLatency() const { return latency; }
+
+protected:
+    const juce::String apiKey;
+
+private:
+    LatencyTracker latency;                          /// Time to first result of successful requests
+    std::atomic<int> consecutiveFailures { 0 };
+    std::atomic<juce::uint32> lastFailureMs { 0 };  /// Millisecond counter at the most recent failure
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GenerationBackend)
+};
+
+/**
+ * OpenAIResponsesBackend - OpenAI's Responses API (/v1/responses) with a JSON-object text format.
+ */
+class OpenAIResponsesBackend : public GenerationBackend
+{
+public:
+    using GenerationBackend::GenerationBackend;
+
+    bool isConfigured() const override { return GenerationBackend::isConfigured() && apiKey.isNotEmpty(); }
+    juce::String buildRequestBody(const juce::String& instructions, const juce::String& input, bool streaming) const override;
+    juce::String extractOutputText(const juce::var& response) const override;
+    int readOutputTokens(const juce::var& responseOrEvent) const override;
+    bool readStreamEvent(const juce::var& event, juce::String& delta) const override;
+};
+
+/**
+ * OpenAICompatibleBackend - Any server speaking the Chat Completions API (/v1/chat/completions), such as a
+ * llama.cpp, vLLM or Ollama server on localhost. The API key is optional.
+ */
+class OpenAICompatibleBackend : public GenerationBackend
+{
+public:
+    using GenerationBackend::GenerationBackend;
+
+    juce::String buildRequestBody(const juce::String& instructions, const juce::String& input, bool streaming) const override;
+    juce::String extractOutputText(const juce::var& response) const override;
+    int readOutputTokens(const juce::var& responseOrEvent) const override;
+    bool readStreamEvent(const juce::var& event, juce::String& delta) const override;
+};
+
+/**
+ * BackendRouter - Picks the backend for each request.
+ *
+ * Routes to the healthy backend with the lowest median latency. Backends with too few samples to compare are tried
+ * first, in registration order, so every backend gets measured. If none is healthy the lowest-latency configured
+ * backend is still used rather than failing outright. A backend can also be pinned by name.
+ */
+class BackendRouter
+{
+public:
+    void addBackend(std::shared_ptr<GenerationBackend> backend);
+
+    /// Route by latency (empty name) or always use the named backend if it is configured
+    void setPinnedBackend(const juce::String& backendName) { pinnedBackend = backendName; }
+
+    /// The backend for the next request, or nullptr if none is configured
+    std::shared_ptr<GenerationBackend> choose() const;
+
+    bool hasConfiguredBackend() const;
+    const std::vector<std::shared_ptr<GenerationBackend>>& getBackends() const { return backends; }
+
+private:
+    std::vector<std::shared_ptr<GenerationBackend>> backends;
+    juce::String pinnedBackend;
+};
@@ -0,0 +1,197 @@
+#include "GenerationCache.h"
+
+#define CACHE_FILE_MAGIC 0x32434e4b // "KNC2"; "KNC1" entries had no channel and are regenerated
+#define CACHE_FILE_EXTENSION ".notes"
+#define CACHE_HEADER_BYTES 8        // Magic + note count
+
+// Anonymous namespace: helpers used only within this .cpp file 
+namespace
+{
+    /// 64-bit FNV-1a over UTF-8 bytes, with a separator so ("ab","c") and ("a","bc") hash differently
+    void hashString(juce::uint64& hash, const juce::String& text)
+    {
+        const auto* bytes = reinterpret_cast<const juce::uint8*>(text.toRawUTF8());
+        const auto numBytes = text.getNumBytesAsUTF8();
+
+        for (size_t i = 0; i <= numBytes; ++i) // Includes the null terminator as the separator
+        {
+            hash ^= (i < numBytes ? bytes[i] : 0);
+            hash *= 0x100000001b3ULL;
+        }
+    }
+}
+
+GenerationCache::GenerationCache()
+{
+    auto configuredMaxBytes = juce::SystemStats::getEnvironmentVariable("KIWI_CACHE_MAX_BYTES", "").getLargeIntValue();
+    if (configuredMaxBytes > 0)
+        maxBytes = configuredMaxBytes;
+
+    loadIndex();
+}
+
+/**
+ * @brief Builds the cache key for a generation request 
+ * @param instructions The system instructions sent with the prompt
+ * @param model The model identifier
+ * @param prompt The user's prompt
+ * @param recentPrompts Previous prompts sent as context
+ * @return Hex string of a stable 64-bit hash of all inputs
+ */
+juce::String GenerationCache::makeKey(const juce::String& instructions,
+                                      const juce::String& model,
+                                      const juce::String& prompt,
+                                      const juce::StringArray& recentPrompts)
+{
+    juce::uint64 hash = 0xcbf29ce484222325ULL;
+    hashString(hash, instructions);
+    hashString(hash, model);
+    hashString(hash, prompt.trim());
+
+    for (const auto& recentPrompt : recentPrompts)
+        hashString(hash, recentPrompt.trim());
+
+    return juce::String::toHexString((juce::int64) hash).paddedLeft('0', 16);
+}
+
+/**
+ * @brief Get the directory that holds the cache entries, ensuring it exists
+ * @return juce::File representing the cache directory
+ */
+juce::File GenerationCache::getCacheDir() const
+{
+    auto dir = juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+                   .getChildFile("KiwiPlugin")
+                   .getChildFile("generation_cache");
+    dir.createDirectory();
+    return dir;
+}
+
+juce::File GenerationCache::getEntryFile(const juce::String& key) const
+{
+    return getCacheDir().getChildFile(key + CACHE_FILE_EXTENSION);
+}
+
+void GenerationCache::loadIndex()
+{
+    const juce::ScopedLock scopedLock(lock);
+
+    index.clear();
+    totalBytes = 0;
+
+    for (const auto& file : getCacheDir().findChildFiles(juce::File::findFiles, false, "*" CACHE_FILE_EXTENSION))
+    {
+        const auto size = file.getSize();
+        index[file.getFileNameWithoutExtension()] = { size, file.getLastModificationTime().toMilliseconds() };
+        totalBytes += size;
+    }
+
+    evictLeastRecentlyUsed();
+}
+
+/**
+ * @brief Looks up a cached generation, decoding it from a memory-mapped entry file 
+ * @param key Key produced by makeKey
+ * @return The cached notes, or nullptr if there is no valid entry for the key
+ */
+NoteSpecArray GenerationCache::lookup(const juce::String& key)
+{
+    const juce::ScopedLock scopedLock(lock);
+
+    auto entry = index.find(key);
+    if (entry == index.end())
+    {
+        misses++;
+        return nullptr;
+    }
+
+    auto file = getEntryFile(key);
+    juce::MemoryMappedFile mappedFile(file, juce::MemoryMappedFile::readOnly);
+
+    const auto* data = static_cast<const char*>(mappedFile.getData());
+    const auto size = mappedFile.getSize();
+
+    std::vector<NoteSpec> notes;
+    bool valid = data != nullptr && size >= CACHE_HEADER_BYTES;
+
+    if (valid)
+    {
+        juce::MemoryInputStream in(data, size, false);
+        const int magic = in.readInt();
+        const int noteCount = in.readInt();
+
+        valid = magic == CACHE_FILE_MAGIC
+             && noteCount >= 0
+             && (size_t) noteCount * NoteSpecs::packedNoteBytes == size - CACHE_HEADER_BYTES;
+
+        if (valid)
+            notes = NoteSpecs::readPacked(in, noteCount);
+    }
+
+    if (! valid)
+    {
+        // Truncated or foreign file: drop it so it is regenerated next time
+        DBG("Discarding invalid cache entry: " + file.getFullPathName());
+        totalBytes -= entry->second.sizeBytes;
+        index.erase(entry);
+        file.deleteFile();
+        misses++;
+        return nullptr;
+    }
+
+    // Mark as most recently used, in memory and on disk so recency survives restarts
+    const auto now = juce::Time::getCurrentTime();
+    entry->second.lastAccessMs = now.toMilliseconds();
+    file.setLastModificationTime(now);
+
+    hits++;
+    return NoteSpecs::fromVector(std::move(notes));
+}
+
+/**
+ * @brief Writes a generation to the cache 
+ * @param key Key produced by makeKey
+ * @param notes The note model to store; empty models are not cached
+ */
+void GenerationCache::store(const juce::String& key, const NoteSpecArray& notes)
+{
+    if (NoteSpecs::size(notes) == 0)
+        return;
+
+    juce::MemoryOutputStream out(CACHE_HEADER_BYTES + notes->size() * NoteSpecs::packedNoteBytes);
+    out.writeInt(CACHE_FILE_MAGIC);
+    out.writeInt((int) notes->size());
+    NoteSpecs::writePacked(out, *notes);
+
+    const juce::ScopedLock scopedLock(lock);
+
+    auto file = getEntryFile(key);
+    if (! file.replaceWithData(out.getData(), out.getDataSize()))
+    {
+        DBG("Failed to write cache entry: " + file.getFullPathName());
+        return;
+    }
+
+    if (auto existing = index.find(key); existing != index.end())
+        totalBytes -= existing->second.sizeBytes;
+
+    index[key] = { (juce::int64) out.getDataSize(), juce::Time::currentTimeMillis() };
+    totalBytes += (juce::int64) out.getDataSize();
+
+    evictLeastRecentlyUsed();
+}
+
+void GenerationCache::evictLeastRecentlyUsed()
+{
+    while (totalBytes > maxBytes && ! index.empty())
+    {
+        auto oldest = std::min_element(index.begin(), index.end(), [](const auto& a, const auto& b)
+        {
+            return a.second.lastAccessMs < b.second.lastAccessMs;
+        });
+
+        getEntryFile(oldest->first).deleteFile();
+        totalBytes -= oldest->second.sizeBytes;
+        index.erase(oldest);
+    }
+}
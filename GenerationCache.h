@@ -0,0 +1,56 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "NoteSpec.h"
+
+/**
+ * GenerationCache - Persistent, size-capped LRU cache of generated note models.
+ *
+ * Keyed by a stable 64-bit hash of everything that determines a generation (instructions, model, prompt and the
+ * recent-prompt context). Each entry is a small binary file of packed notes in %AppData%/KiwiPlugin/generation_cache
+ * (or equivalent on macOS/Linux), read back through a memory map so a hit costs microseconds instead of a round trip.
+ * Recency is kept in an in-memory index and persisted through file modification times; the least recently used
+ * entries are evicted once the cache grows past its byte budget.
+ */
+class GenerationCache
+{
+public:
+    GenerationCache();
+
+    /// Stable across sessions and platforms (unlike std::hash), so keys survive restarts
+    static juce::String makeKey(const juce::String& instructions,
+                                const juce::String& model,
+                                const juce::String& prompt,
+                                const juce::StringArray& recentPrompts);
+
+    /// Returns the cached notes for a key, or nullptr on a miss. Counts towards the hit/miss statistics
+    NoteSpecArray lookup(const juce::String& key);
+
+    /// Store a generation, evicting least recently used entries if the cache is over budget
+    void store(const juce::String& key, const NoteSpecArray& notes);
+
+    int getHitCount() const { return hits.load(); }
+    int getMissCount() const { return misses.load(); }
+
+private:
+    struct IndexEntry
+    {
+        juce::int64 sizeBytes;
+        juce::int64 lastAccessMs;
+    };
+
+    juce::File getCacheDir() const;
+    juce::File getEntryFile(const juce::String& key) const;
+    void loadIndex();                    /// Rebuild the in-memory index from the files on disk
+    void evictLeastRecentlyUsed();       /// Delete oldest entries until the cache fits its byte budget
+
+    juce::int64 maxBytes = 8 * 1024 * 1024;   /// Byte budget (KIWI_CACHE_MAX_BYTES overrides)
+    juce::int64 totalBytes = 0;
+    std::map<juce::String, IndexEntry> index; /// Key -> size and recency of each entry on disk
+
+    mutable juce::CriticalSection lock;       /// Protects index and totalBytes
+    std::atomic<int> hits { 0 };
+    std::atomic<int> misses { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GenerationCache)
+};
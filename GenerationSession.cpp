@@ -0,0 +1,124 @@
+#include "GenerationSession.h"
+
+GenerationSession::GenerationSession(int id, const juce::String& promptText, const juce::String& key,
+                                     const juce::String& body, bool streamResponse)
+    : requestId(id), prompt(promptText), cacheKey(key), requestBody(body), streaming(streamResponse)
+{
+}
+
+bool GenerationSession::isFinished() const
+{
+    const auto current = getStatus();
+    return current == Status::succeeded || current == Status::failed || current == Status::cancelled;
+}
+
+/**
+ * @brief Moves the session to a new status unless it has already finished 
+ * @param newStatus The status to move to
+ */
+void GenerationSession::setStatus(Status newStatus)
+{
+    auto current = status.load();
+    while (current != Status::succeeded && current != Status::failed && current != Status::cancelled)
+    {
+        if (status.compare_exchange_weak(current, newStatus))
+            return;
+    }
+}
+
+/**
+ * @brief Cancels the session and aborts every HTTP attempt still running 
+ */
+void GenerationSession::cancel()
+{
+    const juce::ScopedLock scopedLock(lock);
+    setStatus(Status::cancelled);
+    for (auto& attempt : attempts)
+        attempt->cancel();
+}
+
+/**
+ * @brief Registers a new HTTP attempt for this session 
+ * @param attemptIndex Receives the index to pass to claim() and finishAttempt()
+ * @return A canceller to pass to HttpClient::post
+ */
+std::shared_ptr<HttpRequestCanceller> GenerationSession::addAttempt(int& attemptIndex)
+{
+    auto canceller = std::make_shared<HttpRequestCanceller>();
+
+    const juce::ScopedLock scopedLock(lock);
+    if (isCancelled())
+        canceller->cancel();
+
+    attemptIndex = (int) attempts.size();
+    attempts.push_back(canceller);
+    return canceller;
+}
+
+/**
+ * @brief Claims the session's result for an attempt 
+ * @param attempt Index returned by addAttempt()
+ * @return true if this attempt owns the result
+ */
+bool GenerationSession::claim(int attempt)
+{
+    const juce::ScopedLock scopedLock(lock);
+    if (winner == -1 && ! isCancelled())
+    {
+        winner = attempt;
+        for (int i = 0; i < (int) attempts.size(); ++i)
+            if (i != attempt)
+                attempts[(size_t) i]->cancel();
+    }
+    return winner == attempt;
+}
+
+/**
+ * @brief Records that an attempt has ended and decides whether it delivers the outcome: the winner does, or, if
+ *        nothing won, the last attempt to end 
+ * @param attempt Index returned by addAttempt()
+ * @return true if the caller should deliver the outcome
+ */
+bool GenerationSession::finishAttempt(int attempt)
+{
+    const juce::ScopedLock scopedLock(lock);
+    attemptsFinished++;
+
+    if (outcomeDelivered || (winner != -1 && winner != attempt))
+        return false;
+
+    if (winner == -1 && attemptsFinished < (int) attempts.size())
+        return false; // Another attempt may still succeed
+
+    outcomeDelivered = true;
+    return true;
+}
+
+bool GenerationSession::canHedge() const
+{
+    const juce::ScopedLock scopedLock(lock);
+    return ! outcomeDelivered && ! isFinished() && winner == -1 && attempts.size() == 1 && attemptsFinished == 0;
+}
+
+//==============================================================================
+void GenerationHandle::cancel() const
+{
+    for (auto& session : sessions)
+        session->cancel();
+}
+
+bool GenerationHandle::isCancelled() const
+{
+    for (auto& session : sessions)
+        if (session->isCancelled())
+            return true;
+    return false;
+}
+
+bool GenerationHandle::isFinished() const
+{
+    for (auto& session : sessions)
+        if (! session->isFinished())
+            return false;
+    return true;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <memory>
+#include <vector>
+#include "NoteSpec.h"
+#include "NoteRepair.h"
+#include "HttpClient.h"
+
+/**
+ * Outcome of one generation request, or of one variation in a batch. Delivered on the message thread as an owned
+ * value, so overlapping requests can never overwrite each other's result.
+ */
+struct GenerationResult
+{
+    int requestId = 0;          // Id of the session that produced this result
+    juce::String prompt;        // The prompt exactly as the user typed it
+    NoteSpecArray notes;        // Parsed notes; null or empty on error
+    juce::String error;         // Empty on success
+    juce::String backend;       // Name of the backend the request was routed to, empty if none was
+    int variationIndex = 0;     // 0-based position in a variations batch
+    int variationCount = 1;     // Size of the batch, 1 for a single request
+    int sectionIndex = 0;       // 0-based section of a long-form piece, in beat order
+    int sectionCount = 1;       // Sections in the piece, 1 for anything that is not long-form
+    juce::String sectionName;   // e.g. "Chorus", empty outside long-form
+    double rangeStartBeats = 0.0; // Regenerated range of an existing phrase; both 0 for a new phrase
+    double rangeEndBeats = 0.0;
+    bool fromCache = false;     // Answered from the generation cache without a request
+    bool fromLocal = false;     // Produced by the built-in LocalGenerator rather than the remote model
+    bool provisional = false;   // A local draft; the remote result for the same request follows
+    bool streamed = false;      // Notes already started playing while the response streamed in
+    double queueWaitMs = 0.0;   // Time spent waiting for a free worker
+    double latencyMs = 0.0;     // Time from sending to the complete result
+    int outputTokens = 0;       // Output tokens the backend reported using, 0 if it didn't say
+    bool compactFormat = false; // The model was asked for compact [start,dur,pitch,vel] tuples
+    juce::String transform;     // The local edit applied to the previous phrase, e.g. "transpose +7"; empty for generated notes
+    NoteRepair::Report repairs; // What had to be fixed in the model's output before it could be played
+    NoteSpecs::PartList parts;  // Named parts of a multi-part response, each on its own channel; empty for one part
+
+    bool succeeded() const { return error.isEmpty() && NoteSpecs::size(notes) > 0; }
+};
+
+/**
+ * GenerationSession - One generation request: its immutable inputs, its atomic status and its HTTP attempts.
+ *
+ * Created on the message thread with a monotonically increasing id and shared with the worker threads that serve it.
+ * Workers only read the inputs, update the status and race attempts through claim()/finishAttempt(); nothing in the
+ * Generator is written from a worker. A request may run a second, hedged attempt; the first attempt to produce a
+ * result owns it and the other is cancelled. Exactly one attempt delivers the outcome.
+ */
+class GenerationSession
+{
+public:
+    enum class Status { queued, running, streaming, succeeded, failed, cancelled };
+
+    GenerationSession(int requestId, const juce::String& prompt, const juce::String& cacheKey,
+                      const juce::String& requestBody, bool streaming);
+
+    const int requestId;
+    const juce::String prompt;
+    const juce::String cacheKey;
+    const juce::String requestBody;
+    const bool streaming;
+
+    Status getStatus() const { return status.load(); }
+    bool isFinished() const;
+
+    /// Moves to a new status. Finished states (succeeded, failed, cancelled) are final and never overwritten
+    void setStatus(Status newStatus);
+
+    /// Cancels the session and aborts all of its HTTP attempts. Safe to call from any thread
+    void cancel();
+    bool isCancelled() const { return getStatus() == Status::cancelled; }
+
+    /// Registers a new HTTP attempt and returns its canceller (already cancelled if the session is)
+    std::shared_ptr<HttpRequestCanceller> addAttempt(int& attemptIndex);
+
+    /// Claims the result for an attempt. The first attempt to claim wins; the others are cancelled
+    bool claim(int attempt);
+
+    /// Records that an attempt has ended. Returns true for exactly one attempt, which must deliver the outcome
+    bool finishAttempt(int attempt);
+
+    /// True while only the first attempt is running and nothing has come back yet
+    bool canHedge() const;
+
+private:
+    std::atomic<Status> status { Status::queued };
+
+    mutable juce::CriticalSection lock;                         /// Guards everything below
+    std::vector<std::shared_ptr<HttpRequestCanceller>> attempts;
+    int winner = -1;                                            /// Attempt that produced the first result, -1 until one has
+    int attemptsFinished = 0;
+    bool outcomeDelivered = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GenerationSession)
+};
+
+/**
+ * GenerationHandle - Caller-side reference to one request, or to every session of a variations batch.
+ *
+ * Copies refer to the same sessions. A default-constructed handle refers to nothing, and cancelling it does nothing.
+ */
+class GenerationHandle
+{
+public:
+    GenerationHandle() = default;
+    explicit GenerationHandle(std::vector<std::shared_ptr<GenerationSession>> sessionsToTrack)
+        : sessions(std::move(sessionsToTrack)) {}
+
+    void cancel() const;
+    bool isValid() const { return ! sessions.empty(); }
+    bool isCancelled() const;
+    bool isFinished() const;
+    int getRequestId() const { return sessions.empty() ? 0 : sessions.front()->requestId; }
+
+private:
+    std::vector<std::shared_ptr<GenerationSession>> sessions;
+};
@@ -0,0 +1,53 @@
+#include "GenerationWorkerPool.h"
+
+#define DEFAULT_GENERATION_WORKERS 4
+#define MAX_GENERATION_WORKERS 16
+#define SHUTDOWN_TIMEOUT_MS 5000
+
+// Anonymous namespace: helpers used only within this .cpp file
+namespace
+{
+    int readWorkerCount()
+    {
+        const auto configured = juce::SystemStats::getEnvironmentVariable("KIWI_GENERATION_WORKERS", "").getIntValue();
+        return configured > 0 ? juce::jlimit(1, MAX_GENERATION_WORKERS, configured) : DEFAULT_GENERATION_WORKERS;
+    }
+}
+
+GenerationWorkerPool::GenerationWorkerPool()
+    : numWorkers(readWorkerCount()),
+      pool(numWorkers)
+{
+}
+
+GenerationWorkerPool::~GenerationWorkerPool()
+{
+    // Queued requests are dropped; running ones are asked to exit and get a grace period to abort their network call.
+    // Generators cancel their own requests first, so this normally returns at once
+    pool.removeAllJobs(true, SHUTDOWN_TIMEOUT_MS);
+}
+
+/**
+ * @brief Queues a job on the shared workers 
+ * @param job Work to run off the message thread, typically one HTTP request and its parsing
+ */
+void GenerationWorkerPool::addJob(std::function<void()> job)
+{
+    pool.addJob([this, job = std::move(job)]
+    {
+        activeJobs++;
+        job();
+        activeJobs--;
+    });
+}
+
+bool GenerationWorkerPool::shouldCurrentJobExit()
+{
+    auto* job = juce::ThreadPoolJob::getCurrentThreadPoolJob();
+    return job != nullptr && job->shouldExit();
+}
+
+int GenerationWorkerPool::getNumQueuedJobs() const
+{
+    return juce::jmax(0, pool.getNumJobs() - activeJobs.load());
+}
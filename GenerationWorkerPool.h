@@ -0,0 +1,36 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+
+/**
+ * GenerationWorkerPool - Bounded pool of background threads that run generation requests.
+ *
+ * Replaces one ad-hoc thread per request: at most getNumWorkers() requests talk to the API at once, and the rest
+ * wait in the queue. Held through juce::SharedResourcePointer so every plugin instance in the process shares the
+ * same limit. KIWI_GENERATION_WORKERS sets the number of workers (default 4, clamped to 1-16).
+ */
+class GenerationWorkerPool
+{
+public:
+    GenerationWorkerPool();
+    ~GenerationWorkerPool();
+
+    /// Queue a job; it runs as soon as a worker is free
+    void addJob(std::function<void()> job);
+
+    int getNumWorkers() const { return numWorkers; }
+    int getNumActiveJobs() const { return activeJobs.load(); }   /// Jobs currently running on a worker
+    int getNumQueuedJobs() const;                                 /// Jobs waiting for a free worker
+
+    /// True when the job running on the calling thread has been asked to stop, e.g. because the pool is shutting down.
+    /// Long jobs check it between reads of their response
+    static bool shouldCurrentJobExit();
+
+private:
+    const int numWorkers;
+    std::atomic<int> activeJobs { 0 };
+    juce::ThreadPool pool;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GenerationWorkerPool)
+};
@@ -1,80 +1,170 @@
 #include "Generator.h"
 #include "MidiNoteEvent.h"
 #include "MidiNote.h"
+#include "ServerSentEvents.h"
 
 #define MAX_TIMEOUT_MS 300000 // 5 minutes before aborting POST request 
 #define MAX_REDIRECTS 5
 #define TICKS_PER_QUARTER_NOTE 480
+#define RESPONSE_READ_CHUNK_BYTES 1024
+#define MAX_VARIATIONS 8
+#define MIN_HEDGE_SAMPLES 10 // Latency samples needed before the p95 is trusted enough to hedge against
+#define HEDGE_PERCENTILE 0.95
+#define MAX_OUTPUT_RETRIES 1 // Re-requests when a response has no recoverable note at all
+#define RANGE_CONTEXT_BEATS 8.0 // Notes this close to a regenerated range are sent as its context
+#define MAX_RANGE_CONTEXT_NOTES 32 // Per side of the range
+#define OPENAI_ENDPOINT "https://api.openai.com/v1/responses"
+#define OPENAI_MODEL "gpt-5.2-2025-12-11"
+#define LOCAL_MODEL_NAME "local" // Most OpenAI-compatible local servers ignore the model name or serve only one
+
+// Anonymous namespace: helpers used only within this .cpp file 
+namespace
+{
+    /// Reads a whole response body, checking shouldStop between reads
+    juce::String readResponseBody(juce::InputStream& stream, const std::function<bool()>& shouldStop)
+    {
+        juce::MemoryOutputStream body;
+        char buffer[RESPONSE_READ_CHUNK_BYTES];
+
+        while (! stream.isExhausted() && ! shouldStop())
+        {
+            const int bytesRead = stream.read(buffer, (int) sizeof(buffer));
+            if (bytesRead <= 0)
+                break;
+
+            body.write(buffer, (size_t) bytesRead);
+        }
+
+        return body.toUTF8();
+    }
+}
 
 Generator::Generator()
     : sharedState(std::make_shared<SharedState>())
 {
     apiKey = loadApiKey();
+    streamedNoteQueue.resize((size_t) streamedNoteQueueSize);
+
+    // OpenAI's Responses API, or a stand-in server that speaks it 
+    auto openAIEndpoint = juce::SystemStats::getEnvironmentVariable("KIWI_GENERATOR_ENDPOINT", "").trim();
+    auto openAIModel = juce::SystemStats::getEnvironmentVariable("KIWI_OPENAI_MODEL", "").trim();
+    backendRouter.addBackend(std::make_shared<OpenAIResponsesBackend>("openai",
+                                                                      openAIEndpoint.isNotEmpty() ? openAIEndpoint : juce::String(OPENAI_ENDPOINT),
+                                                                      openAIModel.isNotEmpty() ? openAIModel : juce::String(OPENAI_MODEL),
+                                                                      apiKey));
+
+    // An OpenAI-compatible model server on this machine or the local network, e.g. llama.cpp's server 
+    auto localEndpoint = juce::SystemStats::getEnvironmentVariable("KIWI_LOCAL_MODEL_ENDPOINT", "").trim();
+    if (localEndpoint.isNotEmpty())
+    {
+        auto localModel = juce::SystemStats::getEnvironmentVariable("KIWI_LOCAL_MODEL_NAME", LOCAL_MODEL_NAME).trim();
+        backendRouter.addBackend(std::make_shared<OpenAICompatibleBackend>("local", localEndpoint, localModel,
+                                                                           juce::SystemStats::getEnvironmentVariable("KIWI_LOCAL_MODEL_API_KEY", "").trim()));
+    }
+
+    // Route by latency unless a backend is pinned 
+    auto pinnedBackend = juce::SystemStats::getEnvironmentVariable("KIWI_GENERATION_BACKEND", "").trim().toLowerCase();
+    if (pinnedBackend != "auto")
+        backendRouter.setPinnedBackend(pinnedBackend);
+
+    auto configuredTimeoutMs = juce::SystemStats::getEnvironmentVariable("KIWI_REQUEST_TIMEOUT_MS", "").getIntValue();
+    requestTimeoutMs = configuredTimeoutMs > 0 ? configuredTimeoutMs : MAX_TIMEOUT_MS;
+
+    auto streamingSetting = juce::SystemStats::getEnvironmentVariable("KIWI_STREAMING_ENABLED", "1").trim();
+    streamingEnabled = ! (streamingSetting.equalsIgnoreCase("0") || streamingSetting.equalsIgnoreCase("false") || streamingSetting.equalsIgnoreCase("no"));
+
+    auto compactSetting = juce::SystemStats::getEnvironmentVariable("KIWI_COMPACT_NOTES", "0").trim();
+    compactNotesEnabled = compactSetting.equalsIgnoreCase("1") || compactSetting.equalsIgnoreCase("true") || compactSetting.equalsIgnoreCase("yes");
+    auto multiPartSetting = juce::SystemStats::getEnvironmentVariable("KIWI_MULTI_PART", "1").trim();
+    multiPartEnabled = ! (multiPartSetting.equalsIgnoreCase("0") || multiPartSetting.equalsIgnoreCase("false") || multiPartSetting.equalsIgnoreCase("no"));
+    instructions = apiInstructions.replace("{output_format}", (compactNotesEnabled ? compactOutputFormat : verboseOutputFormat)
+                                                              + (multiPartEnabled ? multiPartOutputFormat : juce::String()));
+
+    auto longFormSetting = juce::SystemStats::getEnvironmentVariable("KIWI_LONG_FORM", "1").trim();
+    longFormEnabled = ! (longFormSetting.equalsIgnoreCase("0") || longFormSetting.equalsIgnoreCase("false") || longFormSetting.equalsIgnoreCase("no"));
+
+    auto transformSetting = juce::SystemStats::getEnvironmentVariable("KIWI_LOCAL_TRANSFORMS", "1").trim();
+    transformsEnabled = ! (transformSetting.equalsIgnoreCase("0") || transformSetting.equalsIgnoreCase("false") || transformSetting.equalsIgnoreCase("no"));
+
+    auto hedgingSetting = juce::SystemStats::getEnvironmentVariable("KIWI_HEDGE_REQUESTS", "0").trim();
+    hedgingEnabled = hedgingSetting.equalsIgnoreCase("1") || hedgingSetting.equalsIgnoreCase("true") || hedgingSetting.equalsIgnoreCase("yes");
+
+    // Without a configured backend the built-in generator is the only source that can answer, unless a policy says otherwise 
+    auto policySetting = juce::SystemStats::getEnvironmentVariable("KIWI_GENERATION_POLICY", "").trim().toLowerCase();
+    if (policySetting == "local" || policySetting == "local_only")
+        policy = Policy::localOnly;
+    else if (policySetting == "local_first" || policySetting == "local_first_then_refine")
+        policy = Policy::localFirstThenRefine;
+    else if (policySetting == "remote" || policySetting == "remote_only")
+        policy = Policy::remoteOnly;
+    else
+        policy = backendRouter.hasConfiguredBackend() ? Policy::remoteOnly : Policy::localOnly;
 }
 
 Generator::~Generator()
 {
     // Mark as invalid so background threads won't access this object 
     sharedState->isValid = false;
+
+    // Abort every request still running, so their workers are free well before the pool's shutdown timeout 
+    for (const auto& trackedSession : liveSessions)
+        if (auto session = trackedSession.lock())
+            session->cancel();
     
-    // Clean up all created MIDI files
-    for (const auto& file : createdMidiFiles)
-    {
-        if (file.existsAsFile())
-        {
-            file.deleteFile();
-            DBG("Deleted MIDI file: " + file.getFullPathName());
-        }
-    }
-    createdMidiFiles.clear();
+    // Dragged-out MIDI files are not deleted here: DAW projects and restored history still refer to them, and the
+    // MidiFileStore collects unreferenced ones once it grows past its budget 
 }
 
 /**
- * @brief Creates a string representation of the MIDI note sequence from the string JSON response 
- * @param apiResponse The raw string response from the OpenAI API
+ * @brief Builds the per-request input sent after the fixed instructions. Each backend wraps it in its own payload 
+ * @param prompt The user's prompt
+ * @param recentPrompts Previous prompts, oldest first, sent as context
+ * @return The context and prompt as text
  */
-void Generator::getSequenceJSON(const juce::String& apiResponse)
+juce::String Generator::buildRequestInput(const juce::String& prompt, const juce::StringArray& recentPrompts) const
 {
-    juce::String content;
-    auto parsed = juce::JSON::parse(apiResponse);
-    if (parsed.isObject())
+    juce::String requestInput;
+    if (recentPrompts.size() > 0)
     {
-        auto* obj = parsed.getDynamicObject();
-        auto output = obj->getProperty("output");
-
-        if (output.isArray())
-        {
-            for (auto& item : *output.getArray())
-            {
-                if (!item.isObject()) continue;
+        // Add recent prompts as context to the request input 
+        requestInput << "Context from previous user prompts (oldest to newest):";
+        for (int i = 0; i < recentPrompts.size(); ++i)
+            requestInput << "\n- Previous prompt " + juce::String(i + 1) + ": " + recentPrompts[i];
+        requestInput << "\n\n";
+    }
+    requestInput << "Current user prompt:\n" + prompt;
+    return requestInput;
+}
 
-                auto* itemObj = item.getDynamicObject();
-                if (itemObj->getProperty("type").toString() != "message")
-                    continue;
+/**
+ * @brief Builds the input for regenerating one range of a phrase: the request and the notes either side of the
+ *        range, in compact form, rather than the whole phrase 
+ * @param notes The phrase
+ * @param startBeats Start of the range
+ * @param endBeats End of the range (exclusive)
+ * @param prompt What the user wants the range to become
+ * @return The range request as text
+ */
+juce::String Generator::buildRangeInput(const NoteSpecArray& notes, double startBeats, double endBeats, const juce::String& prompt) const
+{
+    auto before = NoteSpecs::inRange(notes, startBeats - RANGE_CONTEXT_BEATS, startBeats);
+    if ((int) before.size() > MAX_RANGE_CONTEXT_NOTES)
+        before.erase(before.begin(), before.end() - MAX_RANGE_CONTEXT_NOTES); // Keep the notes nearest the range
+    const auto after = NoteSpecs::inRange(notes, endBeats, endBeats + RANGE_CONTEXT_BEATS);
 
-                auto contentArr = itemObj->getProperty("content");
-                if (!contentArr.isArray() || contentArr.size() == 0)
-                    continue;
+    const auto formatBeats = [](double beats) { return juce::String(beats, 2).trimCharactersAtEnd("0").trimCharactersAtEnd("."); };
 
-                auto first = contentArr[0];
-                if (first.isObject())
-                {
-                    auto* textObj = first.getDynamicObject();
-                    content = textObj->getProperty("text").toString();
-                    break;
-                }
-            }
-        }
-    }
-    
-    if (content.isEmpty())
-    {
-        DBG("Failed to extract content from API response");
-        return;
-    }
-    
-    DBG("Extracted MIDI JSON: " + content);
-    sequenceJSON = content;  
+    juce::String requestInput;
+    requestInput << "Regenerate only beats " << formatBeats(startBeats) << " to " << formatBeats(endBeats)
+                 << " of an existing phrase. The rest of the phrase stays as it is.\n"
+                 << "Notes just before the range, as [start_beats,duration_beats,midi_note,velocity]: "
+                 << NoteSpecs::toCompactJSON(NoteSpecs::fromVector(std::move(before)), MAX_RANGE_CONTEXT_NOTES) << "\n"
+                 << "Notes just after the range: " << NoteSpecs::toCompactJSON(NoteSpecs::fromVector(after), MAX_RANGE_CONTEXT_NOTES) << "\n"
+                 << "Return only the new notes for the range, with start_beats from " << formatBeats(startBeats)
+                 << " up to (not including) " << formatBeats(endBeats)
+                 << ", counted from the start of the phrase. Keep the key and style, and join smoothly onto the notes around it.\n\n"
+                 << "Current user prompt:\n" << prompt;
+    return requestInput;
 }
 
 juce::String Generator::loadApiKey() const
@@ -109,321 +199,1172 @@ juce::String Generator::loadApiKey() const
 }
 
 /**
- * @brief Computes total number of notes in the sequence from the sequenceJSON string 
+ * @brief Sets the size of the real-time buffers of sequences prepared from now on. Called on the host's thread, so it
+ *        only stores the limit; the note storage belongs to the message thread, which sizes it when it builds a sequence 
+ * @param maxNotes Maximum number of notes in a sequence; anything beyond this is dropped when the sequence is extracted 
  */
-int Generator::getNoteCountFromSequenceJSON() const
+void Generator::prepareToPlay(int maxNotes)
 {
-    auto notesJson = juce::JSON::parse(sequenceJSON);
-    if (! notesJson.isObject())
-        return 0;
+    maxSequenceLength = juce::jmax(1, maxNotes);
+}
 
-    if (auto* notesObj = notesJson.getDynamicObject())
+/**
+ * @brief Converts a note from the note model into a MidiNote for playback 
+ * @param spec The note, with timing in beats
+ * @return The playback note on the scheduled MIDI channel
+ */
+MidiNote Generator::createNote(const NoteSpec& spec) const
+{
+    // Keep at least one tick of length so the note-off always lands after its note-on 
+    const double startBeats = spec.startBeats;
+    const double noteLengthBeats = juce::jmax((double) spec.durationBeats, 1.0 / TICKS_PER_QUARTER_NOTE);
+
+    MidiNoteEvent noteEvent{NoteSpecs::getChannel(spec, scheduledMidiChannel), spec.pitch, spec.velocity};
+    return MidiNote(noteEvent, startBeats, startBeats + noteLengthBeats);
+}
+
+/**
+ * @brief Converts the note model into a vector of MidiNote objects and publishes the resulting timeline to the audio thread.
+ *        Must be called off the audio thread since it allocates. Notes stay in beats; the scheduler converts them to
+ *        samples block by block against the host tempo 
+ * @param requestId The request whose result is being played, so its own refinement may take over; 0 for a replay
+ */
+void Generator::extractSequence(int requestId)
+{
+    jassert(juce::MessageManager::getInstance()->isThisTheMessageThread());
+
+    noteSequence.clear(); // Clear previous note sequence if it exists
+    const int maxNotes = maxSequenceLength.load(); // One limit for the notes and the timeline, even if prepareToPlay runs meanwhile
+
+    // A response still streaming loses its timeline to this one. It keeps collecting its notes without playing them,
+    // like one that started streaming while this plays; a long-form piece notices by itself and stops playing
+    const bool streamingLongForm = std::any_of(longForms.begin(), longForms.end(), [this](const auto& assembly)
     {
-        auto notesArray = notesObj->getProperty("notes");
-        if (notesArray.isArray())
-            return notesArray.size();
+        return assembly->timelineId == streamingRequestId;
+    });
+    if (streamingRequestId != 0 && ! streamingLongForm)
+        heldStreams[streamingRequestId] = std::move(streamedNotes);
+    streamedNotes.clear();
+    streamingRequestId = 0;
+
+    if (currentNotes != nullptr)
+    {
+        DBG("Found " + juce::String((int) currentNotes->size()) + " notes");
+
+        const int numNotes = juce::jmin((int) currentNotes->size(), maxNotes);
+        if (numNotes < (int) currentNotes->size())
+            DBG("Sequence truncated to " + juce::String(maxNotes) + " notes");
+
+        noteSequence.reserve((size_t) numNotes);
+        for (int i = 0; i < numNotes; i++)
+            noteSequence.push_back(createNote((*currentNotes)[(size_t) i]));
     }
 
-    return 0;
+    // Build the timeline here so the audio thread only has to swap a pointer to start playback. Capacity is reserved
+    // up front so a regenerated range can be swapped in on the audio thread without allocating
+    auto timeline = std::make_unique<SequenceScheduler>();
+    timeline->reserve(maxNotes);
+    timeline->loadSequence(noteSequence);
+    publishTimeline(std::move(timeline));
+    timelineNotes = currentNotes;
+    timelineRequestId = requestId;
 }
 
 /**
- * @brief Converts string representation of the MIDI note sequence into a vector of MidiNote objects that can be processed in the audio thread 
- * @param bpm Beats Per Minute tempo of the host 
- * @param sampleRate Sample rate of the host 
+ * @brief Checks whether a timeline is playing or about to start, e.g. so a new response doesn't cut it off 
  */
-void Generator::extractSequence(double bpm, double sampleRate)
+bool Generator::isSequencePlaying() const
 {
-    
-    if (sequenceJSON.startsWith("Error:"))
+    return sequencePlaying.load() || playbackHandoff.hasPending();
+}
+
+/**
+ * @brief Tags a prepared timeline with a fresh sequence id and hands it to the audio thread 
+ * @param timeline The timeline to publish, built on the message thread
+ */
+void Generator::publishTimeline(std::unique_ptr<SequenceScheduler> timeline)
+{
+    currentSequenceId++;
+    timeline->setSequenceId(currentSequenceId);
+    timeline->setLaunchQuantization(launchQuantization);
+    playbackHandoff.publish(std::move(timeline));
+}
+
+/**
+ * @brief Adds a note that has just arrived in the response stream to the playing sequence. The first streamed note of a
+ *        response opens a new timeline, so playback starts while the rest of the phrase is still being generated.
+ *        Like a finished response, a streamed one never cuts off a sequence that is still playing, unless that
+ *        sequence is its own local draft: it is collected without playing and delivered as an unstreamed result 
+ * @param spec A completed element of the streamed notes array
+ * @param requestId The request whose response produced the note
+ * @param playIfLate Whether the note plays at the playhead if its start has already passed, or is dropped
+ */
+void Generator::appendStreamedNote(const NoteSpec& spec, int requestId, bool playIfLate)
+{
+    if (auto held = heldStreams.find(requestId); held != heldStreams.end())
+    {
+        held->second.push_back(spec);
         return;
+    }
 
-    int runningSampleCount = triggerDelaySamples;  // Start with initial delay to ensure notes are scheduled in the future
-    noteSequence.clear(); // Clear previous note sequence if it exists
+    if (streamingRequestId != requestId && isSequencePlaying() && timelineRequestId != requestId)
+    {
+        DBG("Streamed response " + juce::String(requestId) + " not played - sequence already in progress");
+        heldStreams[requestId].push_back(spec);
+        return;
+    }
 
-    // Parse the JSON to get note data with beat timing 
-    auto notesJson = juce::JSON::parse(sequenceJSON);
-    if (notesJson.isObject())
+    if (streamingRequestId != requestId)
     {
-        auto* notesObj = notesJson.getDynamicObject();
-        auto notesArray = notesObj->getProperty("notes");
-        
-        if (notesArray.isArray())
-        {
-            DBG("Found " + juce::String(notesArray.size()) + " notes");
+        // A superseded response that was still streaming is closed before the new one takes over 
+        finishStreamedSequence();
 
-            // Loop through each note in the JSON array and create MidiNote objects with timing parameters 
-            for (int i = 0; i < notesArray.size(); i++)
-            {
-                auto note = notesArray[i];
-                if (note.isObject())
-                {
+        streamingRequestId = requestId;
+        noteSequence.clear();
+        streamedNotes.clear();
+        timelineNotes = nullptr;
 
-                    // Extract note information from the string JSON 
-                    auto* noteObj = note.getDynamicObject();
-                    float startBeats = noteObj->getProperty("start_beats");
-                    float durationBeats = noteObj->getProperty("duration_beats");
-                    int midiNote = noteObj->getProperty("midi_note");
-                    int velocity = noteObj->getProperty("velocity"); 
-
-                    double startInSeconds = (startBeats * 60.0) / bpm;
-                    double durationInSeconds = (durationBeats * 60.0) / bpm;
-                    int startSamples = triggerDelaySamples + juce::jmax(1, (int) std::round(startInSeconds * sampleRate)); 
-                    int noteDurationSamples = juce::jmax(1, (int) std::round(durationInSeconds * sampleRate));
-
-                    // Create midi events and add to the sequence 
-                    MidiNoteEvent noteEvent{scheduledMidiChannel, midiNote, (juce::uint8) velocity};
-                    noteSequence.emplace_back(noteEvent, startSamples, startSamples + noteDurationSamples);
-
-                    DBG("Note " + juce::String(i) + ": MIDI=" + juce::String(midiNote) + 
-                        " start=" + juce::String(startBeats) + 
-                        " dur=" + juce::String(durationBeats) + 
-                        " vel=" + juce::String(velocity));
-                }
-            }
+        auto timeline = std::make_unique<SequenceScheduler>();
+        timeline->reserve(maxSequenceLength.load()); // Streamed notes are inserted on the audio thread, so it must never grow
+        timeline->beginStream();
+        publishTimeline(std::move(timeline));
+        timelineRequestId = requestId;
+    }
+
+    streamedNotes.push_back(spec);
+
+    if ((int) noteSequence.size() >= maxSequenceLength.load())
+        return;
+
+    const auto note = createNote(spec);
+    noteSequence.push_back(note);
+    enqueueStreamedNote({ currentSequenceId, note.getNoteEvent(), note.getOnBeats(), note.getOffBeats(), false, false, ! playIfLate });
+}
+
+/**
+ * @brief Tells the audio thread that no more notes will be streamed into the current timeline, so it can finish, and
+ *        freezes the streamed notes into the note model without re-parsing the response. Duplicates that streamed in
+ *        separately are merged in the frozen model 
+ * @param repairs Receives what was repaired across the whole stream, if not null
+ * @return The frozen notes of the finished stream, or null if no stream was open
+ */
+NoteSpecArray Generator::finishStreamedSequence(NoteRepair::Report* repairs)
+{
+    if (streamingRequestId == 0)
+        return nullptr;
+
+    enqueueStreamedNote({ currentSequenceId, {}, 0.0, 0.0, true });
+
+    NoteRepair::Report streamRepairs;
+    NoteRepair::repairNotes(streamedNotes, streamRepairs);
+    if (repairs != nullptr)
+        repairs->merge(streamRepairs);
+
+    {
+        const juce::ScopedLock lock(noteModelLock);
+        currentNotes = NoteSpecs::fromVector(std::move(streamedNotes));
+    }
+    timelineNotes = currentNotes;
+    streamedNotes.clear();
+    streamingRequestId = 0;
+    return currentNotes;
+}
+
+/**
+ * @brief Pushes a streamed note onto the lock-free queue read by the audio thread. Message thread only 
+ */
+void Generator::enqueueStreamedNote(const QueuedNote& item)
+{
+    int start1, size1, start2, size2;
+    streamedNoteFifo.prepareToWrite(1, start1, size1, start2, size2);
+
+    if (size1 + size2 == 0)
+    {
+        DBG("Streamed note queue full - note dropped");
+        return;
+    }
+
+    streamedNoteQueue[(size_t) (size1 > 0 ? start1 : start2)] = item;
+    streamedNoteFifo.finishedWrite(1);
+}
+
+/**
+ * @brief Moves queued streamed notes into the active timeline. Called on the audio thread; never allocates 
+ * @param scheduler The timeline currently playing
+ */
+void Generator::drainStreamedNotes(SequenceScheduler& scheduler)
+{
+    while (streamedNoteFifo.getNumReady() > 0)
+    {
+        int start1, size1, start2, size2;
+        streamedNoteFifo.prepareToRead(1, start1, size1, start2, size2);
+        const auto& item = streamedNoteQueue[(size_t) (size1 > 0 ? start1 : start2)];
+
+        // Notes for a timeline that hasn't been swapped in yet wait for the next block
+        if (item.sequenceId > scheduler.getSequenceId())
+            break;
+
+        // Notes for a timeline that has already been replaced are dropped
+        if (item.sequenceId == scheduler.getSequenceId())
+        {
+            if (item.endOfStream)
+                scheduler.endStream();
+            else if (item.removeRange)
+                scheduler.removeNotes(item.onBeats, item.offBeats);
+            else if (! scheduler.insertNote(MidiNote(item.note, item.onBeats, item.offBeats), ! item.dropIfLate))
+                scheduler.endStream(); // Out of reserved capacity: let the sequence finish with what it has
         }
+
+        streamedNoteFifo.finishedRead(1);
     }
-    
 }
 
 /**
- * @brief Processes all the notes in the noteSequence and updates their timing parameters accordingly 
+ * @brief Activates the most recently published sequence, if there is one. Called from the audio thread and never allocates.
+ *        Notes still sounding from the timeline being replaced are released first 
+ * @param midiMessages The MIDI buffer for this block, which receives the note-offs of the replaced timeline
+ * @return true if a new sequence was started, false if nothing new has been published 
+ */
+bool Generator::startPublishedSequence(juce::MidiBuffer& midiMessages)
+{
+    if (! playbackHandoff.hasPending())
+        return false;
+
+    if (auto* previous = playbackHandoff.getActive())
+        previous->releaseSoundingNotes(midiMessages);
+
+    const bool started = playbackHandoff.acquire() != nullptr;
+    sequencePlaying.store(started || sequencePlaying.load());
+    return started;
+}
+
+/**
+ * @brief Emits the note events of the current sequence that fall inside this block 
+ * @param position The host transport for this block (tempo, ppq position and bar grid)
  * @param blockSize The size of the current audio processing block in samples
  * @param midiMessages The MIDI buffer to which the note-on and note-off events should be added when triggered 
  */
-void Generator::processSequence(int blockSize, juce::MidiBuffer& midiMessages)
+void Generator::processSequence(const SequenceScheduler::HostPosition& position, int blockSize, juce::MidiBuffer& midiMessages)
 {
-    // Loop through all notes 
-    for(auto it = noteSequence.begin(); it != noteSequence.end(); ++it) {
-        it->processNote(blockSize, midiMessages); // Update the note's timing parameters and add events to MIDI buffer if triggered
-
-        // Check if note has finished playing and update sequenceTracker accordingly to track overall sequence completion
-        if(it->isFinished() && !it->hasBeenCounted()) {
-            it->markAsCounted();
-            sequenceTracker++; 
-        }
+    if (auto* scheduler = playbackHandoff.getActive())
+    {
+        drainStreamedNotes(*scheduler);
+        scheduler->processBlock(position, blockSize, midiMessages);
+        sequencePlaying.store(! scheduler->isFinished());
     }
 }
 
 /**
  * @brief Checks if a sequence has finished playing 
- * @return true if all notes in the sequence have been processed and played, false otherwise 
+ * @return true if every scheduled note-on and note-off event has been emitted, false otherwise 
  */
 bool Generator::isSequenceFinished() {
-    if(sequenceTracker >= noteSequence.size()) {
-        sequenceTracker = 0; // Reset for the next sequence 
-        return true; 
+    auto* scheduler = playbackHandoff.getActive();
+    return scheduler == nullptr || scheduler->isFinished();
+}
+
+MidiExportPtr Generator::createMidiExport(double bpm) {
+    return createMidiExport(currentNotes, bpm);
+}
+
+/**
+ * @brief Serialises a note model to standard MIDI file bytes, kept in memory until the file is dragged out. A
+ *        multi-part model becomes a type 1 file with one track per channel, named after its part 
+ * @param notes The notes to write, timed in beats
+ * @param bpm The tempo of the host when the file is created, written as the file's tempo
+ * @return The export, or nullptr if there was nothing to write
+ */
+MidiExportPtr Generator::createMidiExport(const NoteSpecArray& notes, double bpm) {
+    // If there are no notes, there is nothing to export 
+    if (NoteSpecs::size(notes) == 0)
+    {
+        DBG("No notes to write to MIDI file");
+        return nullptr;
     }
-    return false;
+    
+    // Serialised straight from the note model, into a buffer the writer reuses from one export to the next. Nothing
+    // touches the disk until the file is dragged out, and then it is stored under a hash of these bytes 
+    const auto& bytes = midiFileWriter.write(*notes, TICKS_PER_QUARTER_NOTE, scheduledMidiChannel, partNames, bpm);
+    return std::make_shared<MidiExport>(bytes);
 }
 
 /**
- * @brief Resets all notes in the sequence to their original timing parameters and resets the sequenceTracker, allowing the entire sequence to be replayed from the beginning
+ * @brief Sends user's prompt to OpenAI API and handle JSON response 
+ * @param prompt User's prompt 
+ * @param recentPrompts An array of the recent prompts to provide context to the API
+ * @param callback Called on the message thread with the request's result once it has been received and parsed.
+ *                 Not called if the request is cancelled 
+ * @param forceFresh Skip the generation cache and always ask the API 
+ * @return A handle that cancels the request, aborting its network stream 
  */
-void Generator::resetSequence() {
-    sequenceTracker = 0;
-    for (auto& note : noteSequence) {
-        note.reset();
+GenerationHandle Generator::sendToGenerator(const juce::String& prompt,
+                                            const juce::StringArray& recentPrompts,
+                                            ResultCallback callback,
+                                            bool forceFresh)
+{
+    // Mechanical edits of the current phrase ("transpose up a fifth", "quantize to 1/16") never need the model 
+    if (auto pipeline = transformsEnabled && NoteSpecs::size(currentNotes) > 0 ? NoteTransform::parseCommand(prompt) : NoteTransform::Pipeline();
+        ! pipeline.empty())
+    {
+        // Not cached: the same command gives a different result on a different phrase 
+        auto session = std::make_shared<GenerationSession>(++lastRequestId, prompt, juce::String(), juce::String(), false);
+        requestsInFlight++;
+
+        GenerationResult result;
+        result.requestId = session->requestId;
+        result.prompt = prompt;
+        result.notes = NoteTransform::apply(currentNotes, pipeline, session->requestId);
+        result.fromLocal = true;
+        result.transform = NoteTransform::describe(pipeline);
+        DBG("Applied local transform: " + result.transform);
+        postResult(sharedState, this, session, result, callback);
+        return GenerationHandle({ session });
     }
+
+    const bool streaming = streamingEnabled; // Ask for server-sent events so notes can be played as soon as each one is complete 
+    const auto backend = backendRouter.choose();
+    auto session = std::make_shared<GenerationSession>(++lastRequestId, prompt,
+                                                       GenerationCache::makeKey(instructions, backend != nullptr ? backend->model : juce::String(), prompt, recentPrompts),
+                                                       backend != nullptr ? backend->buildRequestBody(instructions, buildRequestInput(prompt, recentPrompts), streaming) : juce::String(),
+                                                       streaming);
+    requestsInFlight++;
+
+    GenerationResult result;
+    result.requestId = session->requestId;
+    result.prompt = prompt;
+    result.backend = backend != nullptr ? backend->name : juce::String();
+    result.compactFormat = compactNotesEnabled;
+
+    // The built-in generator answers on this thread in well under a millisecond. Delivered asynchronously like a
+    // network response so callers see the same ordering 
+    if (policy == Policy::localOnly || (policy == Policy::localFirstThenRefine && backend == nullptr))
+    {
+        result.notes = LocalGenerator::generate(prompt);
+        result.fromLocal = true;
+        postResult(sharedState, this, session, result, callback);
+        return GenerationHandle({ session });
+    }
+
+    // Answer repeated requests from the cache 
+    if (! forceFresh)
+    {
+        if (auto cachedNotes = generationCache.lookup(session->cacheKey))
+        {
+            DBG("Generation cache hit: " + session->cacheKey);
+            result.notes = cachedNotes;
+            result.fromCache = true;
+            postResult(sharedState, this, session, result, callback);
+            return GenerationHandle({ session });
+        }
+    }
+
+    if (backend == nullptr)
+    {
+        DBG("Error: no generation backend configured");
+        result.error = "API key not set";
+        postResult(sharedState, this, session, result, callback);
+        return GenerationHandle({ session });
+    }
+
+    // Something to play while the remote model works; its result refines the draft when it arrives 
+    if (policy == Policy::localFirstThenRefine)
+    {
+        auto draft = result;
+        draft.notes = LocalGenerator::generate(prompt);
+        draft.fromLocal = true;
+        draft.provisional = true;
+        deliverDraft(session, draft, callback);
+    }
+
+    DBG("Request URL (" + backend->name + "): " + backend->endpoint);
+    DBG("Request Body: " + session->requestBody);
+
+    startAttempt(session, backend, result, callback);
+
+    // Hedge the slow tail: if no result has arrived by this backend's usual p95 latency, race a duplicate request against it 
+    if (hedgingEnabled && backend->getLatency().getNumSamples() >= MIN_HEDGE_SAMPLES)
+    {
+        const auto hedgeDelayMs = (int) std::ceil(backend->getLatency().getPercentile(HEDGE_PERCENTILE));
+        auto state = sharedState;
+        juce::Timer::callAfterDelay(hedgeDelayMs, [state, this, session, backend, result, callback, hedgeDelayMs]()
+        {
+            if (! state->isValid || ! session->canHedge())
+                return;
+
+            DBG("Hedging request " + juce::String(session->requestId) + " after " + juce::String(hedgeDelayMs) + " ms");
+            state->hedgesLaunched++;
+            startAttempt(session, backend, result, callback);
+        });
+    }
+
+    return GenerationHandle({ session });
 }
 
-juce::File Generator::createMidiFile(double bpm) {
-    juce::MidiFile midiFile;
-    juce::MidiMessageSequence track;
-    
-    // Parse the JSON to get note data with beat timing 
-    auto notesJson = juce::JSON::parse(sequenceJSON);
-    if (notesJson.isObject())
-    {
-        auto* notesObj = notesJson.getDynamicObject();
-        auto notesArray = notesObj->getProperty("notes");
-        
-        if (notesArray.isArray())
+/**
+ * @brief Remembers a session that has a request running, so the destructor can cancel it. Finished sessions are
+ *        dropped as new ones arrive 
+ * @param session The session to track
+ */
+void Generator::trackSession(const std::shared_ptr<GenerationSession>& session)
+{
+    liveSessions.erase(std::remove_if(liveSessions.begin(), liveSessions.end(), [&session](const auto& trackedSession)
+    {
+        const auto tracked = trackedSession.lock();
+        return tracked == nullptr || tracked->isFinished() || tracked == session;
+    }), liveSessions.end());
+
+    liveSessions.push_back(session);
+}
+
+/**
+ * @brief Runs one HTTP attempt of a session on the shared worker pool. The worker only reads the session's inputs and
+ *        reports back through the message thread; it never writes Generator state 
+ * @param session The request this attempt belongs to
+ * @param backend The backend the session's request body was built for
+ * @param result The result skeleton (id, prompt, variation position) to fill in
+ * @param callback Receives the result on the message thread
+ */
+void Generator::startAttempt(std::shared_ptr<GenerationSession> session, std::shared_ptr<GenerationBackend> backend,
+                             GenerationResult result, ResultCallback callback)
+{
+    auto state = sharedState;
+    int attempt = 0;
+    auto canceller = session->addAttempt(attempt);
+    const auto queuedAtMs = juce::Time::getMillisecondCounterHiRes();
+    trackSession(session);
+
+    // Send POST request on the shared worker pool to prevent freezing the UI. The client is captured by value so
+    // its pool outlives this Generator if the editor closes mid-request 
+    workerPool->addJob([state, this, session, backend, result, callback, attempt, canceller, queuedAtMs,
+                        client = httpClient, timeoutMs = requestTimeoutMs]() mutable
+    {
+        DBG("Starting HTTP request " + juce::String(session->requestId) + " (attempt " + juce::String(attempt) + ")");
+        session->setStatus(GenerationSession::Status::running);
+
+        const auto attemptStartMs = juce::Time::getMillisecondCounterHiRes();
+        result.queueWaitMs = attemptStartMs - queuedAtMs;
+
+        // Claims the result for this attempt the first time it produces something, recording how long that took 
+        bool claimed = false;
+        auto claimResult = [&]()
+        {
+            if (! claimed && session->claim(attempt))
+            {
+                claimed = true;
+                const auto firstResultMs = juce::Time::getMillisecondCounterHiRes() - attemptStartMs;
+                state->latency.record(firstResultMs);
+                backend->recordSuccess(firstResultMs);
+                if (attempt > 0)
+                    state->hedgesWon++;
+            }
+            return claimed;
+        };
+
+        // Every way an attempt can end goes through here; only the attempt that owns the outcome delivers it 
+        auto finish = [&](const juce::String& error)
+        {
+            if (error.isNotEmpty() && ! canceller->isCancelled())
+                backend->recordFailure(); // Steers the router away from a backend that keeps failing
+
+            if (! session->finishAttempt(attempt))
+                return;
+
+            result.error = canceller->isCancelled() && error.isNotEmpty() ? juce::String("Request cancelled") : error;
+            result.latencyMs = juce::Time::getMillisecondCounterHiRes() - queuedAtMs;
+            postResult(state, this, session, result, callback);
+        };
+
+        // Checked between reads of the response. A worker asked to exit (the pool is shutting down) cancels its attempt,
+        // which also aborts the read in progress 
+        auto shouldStop = [&canceller]()
         {
-            for (int i = 0; i < notesArray.size(); i++)
+            if (GenerationWorkerPool::shouldCurrentJobExit())
+                canceller->cancel();
+            return canceller->isCancelled();
+        };
+
+        // Output with no recoverable note is asked for again, a bounded number of times, rather than failing at once.
+        // Not once this attempt owns the result, since its notes may already be playing 
+        int outputRetries = 0;
+        auto retryUnrecoverable = [&](const juce::String& error)
+        {
+            if (outputRetries < MAX_OUTPUT_RETRIES && ! claimed && ! canceller->isCancelled())
+            {
+                ++outputRetries;
+                result.repairs = {};
+                DBG("Unrecoverable model output (" + error + ") - asking again");
+                return true;
+            }
+
+            finish(error);
+            return false;
+        };
+
+        for (;;)
+        {
+            if (shouldStop())
+            {
+                finish("Request cancelled");
+                return;
+            }
+
+            int statusCode = 0; // variable holding HTTP status code from response 
+
+            // Send the API request over the shared client, reusing an open connection when one is available 
+            auto stream = client->post(backend->endpoint, session->requestBody, backend->getHeaders(), timeoutMs, MAX_REDIRECTS, &statusCode, canceller);
+
+            // Handle connection errors (including this attempt being cancelled)
+            if (stream == nullptr)
+            {
+                DBG("Failed to create stream. Status code: " + juce::String(statusCode));
+                finish("Failed to connect (status " + juce::String(statusCode) + ")");
+                return; 
+            }
+
+            // Streamed success: feed output text deltas through the incremental parser as they arrive 
+            if (session->streaming && statusCode == 200)
             {
-                auto note = notesArray[i];
-                if (note.isObject())
+                juce::String streamedText;
+                juce::String streamError;
+
+                // Each completed note is repaired, then handed to the message thread, which forwards it to the audio
+                // thread. Only the attempt that produced the first note plays; a losing hedge is cancelled by the claim 
+                IncrementalNoteParser parser([state, this, session, &claimResult, &result](const NoteSpec& parsedNote)
                 {
-                    auto* noteObj = note.getDynamicObject();
-                    float startBeats = noteObj->getProperty("start_beats");
-                    float durationBeats = noteObj->getProperty("duration_beats");
-                    int midiNote = noteObj->getProperty("midi_note");
-                    int velocity = noteObj->getProperty("velocity");
-                    
-                    // Convert beats to MIDI ticks (480 ticks per quarter note is standard)
-                    double startTicks = startBeats * TICKS_PER_QUARTER_NOTE;
-                    double endTicks = (startBeats + durationBeats) * TICKS_PER_QUARTER_NOTE;
-    
-                    
-                    // Add note on
-                    track.addEvent(juce::MidiMessage::noteOn(scheduledMidiChannel, midiNote, (juce::uint8)velocity), startTicks);
-                    // Add note off
-                    track.addEvent(juce::MidiMessage::noteOff(scheduledMidiChannel, midiNote), endTicks);
+                    if (! claimResult())
+                        return;
+
+                    auto note = parsedNote;
+                    NoteRepair::repairNote(note, result.repairs);
+
+                    session->setStatus(GenerationSession::Status::streaming);
+                    juce::MessageManager::callAsync([state, this, session, note]()
+                    {
+                        if (state->isValid && ! session->isCancelled())
+                            appendStreamedNote(note, session->requestId);
+                    });
+                });
+
+                ServerSentEvents::read(*stream, [&](const juce::var& event)
+                {
+                    juce::String delta;
+                    if (! backend->readStreamEvent(event, delta))
+                        streamError = juce::JSON::toString(event, true);
+
+                    if (const auto outputTokens = backend->readOutputTokens(event); outputTokens > 0)
+                        result.outputTokens = outputTokens;
+
+                    if (delta.isNotEmpty())
+                    {
+                        streamedText << delta;
+                        parser.feed(delta);
+                    }
+                }, shouldStop);
+
+                DBG("Streamed " + juce::String(parser.getNumNotesEmitted()) + " notes");
+
+                // A cancelled or failed stream is a failure unless this attempt already owns the result 
+                if (streamError.isNotEmpty() || canceller->isCancelled())
+                {
+                    finish(streamError.isNotEmpty() ? streamError : juce::String("Request cancelled"));
+                    return;
                 }
+
+                // Responses that produced no streamed notes (wrapped in prose, a bare array...) fall back to a single
+                // repairing parse of the full text. Streamed notes are collected on the message thread, where the
+                // playing timeline lives
+                if (parser.getNumNotesEmitted() == 0)
+                {
+                    auto notes = NoteRepair::parse(streamedText, result.repairs);
+                    if (NoteSpecs::size(notes) == 0)
+                    {
+                        if (retryUnrecoverable("No notes in model output"))
+                            continue;
+                        return;
+                    }
+
+                    if (claimResult())
+                        result.notes = notes;
+                }
+
+                result.parts = NoteSpecs::partsFromJSON(streamedText);
+                finish({});
+                return;
+            }
+
+            // Read the entire response as a string
+            juce::String response = readResponseBody(*stream, shouldStop);
+            DBG("Status Code: " + juce::String(statusCode));
+            DBG("Raw response from " + backend->name + ":\n" + response);
+            
+            // Handle non-200 HTTP responses (and cancelled reads) as errors
+            if (statusCode != 200 || canceller->isCancelled())
+            {
+                finish("API error " + juce::String(statusCode) + ":\n" + response);
+                return;
+            }
+
+            // Parse on the worker: the note model is immutable, so it can be built anywhere and handed over whole 
+            const auto parsedResponse = juce::JSON::parse(response);
+            result.outputTokens = backend->readOutputTokens(parsedResponse);
+            const auto content = backend->extractOutputText(parsedResponse);
+            DBG("Extracted MIDI JSON: " + content);
+
+            // The only parse of this response's notes; malformed output is repaired here instead of re-requested 
+            auto notes = NoteRepair::parse(content, result.repairs);
+            if (NoteSpecs::size(notes) == 0)
+            {
+                if (retryUnrecoverable(content.isEmpty() ? "No model output in response" : "No notes in model output"))
+                    continue;
+                return;
             }
+
+            if (result.repairs.anyRepairs())
+                DBG("Repaired model output: " + result.repairs.describe());
+
+            claimResult();
+            result.notes = notes;
+            result.parts = NoteSpecs::partsFromJSON(content);
+            finish({});
+            return;
         }
+    });
+}
+
+/**
+ * @brief Hands a finished result to the message thread. Static so workers can call it without touching the Generator 
+ * @param state The Generator's shared state, checked on the message thread before the Generator is used
+ * @param generator The Generator that owns the session
+ * @param session The request the result belongs to
+ * @param result The finished result
+ * @param callback Receives the result unless the request was cancelled or the Generator no longer exists
+ */
+void Generator::postResult(std::shared_ptr<SharedState> state, Generator* generator, std::shared_ptr<GenerationSession> session,
+                           GenerationResult result, ResultCallback callback)
+{
+    juce::MessageManager::callAsync([state, generator, session, result, callback]()
+    {
+        // The callback belongs to the Generator's owner, so it is dropped along with the Generator 
+        if (state->isValid)
+            generator->deliverResult(*session, result, callback);
+    });
+}
+
+/**
+ * @brief Applies a finished result on the message thread: closes its streamed timeline, caches it, settles the
+ *        session's status and passes the result on to the caller 
+ * @param session The request the result belongs to
+ * @param result The finished result
+ * @param callback Receives the result unless the request was cancelled
+ */
+void Generator::deliverResult(GenerationSession& session, GenerationResult result, const ResultCallback& callback)
+{
+    jassert(juce::MessageManager::getInstance()->isThisTheMessageThread());
+    requestsInFlight--;
+
+    // A response that was playing while it streamed is closed even when cancelled, so its timeline can finish.
+    // Its notes were collected here as they arrived rather than on the worker 
+    if (streamingRequestId == session.requestId)
+    {
+        result.notes = finishStreamedSequence(&result.repairs);
+        result.streamed = true;
+
+        if (result.repairs.anyRepairs())
+            DBG("Repaired streamed output: " + result.repairs.describe());
     }
-    
-    // If no notes were added, return invalid file 
-    if (track.getNumEvents() == 0)
+    else if (auto held = heldStreams.find(session.requestId); held != heldStreams.end())
     {
-        DBG("No notes to write to MIDI file");
-        return juce::File();
+        // Streamed in while another sequence played, so it never opened a timeline: delivered like an unstreamed
+        // result, which the caller plays only if nothing is playing by now
+        NoteRepair::repairNotes(held->second, result.repairs);
+        result.notes = NoteSpecs::fromVector(std::move(held->second));
+        heldStreams.erase(held);
     }
-    
-    track.updateMatchedPairs();
-    midiFile.addTrack(track);
-    midiFile.setTicksPerQuarterNote(TICKS_PER_QUARTER_NOTE);
-    
-    // Create file in temp directory with timestamp for guaranteed uniqueness
-    juce::File tempDir = juce::File::getSpecialLocation(juce::File::tempDirectory);
-    juce::String timestamp = juce::String(juce::Time::currentTimeMillis());
-    juce::String filename = "generated_sequence_" + timestamp + ".mid";
-    juce::File midiFileOutput = tempDir.getChildFile(filename);
-    
+
+    if (session.isCancelled())
     {
-        juce::FileOutputStream outputStream(midiFileOutput);
-        if (outputStream.openedOk())
+        abandonLongForm(session.requestId);
+        return;
+    }
+
+    session.setStatus(result.succeeded() ? GenerationSession::Status::succeeded : GenerationSession::Status::failed);
+
+    if (result.succeeded() && ! result.fromCache && ! result.fromLocal && session.cacheKey.isNotEmpty())
+        generationCache.store(session.cacheKey, result.notes);
+
+    // Part names label the tracks of the MIDI files written from here on 
+    if (! result.parts.empty())
+    {
+        const juce::ScopedLock lock(noteModelLock);
+        for (const auto& part : result.parts)
+            partNames[part.channel] = part.name;
+    }
+
+    if (callback)
+        callback(result);
+}
+
+/**
+ * @brief Hands a provisional local draft to the caller on the message thread. Unlike deliverResult, the session stays
+ *        in flight, since the remote result for the same request follows 
+ * @param session The request the draft belongs to
+ * @param draft The local result, marked provisional
+ * @param callback Receives the draft unless the request was cancelled or has already finished
+ */
+void Generator::deliverDraft(std::shared_ptr<GenerationSession> session, GenerationResult draft, ResultCallback callback)
+{
+    auto state = sharedState;
+    juce::MessageManager::callAsync([state, session, draft, callback]()
+    {
+        if (state->isValid && ! session->isFinished() && callback)
+            callback(draft);
+    });
+}
+
+/**
+ * @brief Requests several variations of the same prompt concurrently on the shared worker pool. Each variation is
+ *        its own session and is delivered on the message thread as soon as it is ready, independently of the others 
+ * @param prompt The user's prompt
+ * @param recentPrompts Previous prompts, oldest first, sent as context
+ * @param numVariations Number of variations to request (clamped to 1-MAX_VARIATIONS)
+ * @param callback Called once per variation with its result. Not called for variations that were cancelled
+ * @param forceFresh Skip the generation cache and always ask the API 
+ * @return A handle that cancels every variation still in flight 
+ */
+GenerationHandle Generator::sendVariationsToGenerator(const juce::String& prompt,
+                                                      const juce::StringArray& recentPrompts,
+                                                      int numVariations,
+                                                      ResultCallback callback,
+                                                      bool forceFresh)
+{
+    numVariations = juce::jlimit(1, MAX_VARIATIONS, numVariations);
+    std::vector<std::shared_ptr<GenerationSession>> sessions;
+
+    for (int i = 0; i < numVariations; ++i)
+    {
+        // Each variation is its own request, nudged towards a different take so the results don't collapse into one 
+        juce::String variationPrompt = prompt;
+        if (numVariations > 1)
+            variationPrompt << "\n\nThis is variation " << (i + 1) << " of " << numVariations
+                            << ". Make it clearly different in rhythm, contour or voicing from the other variations"
+                            << " while still following the request.";
+
+        // Variations are requested without streaming: they land in the chat history rather than the playing timeline.
+        // Each is routed on its own, so a batch spreads across backends that are still being measured 
+        const auto backend = backendRouter.choose();
+        auto session = std::make_shared<GenerationSession>(++lastRequestId, prompt,
+                                                           GenerationCache::makeKey(instructions, backend != nullptr ? backend->model : juce::String(), variationPrompt, recentPrompts),
+                                                           backend != nullptr ? backend->buildRequestBody(instructions, buildRequestInput(variationPrompt, recentPrompts), false) : juce::String(),
+                                                           false);
+        sessions.push_back(session);
+        requestsInFlight++;
+
+        GenerationResult result;
+        result.requestId = session->requestId;
+        result.prompt = prompt;
+        result.variationIndex = i;
+        result.variationCount = numVariations;
+        result.backend = backend != nullptr ? backend->name : juce::String();
+        result.compactFormat = compactNotesEnabled;
+
+        if (policy == Policy::localOnly)
         {
-            midiFile.writeTo(outputStream);
-            outputStream.flush();
-            DBG("MIDI file created: " + midiFileOutput.getFullPathName());
-            
-            // Track this file for cleanup
-            createdMidiFiles.push_back(midiFileOutput);
+            result.notes = LocalGenerator::generate(prompt, i); // Each variation is seeded differently
+            result.fromLocal = true;
+            postResult(sharedState, this, session, result, callback);
+            continue;
         }
-        else
+
+        if (! forceFresh)
         {
-            DBG("Failed to create MIDI file");
-            return juce::File();
+            if (auto cachedNotes = generationCache.lookup(session->cacheKey))
+            {
+                result.notes = cachedNotes;
+                result.fromCache = true;
+                postResult(sharedState, this, session, result, callback);
+                continue;
+            }
         }
-    } // outputStream goes out of scope and closes here
-    
-    return midiFileOutput;
+
+        if (backend == nullptr)
+        {
+            result.error = "API key not set";
+            postResult(sharedState, this, session, result, callback);
+            continue;
+        }
+
+        startAttempt(session, backend, result, callback);
+    }
+
+    return GenerationHandle(std::move(sessions));
+}
+
+bool Generator::isTransformCommand(const juce::String& prompt) const
+{
+    return transformsEnabled && NoteSpecs::size(currentNotes) > 0 && ! NoteTransform::parseCommand(prompt).empty();
+}
+
+bool Generator::isLongFormPrompt(const juce::String& prompt) const
+{
+    return longFormEnabled && LongFormPlan::make(prompt).isLongForm();
 }
 
 /**
- * @brief Sends user's prompt to OpenAI API and handle JSON response 
- * @param prompt User's prompt 
- * @param recentPrompts An array of the recent prompts to provide context to the API
- * @param callback A function to call that takes in a juce::String with the API response once it has been received and processed 
+ * @brief Requests a long piece section by section. Every section is its own session on the shared worker pool, asked
+ *        for with the plan's shared header so the sections agree on key, meter and motif, and all of them are in
+ *        flight at once. Sections are appended to one playing timeline in beat order as they arrive 
+ * @param prompt The user's prompt
+ * @param recentPrompts Previous prompts, oldest first, sent as context
+ * @param onSection Called for each section, in beat order, once it has joined the timeline
+ * @param onComplete Called once with the whole piece. Not called if the request is cancelled
+ * @param forceFresh Skip the generation cache and always ask the API 
+ * @return A handle that cancels every section still in flight 
  */
-void Generator::sendToGenerator(const juce::String& prompt,
-                                const juce::StringArray& recentPrompts,
-                                std::function<void(juce::String)> callback)
+GenerationHandle Generator::sendLongFormToGenerator(const juce::String& prompt,
+                                                    const juce::StringArray& recentPrompts,
+                                                    ResultCallback onSection,
+                                                    ResultCallback onComplete,
+                                                    bool forceFresh)
 {
-    if (apiKey.isEmpty())
+    auto assembly = std::make_shared<LongFormAssembly>();
+    assembly->plan = LongFormPlan::make(prompt);
+    if (! longFormEnabled || ! assembly->plan.isLongForm())
+        return sendToGenerator(prompt, recentPrompts, onComplete, forceFresh);
+
+    const int numSections = (int) assembly->plan.sections.size();
+    assembly->timelineId = ++lastRequestId;
+    assembly->sections.resize((size_t) numSections);
+    assembly->arrived.assign((size_t) numSections, false);
+    assembly->piece.requestId = assembly->timelineId;
+    assembly->piece.prompt = prompt;
+    assembly->piece.sectionCount = numSections;
+    assembly->piece.compactFormat = compactNotesEnabled;
+    assembly->onSection = std::move(onSection);
+    assembly->onComplete = std::move(onComplete);
+    longForms.push_back(assembly);
+
+    DBG("Long-form request " + juce::String(assembly->timelineId) + ": " + juce::String(numSections) + " sections\n" + assembly->plan.header);
+
+    // Sections are delivered like any other result, so they are cached and counted in flight on their own 
+    auto sectionCallback = [this, assembly](const GenerationResult& section) { receiveLongFormSection(assembly, section); };
+    std::vector<std::shared_ptr<GenerationSession>> sessions;
+
+    for (int i = 0; i < numSections; ++i)
     {
-        DBG("Error: API key not set");
-        if (callback)
-            callback("Error: API key not set");
-        return;
+        // Sections are requested without streaming: each joins the timeline whole, once every earlier one has 
+        const auto sectionPrompt = LongFormPlan::buildSectionPrompt(assembly->plan, i);
+        const auto backend = backendRouter.choose();
+        auto session = std::make_shared<GenerationSession>(++lastRequestId, prompt,
+                                                           GenerationCache::makeKey(instructions, backend != nullptr ? backend->model : juce::String(), sectionPrompt, recentPrompts),
+                                                           backend != nullptr ? backend->buildRequestBody(instructions, buildRequestInput(sectionPrompt, recentPrompts), false) : juce::String(),
+                                                           false);
+        if (i == 0)
+            assembly->firstRequestId = session->requestId;
+        assembly->lastRequestId = session->requestId;
+        sessions.push_back(session);
+        requestsInFlight++;
+
+        GenerationResult result;
+        result.requestId = session->requestId;
+        result.prompt = prompt;
+        result.sectionIndex = i;
+        result.sectionCount = numSections;
+        result.sectionName = assembly->plan.sections[(size_t) i].name;
+        result.backend = backend != nullptr ? backend->name : juce::String();
+        result.compactFormat = compactNotesEnabled;
+
+        if (policy == Policy::localOnly)
+        {
+            result.notes = LongFormPlan::generateLocally(assembly->plan, i);
+            result.fromLocal = true;
+            postResult(sharedState, this, session, result, sectionCallback);
+            continue;
+        }
+
+        if (! forceFresh)
+        {
+            if (auto cachedNotes = generationCache.lookup(session->cacheKey))
+            {
+                result.notes = cachedNotes;
+                result.fromCache = true;
+                postResult(sharedState, this, session, result, sectionCallback);
+                continue;
+            }
+        }
+
+        if (backend == nullptr)
+        {
+            result.error = "API key not set";
+            postResult(sharedState, this, session, result, sectionCallback);
+            continue;
+        }
+
+        startAttempt(session, backend, result, sectionCallback);
     }
 
-    // Set loading flag at the start
-    loading = true;
+    return GenerationHandle(std::move(sessions));
+}
 
-    // Build JSON request
-    juce::String requestInput = apiInstructions;
-    if (recentPrompts.size() > 0)
+/**
+ * @brief Places an arrived section in its piece and appends every section that is now next in beat order to the
+ *        playing timeline. Once the last section is in, closes the timeline and delivers the whole piece 
+ * @param assembly The piece the section belongs to
+ * @param section The section's result, timed from the start of the section
+ */
+void Generator::receiveLongFormSection(std::shared_ptr<LongFormAssembly> assembly, GenerationResult section)
+{
+    jassert(juce::MessageManager::getInstance()->isThisTheMessageThread());
+
+    const auto index = (size_t) section.sectionIndex;
+    const auto& planned = assembly->plan.sections[index];
+
+    // A section that failed is filled in locally, so the piece has no hole in it 
+    if (! section.succeeded())
     {
+        DBG("Long-form section " + planned.name + " failed (" + section.error + ") - generating it locally");
+        section.notes = LongFormPlan::generateLocally(assembly->plan, (int) index);
+        section.fromLocal = true;
+        section.error = {};
+    }
 
-        // Add recent prompts as context to the request input 
-        requestInput << "\n\nContext from previous user prompts (oldest to newest):";
-        for (int i = 0; i < recentPrompts.size(); ++i)
-            requestInput << "\n- Previous prompt " + juce::String(i + 1) + ": " + recentPrompts[i];
+    // Move the section to its place in the piece, dropping anything the model wrote past the section's end 
+    std::vector<NoteSpec> placed;
+    placed.reserve(section.notes->size());
+    for (auto note : *section.notes)
+    {
+        if (note.startBeats >= planned.getLengthBeats())
+            continue;
+
+        note.startBeats += (float) planned.startBeats;
+        placed.push_back(note);
     }
-    requestInput << "\n\nCurrent user prompt:\n" + prompt;
 
-    juce::DynamicObject::Ptr jsonBody = new juce::DynamicObject();
-    jsonBody->setProperty("model", "gpt-5.2-2025-12-11");
-    jsonBody->setProperty("input", requestInput);
+    if (placed.size() < section.notes->size())
+        DBG("Long-form section " + planned.name + ": dropped " + juce::String((int) (section.notes->size() - placed.size())) + " notes past its end");
 
-    // Create nested JSON object to force API to return a JSON response that can be easily parsed 
-    juce::DynamicObject::Ptr formatConfig = new juce::DynamicObject();
-    formatConfig->setProperty("type", "json_object");
-    juce::DynamicObject::Ptr textConfig = new juce::DynamicObject();
-    textConfig->setProperty("format", juce::var(formatConfig.get()));
-    jsonBody->setProperty("text", juce::var(textConfig.get()));
+    section.notes = NoteSpecs::fromVector(std::move(placed));
+    assembly->sections[index] = section;
+    assembly->arrived[index] = true;
 
-    juce::String jsonString = juce::JSON::toString(juce::var(jsonBody.get()));
+    // Sections join the timeline in beat order, so a section that arrives early waits for every earlier one 
+    while (assembly->nextToAppend < assembly->sections.size() && assembly->arrived[assembly->nextToAppend])
+    {
+        auto& next = assembly->sections[assembly->nextToAppend++];
 
-    DBG("Request URL: " + apiEndpoint);
-    DBG("Request Body: " + jsonString);
+        // A newer request or a replay has taken the timeline over, or another sequence was still playing when the
+        // piece would have started: keep collecting the piece without playing it 
+        if (assembly->playing && assembly->timelineOpened && streamingRequestId != assembly->timelineId)
+            assembly->playing = false;
+        if (assembly->playing && ! assembly->timelineOpened && NoteSpecs::size(next.notes) > 0 && isSequencePlaying())
+            assembly->playing = false;
 
-    // Build POST request 
-    juce::URL url = juce::URL(apiEndpoint).withPOSTData(jsonString);
-    auto options = juce::URL::InputStreamOptions(juce::URL::ParameterHandling::inAddress)
-        .withExtraHeaders(
-            "Content-Type: application/json\r\n"
-            "Authorization: Bearer " + apiKey
-        )
-        .withConnectionTimeoutMs(MAX_TIMEOUT_MS)
-        .withNumRedirectsToFollow(MAX_REDIRECTS);
+        if (assembly->playing)
+        {
+            // A section that arrives after its start has played loses the notes already passed. Moving them all to
+            // the playhead would sound them as one chord; the rest of the section still plays in time 
+            for (const auto& note : *next.notes)
+                appendStreamedNote(note, assembly->timelineId, false);
 
+            assembly->timelineOpened = assembly->timelineOpened || NoteSpecs::size(next.notes) > 0;
+            setCurrentNotes(NoteSpecs::fromVector(streamedNotes)); // Exports include every section that has arrived so far
+        }
 
-    // Send POST request on a background thread to prevent freezing the UI 
-    auto state = sharedState;
-    juce::Thread::launch([state, url, options, callback, this]() mutable
+        next.streamed = assembly->playing;
+        if (assembly->onSection)
+            assembly->onSection(next);
+    }
+
+    if (assembly->nextToAppend < assembly->sections.size())
+        return;
+
+    // Every section is in: close the timeline and hand over the whole piece 
+    auto piece = assembly->piece;
+    std::vector<NoteSpec> allNotes;
+    piece.fromLocal = true;
+    for (const auto& part : assembly->sections)
     {
-        DBG("Starting HTTP request...");
+        allNotes.insert(allNotes.end(), part.notes->begin(), part.notes->end());
+        piece.fromLocal = piece.fromLocal && part.fromLocal;
+        piece.outputTokens += part.outputTokens;
+        piece.latencyMs = juce::jmax(piece.latencyMs, part.latencyMs);
+        piece.repairs.merge(part.repairs);
+        if (piece.backend.isEmpty())
+            piece.backend = part.backend;
+    }
 
-        int statusCode = 0; // variable holding HTTP status code from response 
+    if (assembly->playing && assembly->timelineOpened && streamingRequestId == assembly->timelineId)
+    {
+        piece.notes = finishStreamedSequence(&piece.repairs);
+        piece.streamed = true;
+    }
+    else
+    {
+        piece.notes = NoteSpecs::fromVector(std::move(allNotes));
+    }
 
-        auto stream = url.createInputStream(options.withStatusCode(&statusCode)); // Send the API request and capture pointer to input stream + HTTP status code 
+    longForms.erase(std::remove(longForms.begin(), longForms.end(), assembly), longForms.end());
 
-        // Handle connection errors
-        if (stream == nullptr)
-        {
-            DBG("Failed to create stream. Status code: " + juce::String(statusCode));
+    if (assembly->onComplete)
+        assembly->onComplete(piece);
+}
 
-            // Call back on main thread to update UI and trigger any callbacks, but only if Generator is still valid
-            juce::MessageManager::callAsync([state, callback, statusCode, this]()
-            {
-                if (state->isValid)
-                {
-                    loading = false;
-                }
-                if (callback)
-                    callback("Error: Failed to connect (status " + juce::String(statusCode) + ")");
-            });
-            return; 
-        }
+/**
+ * @brief Drops a piece when one of its sections is cancelled, closing its timeline so playback can finish 
+ * @param requestId The cancelled session
+ */
+void Generator::abandonLongForm(int requestId)
+{
+    for (auto it = longForms.begin(); it != longForms.end(); ++it)
+    {
+        const auto assembly = *it;
+        if (requestId < assembly->firstRequestId || requestId > assembly->lastRequestId)
+            continue;
+
+        if (streamingRequestId == assembly->timelineId)
+            finishStreamedSequence();
 
-        // Read the entire response as a string
-        juce::String response = stream->readEntireStreamAsString();
-        DBG("Status Code: " + juce::String(statusCode));
-        DBG("OpenAI Raw Response:\n" + response);
-        
-        // Handle non-200 HTTP responses as errors
-        if (statusCode != 200)
+        longForms.erase(it);
+        return;
+    }
+}
+
+/**
+ * @brief Regenerates one beat range of a phrase. Only the notes around the range are sent, so the request costs a
+ *        fraction of a full phrase, and the result is spliced into the phrase instead of replacing it 
+ * @param notes The phrase to edit
+ * @param startBeats Start of the range
+ * @param endBeats End of the range (exclusive)
+ * @param prompt What the range should become, e.g. "busier, more syncopated"
+ * @param callback Called on the message thread with the whole spliced phrase. Not called if the request is cancelled
+ * @return A handle that cancels the request 
+ */
+GenerationHandle Generator::regenerateRange(const NoteSpecArray& notes, double startBeats, double endBeats,
+                                            const juce::String& prompt, ResultCallback callback)
+{
+    jassert(endBeats > startBeats);
+
+    // Never answered from the cache: asking for the same range again should give a new take 
+    const auto backend = backendRouter.choose();
+    auto session = std::make_shared<GenerationSession>(++lastRequestId, prompt, juce::String(),
+                                                       backend != nullptr ? backend->buildRequestBody(instructions, buildRangeInput(notes, startBeats, endBeats, prompt), false) : juce::String(),
+                                                       false);
+    requestsInFlight++;
+
+    GenerationResult result;
+    result.requestId = session->requestId;
+    result.prompt = prompt;
+    result.backend = backend != nullptr ? backend->name : juce::String();
+    result.compactFormat = compactNotesEnabled;
+    result.rangeStartBeats = startBeats;
+    result.rangeEndBeats = endBeats;
+
+    // The new notes are spliced in on the message thread, where the playing timeline and the export track live 
+    auto spliceCallback = [this, notes, startBeats, endBeats, callback](const GenerationResult& rangeResult)
+    {
+        auto spliced = rangeResult;
+        if (rangeResult.succeeded())
+            spliced.notes = spliceRegeneratedRange(notes, startBeats, endBeats, *rangeResult.notes);
+
+        if (callback)
+            callback(spliced);
+    };
+
+    if (policy == Policy::localOnly)
+    {
+        auto hints = LocalGenerator::parseHints(prompt);
+        hints.bars = juce::jmax(1, (int) std::ceil((endBeats - startBeats) / 4.0));
+
+        std::vector<NoteSpec> rangeNotes;
+        for (auto note : *LocalGenerator::generate(hints, prompt.hashCode64() + session->requestId))
         {
-            juce::MessageManager::callAsync([state, callback, response, statusCode, this]()
-            {
-                if (state->isValid)
-                {
-                    loading = false;
-                }
-                if (callback)
-                    callback("API error " + juce::String(statusCode) + ":\n" + response);
-            });
-            return;
+            note.startBeats += (float) startBeats;
+            rangeNotes.push_back(note);
         }
 
-        // Queue callback on main thread in the case of a successful response
-        juce::MessageManager::callAsync([state, this, callback, response]()
+        result.notes = NoteSpecs::fromVector(std::move(rangeNotes));
+        result.fromLocal = true;
+        postResult(sharedState, this, session, result, spliceCallback);
+        return GenerationHandle({ session });
+    }
+
+    if (backend == nullptr)
+    {
+        result.error = "API key not set";
+        postResult(sharedState, this, session, result, spliceCallback);
+        return GenerationHandle({ session });
+    }
+
+    DBG("Regenerating beats " + juce::String(startBeats) + "-" + juce::String(endBeats) + " (" + backend->name + ")");
+    startAttempt(session, backend, result, spliceCallback);
+    return GenerationHandle({ session });
+}
+
+/**
+ * @brief Splices regenerated notes into a phrase. When the phrase is the one playing, removing the old range and
+ *        inserting the new notes goes through the streamed-note queue, so the playing timeline is edited rather than
+ *        republished. Only the part of the range that has not played yet changes: new notes whose start has passed
+ *        are dropped from the timeline (they are still in the returned phrase) 
+ * @param notes The phrase the range was regenerated for
+ * @param startBeats Start of the range
+ * @param endBeats End of the range (exclusive)
+ * @param generated The notes the model returned for the range
+ * @return The spliced phrase
+ */
+NoteSpecArray Generator::spliceRegeneratedRange(const NoteSpecArray& notes, double startBeats, double endBeats, std::vector<NoteSpec> generated)
+{
+    // Models sometimes time the range from zero despite being asked not to 
+    if (startBeats > 0.0 && NoteSpecs::inRange(NoteSpecs::fromVector(generated), startBeats, endBeats).empty())
+        for (auto& note : generated)
+            note.startBeats += (float) startBeats;
+
+    const auto inserted = NoteSpecs::inRange(NoteSpecs::fromVector(std::move(generated)), startBeats, endBeats);
+    const auto spliced = NoteSpecs::spliceRange(notes, startBeats, endBeats, inserted);
+    DBG("Spliced " + juce::String((int) inserted.size()) + " notes into beats " + juce::String(startBeats) + "-" + juce::String(endBeats));
+
+    if (notes == currentNotes)
+        setCurrentNotes(spliced);
+
+    if (notes != nullptr && notes == timelineNotes && streamingRequestId == 0)
+    {
+        enqueueStreamedNote({ currentSequenceId, {}, startBeats, endBeats, false, true });
+        for (const auto& spec : inserted)
         {
-            if (state->isValid)
-            {
-                // Parse the sequence JSON on the main thread 
-                getSequenceJSON(response);
-                loading = false;
-            }
-            
-            if (callback)
-                callback("Kiwi");
-        });
-    });
-    
-}
\ No newline at end of file
+            const auto note = createNote(spec);
+            enqueueStreamedNote({ currentSequenceId, note.getNoteEvent(), note.getOnBeats(), note.getOffBeats(), false, false, true });
+        }
+        timelineNotes = spliced;
+    }
+
+    return spliced;
+}
+
+/**
+ * @brief Makes the given notes the current note model, e.g. to play a chosen variation 
+ * @param notes The notes to play and export next
+ */
+void Generator::setCurrentNotes(NoteSpecArray notes)
+{
+    const juce::ScopedLock lock(noteModelLock);
+    currentNotes = std::move(notes);
+}
+
+/**
+ * @brief Gets the current note model. Safe to call from any thread, e.g. while the host saves the project
+ */
+NoteSpecArray Generator::getCurrentNotes() const
+{
+    const juce::ScopedLock lock(noteModelLock);
+    return currentNotes;
+}
+
+std::map<int, juce::String> Generator::getPartNames() const
+{
+    const juce::ScopedLock lock(noteModelLock);
+    return partNames;
+}
+
+void Generator::setPartNames(std::map<int, juce::String> names)
+{
+    const juce::ScopedLock lock(noteModelLock);
+    partNames = std::move(names);
+}
@@ -1,6 +1,21 @@
 #pragma once
 #include <JuceHeader.h>
 #include "MidiNote.h"
+#include "NoteSpec.h"
+#include "SequenceScheduler.h"
+#include "SequenceHandoff.h"
+#include "IncrementalNoteParser.h"
+#include "GenerationCache.h"
+#include "HttpClient.h"
+#include "GenerationWorkerPool.h"
+#include "GenerationSession.h"
+#include "LatencyTracker.h"
+#include "LocalGenerator.h"
+#include "GenerationBackend.h"
+#include "LongFormPlan.h"
+#include "NoteTransform.h"
+#include "MidiFileWriter.h"
+#include "MidiExport.h"
 
 class Generator 
 {
@@ -13,25 +28,125 @@ public:
     {
         std::atomic<bool> isValid{true};
         juce::CriticalSection lock; 
+        LatencyTracker latency;                 // Time from request start to first result (first note when streaming), all backends
+        std::atomic<int> hedgesLaunched { 0 };
+        std::atomic<int> hedgesWon { 0 };
     };
     
+    using ResultCallback = std::function<void(const GenerationResult&)>;
+
+    // Where results come from. localFirstThenRefine delivers a provisional local draft straight away and then the
+    // remote result for the same request
+    enum class Policy { remoteOnly, localOnly, localFirstThenRefine };
+
     // Send text to OpenAI API and get response via callback.
     // recentPrompts provides short rolling context from previous requests.
-    void sendToGenerator(const juce::String& prompt,
-                         const juce::StringArray& recentPrompts,
-                         std::function<void(juce::String)> callback);
-    void extractSequence(double bpm, double sampleRate);
-    void processSequence(int blockSize, juce::MidiBuffer& midiMessages);
+    // Identical requests are answered from the on-disk generation cache unless forceFresh is set.
+    // Each request is its own GenerationSession; its result is delivered to the callback as an owned value.
+    // The returned handle cancels the request; cancelled requests never invoke their callback.
+    // Under localFirstThenRefine the callback runs twice: once with a provisional local draft, then with the remote result.
+    // A prompt made only of mechanical edits ("transpose up a fifth", "quantize to 1/16") is applied to the current
+    // notes by NoteTransform instead of being sent.
+    GenerationHandle sendToGenerator(const juce::String& prompt,
+                                     const juce::StringArray& recentPrompts,
+                                     ResultCallback callback,
+                                     bool forceFresh = false);
+    bool isTransformCommand(const juce::String& prompt) const;
+    // Fan out numVariations independent sessions on the shared worker pool; callback runs once per variation.
+    // Variations are generated locally under localOnly and remotely otherwise.
+    GenerationHandle sendVariationsToGenerator(const juce::String& prompt,
+                                               const juce::StringArray& recentPrompts,
+                                               int numVariations,
+                                               ResultCallback callback,
+                                               bool forceFresh = false);
+    // Split a long request ("32-bar song with intro, verse, chorus") into sections that share a key, meter and motif,
+    // request them concurrently and stitch them together in beat order. The piece starts playing with its first
+    // section; onSection runs for each section once it has joined the timeline, onComplete once with the whole piece.
+    // Prompts that are not long-form are sent as a single request, delivered to onComplete.
+    GenerationHandle sendLongFormToGenerator(const juce::String& prompt,
+                                             const juce::StringArray& recentPrompts,
+                                             ResultCallback onSection,
+                                             ResultCallback onComplete,
+                                             bool forceFresh = false);
+    bool isLongFormPrompt(const juce::String& prompt) const;
+    // Regenerate the notes that start in [startBeats, endBeats) of a phrase, sending only the notes around the range
+    // as context. The callback receives the whole phrase with the new notes spliced in. If the phrase is the one
+    // playing, only that range of the playing timeline is replaced.
+    GenerationHandle regenerateRange(const NoteSpecArray& notes, double startBeats, double endBeats,
+                                     const juce::String& prompt, ResultCallback callback);
+    void prepareToPlay(int maxNotes);
+    void extractSequence(int requestId = 0);
+    bool isSequencePlaying() const;
+    bool startPublishedSequence(juce::MidiBuffer& midiMessages);
+    void processSequence(const SequenceScheduler::HostPosition& position, int blockSize, juce::MidiBuffer& midiMessages);
     bool isSequenceFinished();
-    bool getLoadingStatus() const { return loading; }
-    void resetSequence();
-    juce::File createMidiFile(double bpm);
-    int getNoteCountFromSequenceJSON() const;
-
-    std::vector<MidiNote> getNoteSequence() const { return noteSequence; }
+    bool getLoadingStatus() const { return requestsInFlight.load() > 0; }
+    int getCacheHitCount() const { return generationCache.getHitCount(); }
+    int getCacheMissCount() const { return generationCache.getMissCount(); }
+    MidiExportPtr createMidiExport(double bpm);
+    MidiExportPtr createMidiExport(const NoteSpecArray& notes, double bpm);
+    void setCurrentNotes(NoteSpecArray notes);
+    std::map<int, juce::String> getPartNames() const;
+    void setPartNames(std::map<int, juce::String> names);
+    int getWorkerCount() const { return workerPool->getNumWorkers(); }
+    int getQueuedRequestCount() const { return workerPool->getNumQueuedJobs(); }
+    double getLatencyPercentileMs(double fraction) const { return sharedState->latency.getPercentile(fraction); }
+    int getHedgesLaunched() const { return sharedState->hedgesLaunched.load(); }
+    int getHedgesWon() const { return sharedState->hedgesWon.load(); }
+    int getNoteCount() const { return NoteSpecs::size(getCurrentNotes()); }
+    NoteSpecArray getCurrentNotes() const;
+    void setLaunchQuantization(SequenceScheduler::LaunchQuantization newQuantization) { launchQuantization = newQuantization; }
+    void setPolicy(Policy newPolicy) { policy = newPolicy; }
+    Policy getPolicy() const { return policy; }
+    bool isCompactNoteFormatEnabled() const { return compactNotesEnabled; }
 
 private:
-    void getSequenceJSON(const juce::String& apiResponse);
+    // A streamed note (or end-of-stream marker) on its way from the message thread to the audio thread
+    struct QueuedNote
+    {
+        int sequenceId = 0;
+        MidiNoteEvent note {};
+        double onBeats = 0.0;
+        double offBeats = 0.0;
+        bool endOfStream = false;
+        bool removeRange = false; // Remove the unplayed notes that start in [onBeats, offBeats) instead of adding one
+        bool dropIfLate = false;  // Dropped rather than moved to the playhead if already passed (regenerated ranges, long-form sections)
+    };
+
+    // A long-form piece whose sections are still arriving. Message thread only
+    struct LongFormAssembly
+    {
+        LongFormPlan::Plan plan;
+        int timelineId = 0;                     // Stream id the sections are appended to the playing timeline under
+        int firstRequestId = 0;                 // Section sessions have consecutive ids
+        int lastRequestId = 0;
+        std::vector<GenerationResult> sections; // By section index, placed at their beat in the piece
+        std::vector<bool> arrived;
+        size_t nextToAppend = 0;                // First section not yet on the timeline; later ones wait for it
+        bool playing = true;                    // Still feeding the timeline (false once another request takes it over)
+        bool timelineOpened = false;
+        GenerationResult piece;                 // Skeleton of the whole-piece result
+        ResultCallback onSection, onComplete;
+    };
+
+    void trackSession(const std::shared_ptr<GenerationSession>& session);
+    void startAttempt(std::shared_ptr<GenerationSession> session, std::shared_ptr<GenerationBackend> backend,
+                      GenerationResult result, ResultCallback callback);
+    static void postResult(std::shared_ptr<SharedState> state, Generator* generator, std::shared_ptr<GenerationSession> session,
+                           GenerationResult result, ResultCallback callback);
+    void deliverResult(GenerationSession& session, GenerationResult result, const ResultCallback& callback);
+    void deliverDraft(std::shared_ptr<GenerationSession> session, GenerationResult draft, ResultCallback callback);
+    void receiveLongFormSection(std::shared_ptr<LongFormAssembly> assembly, GenerationResult section);
+    void abandonLongForm(int requestId);
+    juce::String buildRequestInput(const juce::String& prompt, const juce::StringArray& recentPrompts) const;
+    juce::String buildRangeInput(const NoteSpecArray& notes, double startBeats, double endBeats, const juce::String& prompt) const;
+    NoteSpecArray spliceRegeneratedRange(const NoteSpecArray& notes, double startBeats, double endBeats, std::vector<NoteSpec> generated);
+    MidiNote createNote(const NoteSpec& spec) const;
+    void publishTimeline(std::unique_ptr<SequenceScheduler> timeline);
+    void appendStreamedNote(const NoteSpec& spec, int requestId, bool playIfLate = true);
+    NoteSpecArray finishStreamedSequence(NoteRepair::Report* repairs = nullptr);
+    void enqueueStreamedNote(const QueuedNote& item);
+    void drainStreamedNotes(SequenceScheduler& scheduler);
   juce::String loadApiKey() const;
     
   juce::String apiKey;
@@ -42,18 +157,7 @@ private:
     You MUST return ONLY valid JSON in the exact format below.
     Do NOT include explanations, comments, or extra text.
 
-    Output format:
-    {
-      "notes": [
-        {
-          "start_beats": 0.0,
-          "duration_beats": 0.5,
-          "midi_note": 60,
-          "velocity": 100
-        }
-      ]
-    }
-
+{output_format}
     Timing rules:
     - 1 beat = 1 quarter note
     - start_beats and duration_beats are in beats
@@ -86,14 +190,74 @@ private:
     - Be musically creative ONLY within the constraints above.
     )";
 
-    juce::String apiEndpoint = "https://api.openai.com/v1/responses";
-    juce::String sequenceJSON; 
+    // Spliced into {output_format} above. The compact form spends roughly a third of the output tokens per note
+    const juce::String verboseOutputFormat = R"(    Output format:
+    {
+      "notes": [
+        {
+          "start_beats": 0.0,
+          "duration_beats": 0.5,
+          "midi_note": 60,
+          "velocity": 100
+        }
+      ]
+    }
+)";
+    const juce::String compactOutputFormat = R"(    Output format (compact, no whitespace):
+    {"notes":[[0,0.5,60,100],[0.5,0.5,62,96]]}
+    Each note is [start_beats, duration_beats, midi_note, velocity].
+)";
+    // Appended to either format above unless KIWI_MULTI_PART is off, so drums, bass and chords come back in one response
+    const juce::String multiPartOutputFormat = R"(
+    Multiple parts:
+    - If the request asks for more than one instrument or part (e.g. drums, bass and chords), add a "parts" list
+      before "notes" that names each part and gives it its own MIDI channel (1-16, drums on 10):
+      "parts": [{"name": "drums", "channel": 10}, {"name": "bass", "channel": 2}]
+    - Give every note its part's channel: a "channel" field, or a fifth element in the compact form
+    - All parts share the one "notes" array, ordered by start_beats
+    - For a single part, leave out "parts" and "channel"
+)";
+    juce::String instructions; // apiInstructions with the selected output format, built once in the constructor
+
+    BackendRouter backendRouter; // OpenAI (KIWI_GENERATOR_ENDPOINT/KIWI_OPENAI_MODEL) plus an optional KIWI_LOCAL_MODEL_ENDPOINT server
+    bool compactNotesEnabled = false; // Ask for [start,dur,pitch,vel] tuples and send history back compactly (KIWI_COMPACT_NOTES)
+    bool multiPartEnabled = true; // Let one response carry several parts, each on its own MIDI channel (KIWI_MULTI_PART)
+    std::map<int, juce::String> partNames; // Latest part name for each channel, used to name multi-part MIDI tracks
+    bool streamingEnabled = true; // Consume the response as server-sent events and start playback as notes arrive (KIWI_STREAMING_ENABLED)
+    NoteSpecArray currentNotes; // Note model of the latest response, parsed exactly once
+    // Guards currentNotes and partNames: hosts save projects from their own threads. Both are only written on the
+    // message thread, under this lock, so the message thread reads them without it
+    mutable juce::CriticalSection noteModelLock;
+    NoteSpecArray timelineNotes; // Note model the latest published timeline was built from, null while one is streaming
+    MidiFileWriter midiFileWriter; // Writes exported models straight to SMF bytes, reusing its buffers between exports
+    std::vector<NoteSpec> streamedNotes; // Notes of the response currently streaming in, frozen into currentNotes when it ends
     std::vector<MidiNote> noteSequence;
-    std::vector<juce::File> createdMidiFiles; // Track files for cleanup
-    int sequenceTracker = 0; // Keeps track of how many notes in the sequence have finished playing to determine overall sequence completion ()
-    int triggerDelaySamples = 10;
+    SequenceHandoff<SequenceScheduler> playbackHandoff; // Hands prepared timelines from the message thread to the audio thread
+    int currentSequenceId = 0; // Id of the most recently published timeline
+    GenerationCache generationCache; // Persistent cache of previous generations keyed by request contents
+    juce::SharedResourcePointer<HttpClient> httpClient; // Shared with AnalyticsService
+    juce::SharedResourcePointer<GenerationWorkerPool> workerPool; // Bounded threads that run every generation request
+    int requestTimeoutMs = 0; // Per-request connection/read timeout: MAX_TIMEOUT_MS unless KIWI_REQUEST_TIMEOUT_MS is set
+
+    // Single-producer/single-consumer queue of streamed notes (message thread -> audio thread)
+    static constexpr int streamedNoteQueueSize = 1024;
+    juce::AbstractFifo streamedNoteFifo { streamedNoteQueueSize };
+    std::vector<QueuedNote> streamedNoteQueue;
+    std::atomic<int> maxSequenceLength { 2048 }; // Longer sequences are truncated so the preallocated real-time buffers always suffice. Set by prepareToPlay on the host's thread, read on the message thread
+    SequenceScheduler::LaunchQuantization launchQuantization = SequenceScheduler::LaunchQuantization::nextBeat;
     int scheduledMidiChannel = 1;
-    bool loading = false; 
+    std::atomic<int> requestsInFlight { 0 }; // Requests (or variations) whose outcome hasn't been delivered yet
+    int lastRequestId = 0; // Monotonic id of the most recent session (message thread only)
+    std::vector<std::weak_ptr<GenerationSession>> liveSessions; // Sessions with a request running, cancelled on destruction (message thread only)
+    int streamingRequestId = 0; // Request whose streamed notes are feeding the current timeline, 0 if none
+    int timelineRequestId = 0; // Request the latest published timeline plays, 0 for a replay (message thread only)
+    std::map<int, std::vector<NoteSpec>> heldStreams; // Responses streaming in while another sequence plays, by request; never played
+    std::atomic<bool> sequencePlaying { false }; // Written by the audio thread: the active timeline hasn't finished
+    std::vector<std::shared_ptr<LongFormAssembly>> longForms; // Pieces whose sections are still arriving
+    bool longFormEnabled = true; // Split long requests into concurrently generated sections (KIWI_LONG_FORM)
+    bool transformsEnabled = true; // Apply mechanical edits of the current notes locally (KIWI_LOCAL_TRANSFORMS)
+    bool hedgingEnabled = false; // Race a duplicate request once one runs past the p95 latency (KIWI_HEDGE_REQUESTS)
+    Policy policy = Policy::remoteOnly; // KIWI_GENERATION_POLICY; localOnly when no API key is configured
     std::shared_ptr<SharedState> sharedState;
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Generator)
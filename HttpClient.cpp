@@ -0,0 +1,100 @@
+#include "HttpClient.h"
+#include "RealtimeGuard.h"
+
+// Anonymous namespace: helpers used only within this .cpp file
+namespace
+{
+    bool isCancelled(const HttpRequestCanceller* canceller)
+    {
+        return canceller != nullptr && canceller->isCancelled();
+    }
+
+    /**
+     * A platform web stream whose canceller can interrupt it from another thread. Unregisters the abort action before
+     * the stream is destroyed, so a late cancel() never touches a deleted stream.
+     */
+    class CancellableWebStream : public juce::InputStream
+    {
+    public:
+        CancellableWebStream(std::unique_ptr<juce::WebInputStream> streamToWrap, std::shared_ptr<HttpRequestCanceller> cancellerToClear)
+            : stream(std::move(streamToWrap)), canceller(std::move(cancellerToClear)) {}
+
+        ~CancellableWebStream() override
+        {
+            canceller->setAbortAction(nullptr);
+        }
+
+        juce::int64 getTotalLength() override { return stream->getTotalLength(); }
+        bool isExhausted() override { return canceller->isCancelled() || stream->isExhausted(); }
+        int read(void* destBuffer, int maxBytesToRead) override { return canceller->isCancelled() ? 0 : stream->read(destBuffer, maxBytesToRead); }
+        juce::int64 getPosition() override { return stream->getPosition(); }
+        bool setPosition(juce::int64 newPosition) override { return stream->setPosition(newPosition); }
+
+    private:
+        std::unique_ptr<juce::WebInputStream> stream;
+        std::shared_ptr<HttpRequestCanceller> canceller;
+    };
+}
+
+//==============================================================================
+void HttpRequestCanceller::cancel()
+{
+    const juce::ScopedLock scopedLock(lock);
+    cancelled = true;
+    if (abortAction)
+        abortAction();
+}
+
+void HttpRequestCanceller::setAbortAction(std::function<void()> action)
+{
+    const juce::ScopedLock scopedLock(lock);
+    abortAction = std::move(action);
+    if (cancelled && abortAction)
+        abortAction();
+}
+
+//==============================================================================
+/**
+ * @brief Sends a POST request through the platform HTTP stack. WebInputStream rather than URL::createInputStream,
+ *        because only it can be cancelled from another thread
+ */
+std::unique_ptr<juce::InputStream> HttpClient::post(const juce::String& url,
+                                                    const juce::String& body,
+                                                    const juce::String& extraHeaders,
+                                                    int timeoutMs,
+                                                    int numRedirectsToFollow,
+                                                    int* statusCode,
+                                                    std::shared_ptr<HttpRequestCanceller> canceller)
+{
+    KIWI_ASSERT_NOT_REALTIME();
+
+    if (statusCode != nullptr)
+        *statusCode = 0;
+
+    if (isCancelled(canceller.get()))
+        return nullptr;
+
+    auto webStream = std::make_unique<juce::WebInputStream>(juce::URL(url).withPOSTData(body), true);
+    webStream->withExtraHeaders(extraHeaders)
+              .withConnectionTimeout(timeoutMs)
+              .withNumRedirectsToFollow(numRedirectsToFollow);
+
+    if (canceller != nullptr)
+        canceller->setAbortAction([rawStream = webStream.get()] { rawStream->cancel(); });
+
+    const bool connected = webStream->connect(nullptr);
+    if (statusCode != nullptr)
+        *statusCode = webStream->getStatusCode();
+
+    if (! connected || webStream->isError() || isCancelled(canceller.get()))
+    {
+        if (canceller != nullptr)
+            canceller->setAbortAction(nullptr);
+        return nullptr;
+    }
+
+    if (canceller == nullptr)
+        return webStream;
+
+    return std::make_unique<CancellableWebStream>(std::move(webStream), std::move(canceller));
+}
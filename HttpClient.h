@@ -0,0 +1,65 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <memory>
+#include <atomic>
+#include <functional>
+
+/**
+ * HttpRequestCanceller - Lets another thread abort a request started with HttpClient::post().
+ *
+ * Cancelling makes a request that is waiting for its response return promptly; the response stream then reports
+ * itself exhausted.
+ * Thread-safe: cancel() may be called from any thread, at any point before, during or after the request.
+ */
+class HttpRequestCanceller
+{
+public:
+    void cancel();
+    bool isCancelled() const { return cancelled.load(); }
+
+    /// Used by HttpClient to register how to interrupt the request in flight. Runs at once if already cancelled
+    void setAbortAction(std::function<void()> action);
+
+private:
+    std::atomic<bool> cancelled { false };
+    juce::CriticalSection lock;         /// Keeps cancel() from running an abort action whose stream is being destroyed
+    std::function<void()> abortAction;
+};
+
+/**
+ * HttpClient - HTTP client shared by generation requests and analytics uploads.
+ *
+ * Every request is a juce::WebInputStream, so TLS, proxies and redirects are left to the platform HTTP stack. This
+ * class adds what the callers need on top: cancelling a request from another thread through an HttpRequestCanceller,
+ * and one place to send every request from.
+ *
+ * Hold it through juce::SharedResourcePointer<HttpClient> so every owner in the process shares one instance.
+ */
+class HttpClient
+{
+public:
+    HttpClient() = default;
+
+    /**
+     * @brief Sends a POST request and returns the response body as a stream
+     * @param url Absolute http:// or https:// endpoint
+     * @param body Request body, sent as UTF-8
+     * @param extraHeaders Additional header lines separated by "\r\n"
+     * @param timeoutMs Connection timeout
+     * @param numRedirectsToFollow Redirect limit
+     * @param statusCode Receives the HTTP status code, or 0 if no response was received
+     * @param canceller Optional; cancelling it aborts the connection and any blocked read of the response
+     * @return The body stream for any HTTP status, or nullptr if no connection could be made or it was cancelled
+     */
+    std::unique_ptr<juce::InputStream> post(const juce::String& url,
+                                            const juce::String& body,
+                                            const juce::String& extraHeaders,
+                                            int timeoutMs,
+                                            int numRedirectsToFollow,
+                                            int* statusCode = nullptr,
+                                            std::shared_ptr<HttpRequestCanceller> canceller = nullptr);
+
+private:
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(HttpClient)
+};
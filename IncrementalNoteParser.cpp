@@ -0,0 +1,123 @@
+#include "IncrementalNoteParser.h"
+#include "NoteJsonParser.h"
+
+/**
+ * @brief Constructor for the IncrementalNoteParser class
+ * @param onNoteParsed Called with each completed element of the notes array, in document order
+ */
+IncrementalNoteParser::IncrementalNoteParser(std::function<void(const NoteSpec&)> onNoteParsed)
+    : onNote(std::move(onNoteParsed))
+{
+}
+
+/**
+ * @brief Feeds the next chunk of the streamed document into the parser 
+ * @param text The next piece of document text, which may split tokens at any point
+ */
+void IncrementalNoteParser::feed(const juce::String& text)
+{
+    auto p = text.getCharPointer();
+    while (! p.isEmpty())
+        consume(p.getAndAdvance());
+}
+
+/**
+ * @brief Advances the structural state machine by one character 
+ * @param c The next character of the document
+ */
+void IncrementalNoteParser::consume(juce::juce_wchar c)
+{
+    if (capturingElement)
+        elementText += c;
+
+    if (inString)
+    {
+        if (escaped)
+            escaped = false;
+        else if (c == '\\')
+            escaped = true;
+        else if (c == '"')
+        {
+            inString = false;
+            if (depth == 1)
+                lastRootString = currentString;
+        }
+        else if (depth == 1)
+            currentString += c;
+
+        return;
+    }
+
+    switch (c)
+    {
+        case '"':
+            inString = true;
+            currentString.clear();
+            break;
+
+        case '[':
+            if (depth == 1 && lastRootString == "notes")
+                inNotesArray = true;
+            else if (inNotesArray && depth == 2 && ! capturingElement)
+            {
+                capturingElement = true; // A compact [start, duration, pitch, velocity] note
+                elementText = "[";
+            }
+            ++depth;
+            break;
+
+        case '{':
+            if (inNotesArray && depth == 2 && ! capturingElement)
+            {
+                capturingElement = true;
+                elementText = "{";
+            }
+            ++depth;
+            break;
+
+        case '}':
+        case ']':
+            --depth;
+            if (capturingElement && depth == 2)
+            {
+                capturingElement = false;
+                emitElement();
+            }
+            else if (inNotesArray && depth == 1)
+            {
+                inNotesArray = false;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Parses the element that just closed and passes it on if it is a note object or tuple 
+ */
+void IncrementalNoteParser::emitElement()
+{
+    NoteSpec note;
+    bool parsed = NoteJsonParser::parseNote(elementText.toRawUTF8(), elementText.getNumBytesAsUTF8(), note);
+
+    if (! parsed)
+    {
+        // Unexpected shape for the fast parser (extra fields, strings for numbers...): take the general route
+        if (auto fallback = NoteSpecs::fromVar(juce::JSON::parse(elementText)))
+        {
+            note = *fallback;
+            parsed = true;
+        }
+    }
+
+    elementText.clear();
+
+    if (! parsed)
+        return;
+
+    ++numNotesEmitted;
+    if (onNote)
+        onNote(note);
+}
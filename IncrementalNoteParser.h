@@ -0,0 +1,38 @@
+#pragma once
+#include <JuceHeader.h>
+#include "NoteSpec.h"
+
+/**
+ * IncrementalNoteParser - Pulls completed notes out of a partially received {"notes":[...]} JSON document.
+ *
+ * Text is fed in arbitrary chunks as it streams in. The parser tracks just enough JSON structure (nesting depth,
+ * strings and escapes, the root "notes" key) to recognise when an element of the notes array (an object or a compact
+ * [start, duration, pitch, velocity] tuple) has closed, then
+ * parses that element alone (with NoteJsonParser, falling back to juce::JSON) and hands it to the callback - long before the rest of the document has arrived.
+ */
+class IncrementalNoteParser
+{
+public:
+    explicit IncrementalNoteParser(std::function<void(const NoteSpec&)> onNoteParsed);
+
+    /// Consume the next chunk of document text, emitting every notes[] element that closes within it
+    void feed(const juce::String& text);
+
+    int getNumNotesEmitted() const { return numNotesEmitted; }
+
+private:
+    void consume(juce::juce_wchar c);
+    void emitElement();
+
+    std::function<void(const NoteSpec&)> onNote;
+
+    int depth = 0;                  // Current nesting depth; the root object is depth 1
+    bool inString = false;
+    bool escaped = false;           // Previous character inside a string was a backslash
+    juce::String currentString;     // Contents of the string being read at the root level (used to spot keys)
+    juce::String lastRootString;    // Most recent complete string at the root level, i.e. the key of the next value
+    bool inNotesArray = false;
+    bool capturingElement = false;
+    juce::String elementText;       // Raw text of the notes[] element currently being received
+    int numNotesEmitted = 0;
+};
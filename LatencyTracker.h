@@ -0,0 +1,58 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <algorithm>
+#include <cmath>
+
+/**
+ * LatencyTracker - Rolling window of recent request latencies with percentile queries.
+ *
+ * Keeps the last windowSize samples, so percentiles follow the current network and model conditions rather than
+ * the whole session. Thread-safe: samples are recorded from worker threads and read from the message thread.
+ */
+class LatencyTracker
+{
+public:
+    static constexpr int windowSize = 64;
+
+    /// Add one latency sample in milliseconds, replacing the oldest once the window is full
+    void record(double latencyMs)
+    {
+        const juce::ScopedLock scopedLock(lock);
+        samples[(size_t) nextSample] = latencyMs;
+        nextSample = (nextSample + 1) % windowSize;
+        numSamples = juce::jmin(numSamples + 1, windowSize);
+    }
+
+    int getNumSamples() const
+    {
+        const juce::ScopedLock scopedLock(lock);
+        return numSamples;
+    }
+
+    /// Nearest-rank percentile of the samples in the window (fraction in 0-1), or 0 if there are none
+    double getPercentile(double fraction) const
+    {
+        std::array<double, windowSize> sorted;
+        int count = 0;
+        {
+            const juce::ScopedLock scopedLock(lock);
+            count = numSamples;
+            std::copy(samples.begin(), samples.begin() + count, sorted.begin());
+        }
+
+        if (count == 0)
+            return 0.0;
+
+        const auto rank = juce::jlimit(0, count - 1, (int) std::ceil(fraction * count) - 1);
+        std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.begin() + count);
+        return sorted[(size_t) rank];
+    }
+
+private:
+    mutable juce::CriticalSection lock;
+    std::array<double, windowSize> samples {};
+    int nextSample = 0;
+    int numSamples = 0;
+};
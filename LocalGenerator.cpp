@@ -0,0 +1,363 @@
+#include "LocalGenerator.h"
+
+#define BEATS_PER_BAR 4
+#define MAX_BARS 16
+#define MELODY_BASE_NOTE 60 // C4
+#define CHORD_BASE_NOTE 48  // C3
+#define BASS_BASE_NOTE 36   // C2
+
+// Anonymous namespace: helpers used only within this .cpp file
+namespace
+{
+    using LocalGenerator::Hints;
+    using LocalGenerator::Mode;
+
+    /// Semitone offsets of the seven degrees of each mode
+    const int* getModeIntervals(Mode mode)
+    {
+        static const int intervals[][7] = {
+            { 0, 2, 4, 5, 7, 9, 11 },   // major
+            { 0, 2, 3, 5, 7, 8, 10 },   // minor
+            { 0, 2, 3, 5, 7, 9, 10 },   // dorian
+            { 0, 1, 3, 5, 7, 8, 10 },   // phrygian
+            { 0, 2, 4, 6, 7, 9, 11 },   // lydian
+            { 0, 2, 4, 5, 7, 9, 10 },   // mixolydian
+            { 0, 1, 3, 5, 6, 8, 10 },   // locrian
+            { 0, 2, 3, 5, 7, 8, 11 }    // harmonic minor
+        };
+        return intervals[(int) mode];
+    }
+
+    bool isMinorMode(Mode mode)
+    {
+        return mode != Mode::major && mode != Mode::lydian && mode != Mode::mixolydian;
+    }
+
+    int floorDiv(int value, int divisor)
+    {
+        return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+    }
+
+    /// MIDI note of a (possibly negative or multi-octave) scale degree above a base note
+    int degreeToPitch(const int* intervals, int baseNote, int degree)
+    {
+        const int octave = floorDiv(degree, 7);
+        return juce::jlimit(0, 127, baseNote + 12 * octave + intervals[degree - 7 * octave]);
+    }
+
+    /// Reads a token such as "F#", "Bb", "Am" or "c#min" as a pitch class
+    /// @param isMinor Set when the token itself carries a minor suffix
+    /// @return The pitch class, or -1 if the token is not a key name
+    int parseKeyName(const juce::String& token, bool& hasQualifier, bool& isMinor)
+    {
+        static const int naturals[] = { 9, 11, 0, 2, 4, 5, 7 }; // a b c d e f g
+
+        const auto lower = token.toLowerCase();
+        if (lower.isEmpty() || lower[0] < 'a' || lower[0] > 'g')
+            return -1;
+
+        int pitchClass = naturals[lower[0] - 'a'];
+        auto rest = lower.substring(1);
+        hasQualifier = false;
+
+        if (rest.startsWithChar('#')) { pitchClass++; rest = rest.substring(1); hasQualifier = true; }
+        else if (rest.startsWithChar('b')) { pitchClass--; rest = rest.substring(1); hasQualifier = true; }
+
+        isMinor = rest == "m" || rest == "min" || rest == "minor";
+        if (! (rest.isEmpty() || isMinor || rest == "maj" || rest == "major"))
+            return -1;
+
+        hasQualifier = hasQualifier || rest.isNotEmpty();
+        return (pitchClass + 12) % 12;
+    }
+
+    /// Reads a mode word, returning false if the token does not name one
+    bool parseModeWord(const juce::String& word, Mode& mode)
+    {
+        if (word == "major" || word == "maj" || word == "ionian")  { mode = Mode::major;      return true; }
+        if (word == "minor" || word == "min" || word == "aeolian") { mode = Mode::minor;      return true; }
+        if (word == "dorian")     { mode = Mode::dorian;     return true; }
+        if (word == "phrygian")   { mode = Mode::phrygian;   return true; }
+        if (word == "lydian")     { mode = Mode::lydian;     return true; }
+        if (word == "mixolydian") { mode = Mode::mixolydian; return true; }
+        if (word == "locrian")    { mode = Mode::locrian;    return true; }
+        return false;
+    }
+
+    /// Reads "8" or "eight" as a count, returning 0 if the token is neither
+    int parseCount(const juce::String& word)
+    {
+        static const char* numberWords[] = { "one", "two", "three", "four", "five", "six", "seven", "eight",
+                                             "nine", "ten", "eleven", "twelve", "thirteen", "fourteen", "fifteen", "sixteen" };
+        if (word.containsOnly("0123456789"))
+            return word.getIntValue();
+
+        for (int i = 0; i < (int) juce::numElementsInArray(numberWords); ++i)
+            if (word == numberWords[i])
+                return i + 1;
+
+        return 0;
+    }
+
+    /// Moves a melodic position to the nearest scale step that is a tone of the chord on the given degree
+    int snapToChordTone(int index, const std::vector<int>& melodyDegrees, int chordDegree)
+    {
+        const int numDegrees = (int) melodyDegrees.size();
+        for (int distance = 0; distance <= 2; ++distance)
+        {
+            for (int candidate : { index - distance, index + distance })
+            {
+                const int octave = floorDiv(candidate, numDegrees);
+                const int degree = melodyDegrees[(size_t) (candidate - octave * numDegrees)];
+                const int fromRoot = ((degree - chordDegree) % 7 + 7) % 7;
+                if (fromRoot == 0 || fromRoot == 2 || fromRoot == 4)
+                    return candidate;
+            }
+        }
+        return index;
+    }
+
+    void addNote(std::vector<NoteSpec>& notes, double startBeats, double durationBeats, int pitch, int velocity)
+    {
+        notes.push_back({ (float) startBeats, (float) durationBeats, (juce::uint8) juce::jlimit(0, 127, pitch),
+                          (juce::uint8) juce::jlimit(1, 127, velocity) });
+    }
+}
+
+/**
+ * @brief Reads musical constraints from a prompt. Key names are only taken as keys when they look like one
+ *        ("F#", "Bb", "Am", "in A", "c minor"), so articles and words such as "bass" are not misread
+ * @param prompt The user's prompt
+ * @return The recognised hints, with defaults for anything not mentioned
+ */
+LocalGenerator::Hints LocalGenerator::parseHints(const juce::String& prompt)
+{
+    Hints hints;
+    juce::StringArray tokens;
+    tokens.addTokens(prompt, " \t\r\n,.;:!?()/-", "\"");
+    tokens.removeEmptyStrings();
+
+    bool keyFound = false, modeFound = false, noteValueFound = false, melodyMentioned = false;
+
+    for (int i = 0; i < tokens.size(); ++i)
+    {
+        const auto& original = tokens[i];
+        const auto word = original.toLowerCase();
+        const auto next = i + 1 < tokens.size() ? tokens[i + 1].toLowerCase() : juce::String();
+        const auto previous = i > 0 ? tokens[i - 1].toLowerCase() : juce::String();
+
+        Mode mode;
+        if (! keyFound)
+        {
+            bool hasQualifier = false, isMinor = false;
+            const int pitchClass = parseKeyName(original, hasQualifier, isMinor);
+            const bool followedByMode = parseModeWord(next, mode) || next == "harmonic";
+            const bool looksLikeKey = juce::CharacterFunctions::isUpperCase(original[0])
+                                        && (hasQualifier || previous == "in" || previous == "of" || previous == "key");
+
+            if (pitchClass >= 0 && (followedByMode || looksLikeKey))
+            {
+                keyFound = true;
+                hints.rootPitchClass = pitchClass;
+                if (isMinor)
+                {
+                    hints.mode = Mode::minor;
+                    modeFound = true;
+                }
+                continue;
+            }
+        }
+
+        if (word == "harmonic" && next == "minor")
+        {
+            hints.mode = Mode::harmonicMinor;
+            modeFound = true;
+            ++i;
+        }
+        else if (! modeFound && parseModeWord(word, mode))
+        {
+            hints.mode = mode;
+            modeFound = true;
+        }
+        else if (word == "pentatonic")
+        {
+            hints.pentatonic = true;
+        }
+        else if (word == "blues" || word == "bluesy")
+        {
+            hints.pentatonic = true;
+            if (! modeFound)
+                hints.mode = Mode::minor;
+        }
+        else if (parseCount(word) > 0 && (next.startsWith("bar") || next.startsWith("measure")))
+        {
+            hints.bars = juce::jlimit(1, MAX_BARS, parseCount(word));
+        }
+        else if (word == "half")                                                    { hints.stepBeats = 2.0;  noteValueFound = true; }
+        else if (word == "quarter" || word == "crotchet" || word == "crotchets")    { hints.stepBeats = 1.0;  noteValueFound = true; }
+        else if (word.startsWith("eighth") || word == "8th" || word == "8ths")      { hints.stepBeats = 0.5;  noteValueFound = true; }
+        else if (word.startsWith("sixteenth") || word == "16th" || word == "16ths") { hints.stepBeats = 0.25; noteValueFound = true; }
+        else if (! noteValueFound && (word == "sparse" || word == "slow" || word == "minimal" || word == "calm" || word == "ambient"))
+            hints.stepBeats = 1.0;
+        else if (! noteValueFound && (word == "busy" || word == "dense" || word == "fast" || word == "rapid" || word == "energetic"))
+            hints.stepBeats = 0.25;
+        else if (word.startsWith("chord") || word.startsWith("progression") || word.startsWith("pad") || word == "harmony")
+            hints.chords = true;
+        else if (word == "bass" || word == "bassline")
+            hints.bass = true;
+        else if (word == "arp" || word.startsWith("arpeggi"))
+            hints.arpeggio = true;
+        else if (word == "melody" || word == "lead" || word == "riff" || word == "hook" || word == "tune")
+            melodyMentioned = true;
+    }
+
+    hints.melody = melodyMentioned || ! (hints.chords || hints.bass || hints.arpeggio);
+    return hints;
+}
+
+/**
+ * @brief Builds a phrase from hints over a diatonic progression, one chord per bar
+ * @param hints Key, scale, length, density and parts to generate
+ * @param seed Seeds the progression choice and the melodic Markov chain
+ * @return The notes, ordered by start time
+ */
+NoteSpecArray LocalGenerator::generate(const Hints& hints, juce::int64 seed)
+{
+    // Common progressions as scale degrees (I-V-vi-IV, I-vi-IV-V, I-IV-V-I, vi-IV-I-V, I-IV-I-V)
+    static const int progressions[][4] = { { 0, 4, 5, 3 }, { 0, 5, 3, 4 }, { 0, 3, 4, 0 }, { 5, 3, 0, 4 }, { 0, 3, 0, 4 } };
+
+    // Melodic steps in scale degrees, weighted by the direction of the previous step (down, repeated, up)
+    static const int steps[] = { -3, -2, -1, 0, 1, 2, 3 };
+    static const int stepWeights[][7] = { { 1, 3, 8, 2, 5, 2, 1 },
+                                          { 1, 3, 6, 2, 6, 3, 1 },
+                                          { 1, 2, 5, 2, 8, 3, 1 } };
+
+    juce::Random random(seed);
+    const auto* intervals = getModeIntervals(hints.mode);
+    const int* progression = progressions[random.nextInt((int) juce::numElementsInArray(progressions))];
+    const int bars = juce::jlimit(1, MAX_BARS, hints.bars);
+    const double stepBeats = juce::jlimit(0.25, 2.0, hints.stepBeats);
+    const int keyOffset = hints.rootPitchClass > 6 ? hints.rootPitchClass - 12 : hints.rootPitchClass; // Stay near the base octave
+
+    std::vector<NoteSpec> notes;
+    notes.reserve((size_t) (bars * BEATS_PER_BAR * 6 / stepBeats));
+
+    for (int bar = 0; bar < bars; ++bar)
+    {
+        const int chordDegree = progression[bar % 4];
+        const double barStart = bar * BEATS_PER_BAR;
+
+        if (hints.chords)
+        {
+            // Whole-bar triads on their own; two hits per bar under a busy part
+            const double hitBeats = hints.melody || hints.arpeggio || stepBeats > 0.5 ? BEATS_PER_BAR : BEATS_PER_BAR / 2.0;
+            for (double t = 0.0; t < BEATS_PER_BAR; t += hitBeats)
+                for (int tone = 0; tone <= 4; tone += 2)
+                    addNote(notes, barStart + t, hitBeats, degreeToPitch(intervals, CHORD_BASE_NOTE + keyOffset, chordDegree + tone),
+                            (t == 0.0 ? 84 : 72) + random.nextInt(7) - 3);
+        }
+
+        if (hints.bass)
+        {
+            // Chord roots, with the occasional octave jump on an off position
+            const double bassStep = stepBeats <= 0.5 ? 1.0 : 2.0;
+            for (double t = 0.0; t < BEATS_PER_BAR; t += bassStep)
+            {
+                const int octave = t > 0.0 && random.nextInt(4) == 0 ? 7 : 0;
+                addNote(notes, barStart + t, bassStep, degreeToPitch(intervals, BASS_BASE_NOTE + keyOffset, chordDegree + octave),
+                        (t == 0.0 ? 104 : 92) + random.nextInt(9) - 4);
+            }
+        }
+
+        if (hints.arpeggio)
+        {
+            // Up-and-down through root, third, fifth and octave
+            static const int pattern[] = { 0, 2, 4, 7, 4, 2 };
+            const double arpStep = juce::jmin(stepBeats, 0.5);
+            int position = 0;
+            for (double t = 0.0; t < BEATS_PER_BAR; t += arpStep, ++position)
+                addNote(notes, barStart + t, arpStep,
+                        degreeToPitch(intervals, CHORD_BASE_NOTE + 12 + keyOffset, chordDegree + pattern[position % 6]),
+                        (position % 4 == 0 ? 96 : 80) + random.nextInt(9) - 4);
+        }
+    }
+
+    if (hints.melody)
+    {
+        // Walk over the melody's scale (the five-note subset when pentatonic) so every step stays in the key
+        const auto melodyDegrees = hints.pentatonic ? (isMinorMode(hints.mode) ? std::vector<int> { 0, 2, 3, 4, 6 }
+                                                                               : std::vector<int> { 0, 1, 2, 4, 5 })
+                                                    : std::vector<int> { 0, 1, 2, 3, 4, 5, 6 };
+        const int numDegrees = (int) melodyDegrees.size();
+        const double totalBeats = bars * BEATS_PER_BAR;
+        int index = 0;
+        int lastStep = 0;
+
+        for (double t = 0.0; t < totalBeats - 1.0e-6;)
+        {
+            const int bar = (int) (t / BEATS_PER_BAR);
+            const double beatInBar = t - bar * BEATS_PER_BAR;
+            const bool downbeat = beatInBar < 1.0e-6;
+            const bool strongBeat = downbeat || std::abs(beatInBar - 2.0) < 1.0e-6;
+
+            // Occasionally hold a note over two steps, never across the bar line
+            double length = stepBeats;
+            if (random.nextInt(5) == 0 && beatInBar + 2.0 * stepBeats <= BEATS_PER_BAR + 1.0e-6)
+                length *= 2.0;
+
+            // Short rests keep busy lines breathing, but the bar always opens with a note
+            if (! downbeat && random.nextInt(10) == 0)
+            {
+                t += length;
+                continue;
+            }
+
+            if (t > 0.0)
+            {
+                const auto& weights = stepWeights[lastStep < 0 ? 0 : (lastStep == 0 ? 1 : 2)];
+                int total = 0;
+                for (int k = 0; k < 7; ++k)
+                    total += weights[k];
+
+                int pick = random.nextInt(total), k = 0;
+                while (pick >= weights[k])
+                    pick -= weights[k++];
+
+                lastStep = steps[k];
+                index = juce::jlimit(-numDegrees / 2, numDegrees + numDegrees / 2, index + lastStep); // About an octave and a half
+            }
+
+            if (strongBeat)
+                index = snapToChordTone(index, melodyDegrees, progression[bar % 4]);
+
+            // The final note resolves to the tonic and rings to the end of the phrase
+            const bool lastNote = t + length >= totalBeats - 1.0e-6;
+            if (lastNote)
+            {
+                index = numDegrees * (int) std::round((double) index / numDegrees);
+                length = totalBeats - t;
+            }
+
+            const int octave = floorDiv(index, numDegrees);
+            const int degree = melodyDegrees[(size_t) (index - octave * numDegrees)] + 7 * octave;
+            const int velocity = (downbeat ? 104 : (strongBeat ? 94 : 80)) + random.nextInt(9) - 4;
+            addNote(notes, t, length, degreeToPitch(intervals, MELODY_BASE_NOTE + keyOffset, degree), velocity);
+            t += length;
+        }
+    }
+
+    std::stable_sort(notes.begin(), notes.end(), [](const NoteSpec& a, const NoteSpec& b) { return a.startBeats < b.startBeats; });
+    return NoteSpecs::fromVector(std::move(notes));
+}
+
+/**
+ * @brief Generates a phrase straight from a prompt. Variations of one prompt get different seeds
+ * @param prompt The user's prompt
+ * @param variationIndex Position in a variations batch, 0 for a single request
+ * @return The notes, ordered by start time
+ */
+NoteSpecArray LocalGenerator::generate(const juce::String& prompt, int variationIndex)
+{
+    const auto seed = prompt.trim().toLowerCase().hashCode64() + (juce::int64) variationIndex * 7919;
+    return generate(parseHints(prompt), seed);
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <JuceHeader.h>
+#include "NoteSpec.h"
+
+/**
+ * LocalGenerator - Built-in, rule-based generator that needs no network or API key.
+ *
+ * Reads key, scale, bar-count, rhythmic-density and part hints ("chords", "bass", "arpeggio", "melody") from the
+ * prompt and builds a phrase over a common diatonic progression: triads for chords, chord roots for bass, and a
+ * melody drawn from a first-order Markov chain over scale-degree steps that lands on chord tones on strong beats.
+ * Produces the same note model as a remote response in well under a millisecond, on the calling thread.
+ */
+namespace LocalGenerator
+{
+    enum class Mode { major, minor, dorian, phrygian, lydian, mixolydian, locrian, harmonicMinor };
+
+    /// Musical constraints recognised in a prompt. Anything not mentioned keeps its default
+    struct Hints
+    {
+        int rootPitchClass = 0;     // 0 = C ... 11 = B
+        Mode mode = Mode::major;
+        bool pentatonic = false;    // Melody restricted to the five-note subset of the mode (also used for "blues")
+        int bars = 4;               // Length in 4/4 bars
+        double stepBeats = 0.5;     // Melodic grid: 2 = half notes ... 0.25 = sixteenths
+        bool chords = false;
+        bool bass = false;
+        bool arpeggio = false;
+        bool melody = true;
+    };
+
+    /// Extract hints from free text, e.g. "sparse 8 bar melody in F# minor over chords"
+    Hints parseHints(const juce::String& prompt);
+
+    /// Generate a phrase. The same hints and seed always produce the same notes
+    NoteSpecArray generate(const Hints& hints, juce::int64 seed);
+
+    /// Parse hints from the prompt and generate from them, seeded by the prompt and variation index
+    NoteSpecArray generate(const juce::String& prompt, int variationIndex = 0);
+}
@@ -0,0 +1,255 @@
+#include "LongFormPlan.h"
+
+#define BEATS_PER_BAR 4
+#define LONG_FORM_MIN_BARS 16    // Shorter requests without named sections are generated in one piece
+#define DEFAULT_SECTION_BARS 8   // Length of a named section the prompt gives no length for, and of each unnamed part
+#define PHRASE_BARS 4            // Sections share out an overall length in whole phrases of this many bars
+#define MAX_LONG_FORM_BARS 128
+#define MAX_SECTIONS 16
+
+// Anonymous namespace: helpers used only within this .cpp file
+namespace
+{
+    /// Reads "32" or "eight" as a count, returning 0 if the token is neither
+    int parseCount(const juce::String& word)
+    {
+        static const char* numberWords[] = { "one", "two", "three", "four", "five", "six", "seven", "eight",
+                                             "nine", "ten", "eleven", "twelve", "thirteen", "fourteen", "fifteen", "sixteen" };
+        if (word.containsOnly("0123456789"))
+            return word.getIntValue();
+
+        for (int i = 0; i < (int) juce::numElementsInArray(numberWords); ++i)
+            if (word == numberWords[i])
+                return i + 1;
+
+        return 0;
+    }
+
+    /// Reads a song-section word ("verse", "pre chorus", ...), returning an empty string if the token is not one
+    /// @param consumedNext Set when the name also used the following token
+    juce::String parseSectionName(const juce::String& word, const juce::String& next, bool& consumedNext)
+    {
+        consumedNext = false;
+
+        if (word == "pre" && next.startsWith("chorus"))
+        {
+            consumedNext = true;
+            return "Pre-chorus";
+        }
+
+        if (word.startsWith("prechorus"))                      return "Pre-chorus";
+        if (word == "intro")                                   return "Intro";
+        if (word == "verse" || word == "verses")               return "Verse";
+        if (word == "chorus" || word == "choruses")            return "Chorus";
+        if (word == "bridge")                                  return "Bridge";
+        if (word == "breakdown")                               return "Breakdown";
+        if (word == "buildup")                                 return "Buildup";
+        if (word == "interlude")                               return "Interlude";
+        if (word == "solo")                                    return "Solo";
+        if (word == "outro" || word == "coda")                 return "Outro";
+        return {};
+    }
+
+    juce::String describeKey(const LocalGenerator::Hints& hints)
+    {
+        static const char* pitchClassNames[] = { "C", "C#", "D", "Eb", "E", "F", "F#", "G", "Ab", "A", "Bb", "B" };
+        static const char* modeNames[] = { "major", "minor", "dorian", "phrygian", "lydian", "mixolydian", "locrian", "harmonic minor" };
+
+        juce::String key = juce::String(pitchClassNames[hints.rootPitchClass]) + " " + modeNames[(int) hints.mode];
+        if (hints.pentatonic)
+            key << " (pentatonic melody)";
+        return key;
+    }
+
+    /// Splits totalBars into whole-bar parts of at most DEFAULT_SECTION_BARS
+    std::vector<LongFormPlan::Section> makeUnnamedSections(int totalBars)
+    {
+        std::vector<LongFormPlan::Section> sections;
+        for (int bar = 0; bar < totalBars; bar += DEFAULT_SECTION_BARS)
+            sections.push_back({ "Part " + juce::String((int) sections.size() + 1), juce::jmin(DEFAULT_SECTION_BARS, totalBars - bar) });
+        return sections;
+    }
+}
+
+double LongFormPlan::Section::getLengthBeats() const
+{
+    return (double) bars * BEATS_PER_BAR;
+}
+
+double LongFormPlan::Plan::getTotalBeats() const
+{
+    return sections.empty() ? 0.0 : sections.back().startBeats + sections.back().getLengthBeats();
+}
+
+/**
+ * @brief Reads the form of a long request. Named sections ("intro, verse, chorus") are kept in the order they are
+ *        written, with lengths from "4-bar intro" or shared out of an overall "32-bar" length. A long request that
+ *        names no sections is split into 8-bar parts
+ * @param prompt The user's prompt
+ * @return The plan, with its shared header built. Not long-form if the prompt describes a single short phrase
+ */
+LongFormPlan::Plan LongFormPlan::make(const juce::String& prompt)
+{
+    Plan plan;
+    plan.prompt = prompt;
+
+    juce::StringArray tokens;
+    tokens.addTokens(prompt.toLowerCase(), " \t\r\n,.;:!?()/-+&", "\"");
+    tokens.removeEmptyStrings();
+
+    std::vector<Section> named;
+    int totalBars = 0;
+    int pendingBars = 0; // A length written just before a section name ("8 bar chorus")
+
+    for (int i = 0; i < tokens.size(); ++i)
+    {
+        const auto& word = tokens[i];
+        const auto next = i + 1 < tokens.size() ? tokens[i + 1] : juce::String();
+        bool consumedNext = false;
+
+        if (const int count = parseCount(word); count > 0 && (next.startsWith("bar") || next.startsWith("measure")))
+        {
+            const auto following = i + 2 < tokens.size() ? tokens[i + 2] : juce::String();
+            const auto afterFollowing = i + 3 < tokens.size() ? tokens[i + 3] : juce::String();
+            if (parseSectionName(following, afterFollowing, consumedNext).isNotEmpty())
+                pendingBars = count;
+            else
+                totalBars = count;
+            ++i;
+        }
+        else if (auto name = parseSectionName(word, next, consumedNext); name.isNotEmpty())
+        {
+            if ((int) named.size() < MAX_SECTIONS)
+                named.push_back({ name, pendingBars });
+            pendingBars = 0;
+            if (consumedNext)
+                ++i;
+        }
+    }
+
+    totalBars = juce::jmin(totalBars, MAX_LONG_FORM_BARS);
+
+    if (named.size() > 1)
+    {
+        // Sections without their own length share what is left of the overall length, or get the default
+        int specifiedBars = 0, numUnspecified = 0;
+        for (const auto& section : named)
+        {
+            specifiedBars += section.bars;
+            numUnspecified += section.bars == 0 ? 1 : 0;
+        }
+
+        // Shared out in whole phrases where the length allows it, so 32 bars over three sections is 12 + 12 + 8
+        const int sharedBars = totalBars - specifiedBars;
+        const int unitBars = sharedBars >= PHRASE_BARS * numUnspecified ? PHRASE_BARS : 1;
+        const int sharedUnits = sharedBars / unitBars;
+        int unspecifiedIndex = 0;
+        for (auto& section : named)
+        {
+            if (section.bars > 0)
+                continue;
+
+            ++unspecifiedIndex;
+            if (sharedBars < numUnspecified)
+            {
+                section.bars = DEFAULT_SECTION_BARS;
+                continue;
+            }
+
+            section.bars = unitBars * (sharedUnits / numUnspecified + (unspecifiedIndex <= sharedUnits % numUnspecified ? 1 : 0));
+            if (unspecifiedIndex == numUnspecified)
+                section.bars += sharedBars - sharedUnits * unitBars; // Odd bars left over from whole phrases go to the last
+        }
+
+        plan.sections = std::move(named);
+    }
+    else if (totalBars >= LONG_FORM_MIN_BARS)
+    {
+        plan.sections = makeUnnamedSections(totalBars);
+    }
+
+    if (! plan.isLongForm())
+        return plan;
+
+    // Lay the sections end to end, stopping at the length limit
+    double startBeats = 0.0;
+    int barsSoFar = 0;
+    for (size_t i = 0; i < plan.sections.size(); ++i)
+    {
+        auto& section = plan.sections[i];
+        section.bars = juce::jmin(section.bars, MAX_LONG_FORM_BARS - barsSoFar);
+        if (section.bars <= 0)
+        {
+            plan.sections.resize(i);
+            break;
+        }
+
+        section.startBeats = startBeats;
+        startBeats += section.getLengthBeats();
+        barsSoFar += section.bars;
+    }
+
+    // What every section has to agree on, fixed up front since the sections are generated without seeing each other
+    plan.hints = LocalGenerator::parseHints(prompt);
+
+    auto motifHints = plan.hints;
+    motifHints.bars = 1;
+    motifHints.melody = true;
+    motifHints.chords = motifHints.bass = motifHints.arpeggio = false;
+    plan.motif = LocalGenerator::generate(motifHints, prompt.trim().toLowerCase().hashCode64());
+
+    juce::String form;
+    for (const auto& section : plan.sections)
+    {
+        const int firstBar = (int) (section.startBeats / BEATS_PER_BAR) + 1;
+        form << (form.isEmpty() ? "" : ", ") << section.name << " bars " << firstBar << "-" << (firstBar + section.bars - 1);
+    }
+
+    plan.header << "This is one section of a longer piece. Every section of the piece is generated separately and shares:\n"
+                << "- Overall request: " << prompt.trim() << "\n"
+                << "- Key: " << describeKey(plan.hints) << ", used throughout\n"
+                << "- Meter: 4/4 at one constant tempo (1 beat = 1 quarter note)\n"
+                << "- Form: " << form << " (" << barsSoFar << " bars)\n"
+                << "- Motif to develop in every section, as [start_beats,duration_beats,midi_note,velocity]: "
+                << NoteSpecs::toCompactJSON(plan.motif, 16);
+
+    return plan;
+}
+
+/**
+ * @brief Builds the prompt for one section of a plan
+ * @param plan A long-form plan
+ * @param sectionIndex The section to write
+ * @return The shared header followed by the section's name, length and position
+ */
+juce::String LongFormPlan::buildSectionPrompt(const Plan& plan, int sectionIndex)
+{
+    const auto& section = plan.sections[(size_t) sectionIndex];
+    const int numSections = (int) plan.sections.size();
+    const auto lengthBeats = juce::String(section.bars * BEATS_PER_BAR);
+
+    juce::String sectionPrompt = plan.header;
+    sectionPrompt << "\n\nWrite only section " << (sectionIndex + 1) << " of " << numSections << " (" << section.name << "): "
+                  << section.bars << " bars, " << lengthBeats << " beats. Its start_beats run from 0 to " << lengthBeats
+                  << ", counted from the start of this section.";
+
+    if (sectionIndex > 0)
+        sectionPrompt << " Previous section: " << plan.sections[(size_t) sectionIndex - 1].name << ".";
+    if (sectionIndex < numSections - 1)
+        sectionPrompt << " Next section: " << plan.sections[(size_t) sectionIndex + 1].name << ".";
+
+    return sectionPrompt;
+}
+
+/**
+ * @brief Generates one section with the built-in generator, e.g. when its request failed
+ * @param plan A long-form plan
+ * @param sectionIndex The section to generate
+ * @return The section's notes, timed from its own start
+ */
+NoteSpecArray LongFormPlan::generateLocally(const Plan& plan, int sectionIndex)
+{
+    auto hints = plan.hints;
+    hints.bars = plan.sections[(size_t) sectionIndex].bars;
+    return LocalGenerator::generate(hints, plan.prompt.trim().toLowerCase().hashCode64() + sectionIndex + 1);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <JuceHeader.h>
+#include "NoteSpec.h"
+#include "LocalGenerator.h"
+
+/**
+ * LongFormPlan - Splits a long request ("32-bar song with intro, verse, chorus") into sections that can be generated
+ * concurrently.
+ *
+ * A plan fixes everything the sections must agree on before any of them is requested: the key and mode, the meter,
+ * where each section sits in the song, and a one-bar motif for every section to develop. Each section is then asked
+ * for on its own with that shared header, and the results are stitched together in beat order.
+ */
+namespace LongFormPlan
+{
+    struct Section
+    {
+        juce::String name;        // "Intro", "Verse", ... or "Part 2" when the prompt names no sections
+        int bars = 0;             // Length in 4/4 bars
+        double startBeats = 0.0;  // Where the section starts in the song
+
+        double getLengthBeats() const;
+    };
+
+    struct Plan
+    {
+        juce::String prompt;              // The user's prompt for the whole piece
+        LocalGenerator::Hints hints;      // Key, mode and parts shared by every section
+        std::vector<Section> sections;
+        NoteSpecArray motif;              // One bar every section develops
+        juce::String header;              // Shared description sent with every section request
+
+        /// True if the prompt is long enough, or names enough sections, to be split
+        bool isLongForm() const { return sections.size() > 1; }
+        double getTotalBeats() const;
+    };
+
+    /// Plan a prompt. The plan has fewer than two sections (and is not long-form) for ordinary short prompts
+    Plan make(const juce::String& prompt);
+
+    /// The prompt for one section: the shared header plus what to write and where it goes
+    juce::String buildSectionPrompt(const Plan& plan, int sectionIndex);
+
+    /// One section from the built-in generator, in the plan's key, timed from the start of the section
+    NoteSpecArray generateLocally(const Plan& plan, int sectionIndex);
+}
@@ -0,0 +1,28 @@
+#include "MidiExport.h"
+
+MidiExport::MidiExport(std::vector<juce::uint8> smfBytes)
+    : bytes(std::move(smfBytes)), key(MidiFileStore::makeKey(bytes)), file(store->getFile(key))
+{
+    store->retain(key);
+}
+
+MidiExport::~MidiExport()
+{
+    store->release(key);
+}
+
+/**
+ * @brief Writes the file on first use, e.g. when a drag starts, creating the store directory if needed. Construction
+ *        never touches the disk. Later calls return the same file without touching the disk again, unless the file
+ *        was deleted in the meantime 
+ * @return The written file, or an invalid File if writing failed
+ */
+juce::File MidiExport::materialise()
+{
+    if (written && file.existsAsFile())
+        return file;
+
+    auto storedFile = store->write(key, bytes);
+    written = storedFile != juce::File();
+    return storedFile;
+}
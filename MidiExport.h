@@ -0,0 +1,40 @@
+#pragma once
+#include <JuceHeader.h>
+#include "MidiFileStore.h"
+
+/**
+ * MidiExport - An exported MIDI file that lives in memory until it is needed on disk.
+ *
+ * Every generation produces one, but most are never dragged into a DAW. The SMF bytes are kept here and only written
+ * to the MidiFileStore when a drag starts, synchronously and before the drag is handed to the OS, so the file is
+ * always complete by the time the host reads it. The file is named after its contents, so identical exports share one
+ * file, and an export holds a reference to it for as long as it lives (i.e. while a chat entry shows it). Message
+ * thread only.
+ */
+class MidiExport
+{
+public:
+    explicit MidiExport(std::vector<juce::uint8> smfBytes);
+    ~MidiExport();
+
+    /// Where the file is (or will be) stored
+    const juce::File& getFile() const { return file; }
+    const juce::String& getKey() const { return key; }
+    size_t getSizeBytes() const { return bytes.size(); }
+    bool isWritten() const { return written; }
+
+    /// Write the file if that hasn't happened yet
+    /// @return The file, or an invalid File if it could not be written
+    juce::File materialise();
+
+private:
+    std::vector<juce::uint8> bytes;
+    juce::String key;
+    juce::SharedResourcePointer<MidiFileStore> store;
+    juce::File file;
+    bool written = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MidiExport)
+};
+
+using MidiExportPtr = std::shared_ptr<MidiExport>;
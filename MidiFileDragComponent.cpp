@@ -1,8 +1,8 @@
 #include "MidiFileDragComponent.h"
 
-void MidiFileDragComponent::setMidiFile(const juce::File& file)
+void MidiFileDragComponent::setMidiExport(MidiExportPtr newExport)
 {
-    midiFile = file;
+    midiExport = std::move(newExport);
     repaint();
 }
 
@@ -10,16 +10,21 @@ void MidiFileDragComponent::paint(juce::Graphics& g)
 {
     g.fillAll(juce::Colours::darkgrey);
     g.setColour(juce::Colours::white);
-    if (midiFile.existsAsFile())
-        g.drawText(midiFile.getFileName(), getLocalBounds(), juce::Justification::centred);
+    if (midiExport != nullptr)
+        g.drawText(midiExport->getFile().getFileName(), getLocalBounds(), juce::Justification::centred);
     else
         g.drawText("No MIDI file", getLocalBounds(), juce::Justification::centred);
 }
 
 void MidiFileDragComponent::mouseDrag(const juce::MouseEvent& e)
 {
-    if (midiFile.existsAsFile() && e.mouseWasDraggedSinceMouseDown())
+    if (midiExport != nullptr && e.mouseWasDraggedSinceMouseDown())
     {
+        // Written now, before the OS drag starts, so the file is complete by the time it is dropped
+        const auto midiFile = midiExport->materialise();
+        if (midiFile == juce::File())
+            return;
+
         juce::StringArray files;
         files.add(midiFile.getFullPathName());
         juce::DragAndDropContainer::performExternalDragDropOfFiles(files, true);
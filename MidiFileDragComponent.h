@@ -1,15 +1,16 @@
 #pragma once
 #include <JuceHeader.h>
+#include "MidiExport.h"
 
 class MidiFileDragComponent : public juce::Component
 {
 public:
-    void setMidiFile(const juce::File& file);
+    void setMidiExport(MidiExportPtr newExport);
     
     void paint(juce::Graphics& g) override;
     
     void mouseDrag(const juce::MouseEvent& e) override;
     
 private:
-    juce::File midiFile;
+    MidiExportPtr midiExport; // Written to disk when a drag starts
 };
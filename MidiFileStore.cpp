@@ -0,0 +1,166 @@
+#include "MidiFileStore.h"
+
+#define STORE_FILE_PREFIX "kiwi_"
+#define STORE_FILE_EXTENSION ".mid"
+#define SHUTDOWN_TIMEOUT_MS 2000
+
+MidiFileStore::MidiFileStore()
+{
+    auto configuredMaxBytes = juce::SystemStats::getEnvironmentVariable("KIWI_MIDI_STORE_MAX_BYTES", "").getLargeIntValue();
+    if (configuredMaxBytes > 0)
+        maxBytes = configuredMaxBytes;
+
+    // Enforce the budget left over from previous sessions
+    collectGarbageAsync();
+}
+
+MidiFileStore::~MidiFileStore()
+{
+    collector.removeAllJobs(true, SHUTDOWN_TIMEOUT_MS);
+}
+
+/**
+ * @brief Builds the key of a MIDI file from its contents
+ * @param smfBytes The complete Standard MIDI File
+ * @return Hex string of the 64-bit FNV-1a hash of the bytes
+ */
+juce::String MidiFileStore::makeKey(const std::vector<juce::uint8>& smfBytes)
+{
+    juce::uint64 hash = 0xcbf29ce484222325ULL;
+    for (auto byte : smfBytes)
+    {
+        hash ^= byte;
+        hash *= 0x100000001b3ULL;
+    }
+
+    return juce::String::toHexString((juce::int64) hash).paddedLeft('0', 16);
+}
+
+/**
+ * @brief Get the directory that holds the stored files. Nothing touches the disk: it is only created by write()
+ * @return juce::File representing the store directory
+ */
+juce::File MidiFileStore::getStoreDir()
+{
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+               .getChildFile("KiwiPlugin")
+               .getChildFile("midi_files");
+}
+
+/**
+ * @brief Where the file for a key is stored. Only builds a path, so it is cheap enough for every generation result
+ */
+juce::File MidiFileStore::getFile(const juce::String& key) const
+{
+    return storeDir.getChildFile(STORE_FILE_PREFIX + key + STORE_FILE_EXTENSION);
+}
+
+void MidiFileStore::retain(const juce::String& key)
+{
+    const juce::ScopedLock scopedLock(lock);
+    references[key]++;
+}
+
+void MidiFileStore::release(const juce::String& key)
+{
+    const juce::ScopedLock scopedLock(lock);
+
+    auto entry = references.find(key);
+    if (entry != references.end() && --entry->second <= 0)
+        references.erase(entry);
+}
+
+int MidiFileStore::getNumReferences(const juce::String& key) const
+{
+    const juce::ScopedLock scopedLock(lock);
+
+    auto entry = references.find(key);
+    return entry != references.end() ? entry->second : 0;
+}
+
+/**
+ * @brief Stores a MIDI file. The caller should hold a reference to the key, so the collector can't delete the file
+ *        between this write and the drag that reads it
+ * @param key Key produced by makeKey for these bytes
+ * @param smfBytes The complete Standard MIDI File
+ * @return The stored file, or an invalid File if writing failed
+ */
+juce::File MidiFileStore::write(const juce::String& key, const std::vector<juce::uint8>& smfBytes)
+{
+    auto file = getFile(key);
+
+    // Same key and same size: written before, by this session or an earlier one. Only its recency changes
+    if (file.existsAsFile() && file.getSize() == (juce::int64) smfBytes.size())
+    {
+        file.setLastModificationTime(juce::Time::getCurrentTime());
+        return file;
+    }
+
+    if (const auto created = storeDir.createDirectory(); created.failed())
+    {
+        DBG("Failed to create MIDI file store: " + created.getErrorMessage());
+        return juce::File();
+    }
+
+    if (smfBytes.empty() || ! file.replaceWithData(smfBytes.data(), smfBytes.size()))
+    {
+        DBG("Failed to write MIDI file: " + file.getFullPathName());
+        return juce::File();
+    }
+
+    DBG("MIDI file written: " + file.getFullPathName());
+    collectGarbageAsync();
+    return file;
+}
+
+void MidiFileStore::collectGarbageAsync()
+{
+    // Collections that pile up while one is queued would all do the same work
+    bool expected = false;
+    if (! collectionQueued.compare_exchange_strong(expected, true))
+        return;
+
+    collector.addJob([this]
+    {
+        collectionQueued.store(false);
+        collectGarbage();
+    });
+}
+
+void MidiFileStore::collectGarbage()
+{
+    auto files = storeDir.findChildFiles(juce::File::findFiles, false, STORE_FILE_PREFIX "*" STORE_FILE_EXTENSION);
+
+    juce::int64 totalBytes = 0;
+    for (const auto& file : files)
+        totalBytes += file.getSize();
+
+    if (totalBytes <= maxBytes)
+        return;
+
+    // Least recently written or dragged first
+    std::sort(files.begin(), files.end(), [](const juce::File& a, const juce::File& b)
+    {
+        return a.getLastModificationTime().toMilliseconds() < b.getLastModificationTime().toMilliseconds();
+    });
+
+    for (const auto& file : files)
+    {
+        if (totalBytes <= maxBytes)
+            break;
+
+        const auto key = file.getFileNameWithoutExtension().fromFirstOccurrenceOf(STORE_FILE_PREFIX, false, false);
+        const auto size = file.getSize();
+
+        // Checked and deleted under the lock, so a file is never deleted while an export refers to it
+        const juce::ScopedLock scopedLock(lock);
+        if (references.count(key) > 0)
+            continue;
+
+        if (file.deleteFile())
+        {
+            totalBytes -= size;
+            DBG("Collected MIDI file: " + file.getFullPathName());
+        }
+    }
+}
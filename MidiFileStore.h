@@ -0,0 +1,53 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * MidiFileStore - Content-addressed store of the MIDI files dragged out of the plugin.
+ *
+ * Files live in %AppData%/KiwiPlugin/midi_files (or equivalent on macOS/Linux), named after a stable 64-bit hash of
+ * their bytes, so an identical sequence (a replay, a cache hit, the same phrase in another instance) is written once
+ * and maps to the same file in every session. Live exports hold a reference to their file; referenced files are never
+ * deleted. Files nothing refers to stay on disk for DAW projects and restored history, until the store grows past its
+ * byte budget and a background collector removes the least recently used of them. Held through
+ * juce::SharedResourcePointer so every plugin instance in the process shares the reference counts.
+ */
+class MidiFileStore
+{
+public:
+    MidiFileStore();
+    ~MidiFileStore();
+
+    /// Stable across sessions and platforms, so identical files get the same key everywhere
+    static juce::String makeKey(const std::vector<juce::uint8>& smfBytes);
+
+    /// Where the file for a key is (or will be) stored
+    juce::File getFile(const juce::String& key) const;
+
+    /// Count a reference to a key's file; the collector skips files with references
+    void retain(const juce::String& key);
+    void release(const juce::String& key);
+    int getNumReferences(const juce::String& key) const;
+
+    /// Write a key's file unless an identical one is already stored, and mark it as recently used. Creates the store
+    /// directory if needed, so only a file's first use touches the disk
+    /// @return The file, or an invalid File if it could not be written
+    juce::File write(const juce::String& key, const std::vector<juce::uint8>& smfBytes);
+
+    /// Queue a collection on the background thread, unless one is already queued
+    void collectGarbageAsync();
+
+private:
+    static juce::File getStoreDir();
+    void collectGarbage();                    /// Delete unreferenced files, oldest first, until the store fits its budget
+
+    const juce::File storeDir { getStoreDir() };
+    juce::int64 maxBytes = 32 * 1024 * 1024;  /// Byte budget (KIWI_MIDI_STORE_MAX_BYTES overrides)
+    std::map<juce::String, int> references;   /// Key -> number of live exports of that file
+
+    mutable juce::CriticalSection lock;       /// Protects references
+    std::atomic<bool> collectionQueued { false };
+    juce::ThreadPool collector { 1 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MidiFileStore)
+};
@@ -0,0 +1,172 @@
+#include "MidiFileWriter.h"
+
+#define MIDI_FILE_TYPE 1
+#define MAX_TICK 0xffffffffu
+#define TRACK_NAME_META_TYPE 0x03
+#define TEMPO_META_TYPE 0x51
+#define MAX_TEMPO_MICROSECONDS 0xffffff // The tempo event holds 3 bytes
+#define NOTE_ON_STATUS 0x90
+#define NOTE_OFF_STATUS 0x80
+
+// Anonymous namespace: helpers used only within this .cpp file
+namespace
+{
+    inline juce::uint64 packEvent(int track, juce::uint32 tick, int status, int pitch, int velocity)
+    {
+        return ((juce::uint64) track << 56) | ((juce::uint64) tick << 24) | ((juce::uint64) status << 16)
+             | ((juce::uint64) pitch << 8) | (juce::uint64) velocity;
+    }
+
+    inline int trackOf(juce::uint64 event)        { return (int) (event >> 56); }
+    inline juce::uint32 tickOf(juce::uint64 event) { return (juce::uint32) (event >> 24); }
+
+    inline juce::uint32 beatsToTicks(double beats, int ticksPerQuarterNote)
+    {
+        return (juce::uint32) juce::jlimit(0.0, (double) MAX_TICK, std::round(beats * ticksPerQuarterNote));
+    }
+}
+
+/**
+ * @brief Serialises a note model as Standard MIDI File bytes
+ * @param notes The notes, timed in beats, in any order
+ * @param ticksPerQuarterNote Time resolution of the file
+ * @param outputChannel Channel (1-16) of notes that belong to no part
+ * @param trackNames Names of the tracks of a multi-part model, by channel
+ * @param bpm Tempo of the file; no tempo event is written if it is 0 or less
+ * @return The bytes of the file, or an empty buffer if there are no notes
+ */
+const std::vector<juce::uint8>& MidiFileWriter::write(const std::vector<NoteSpec>& notes, int ticksPerQuarterNote, int outputChannel,
+                                                      const std::map<int, juce::String>& trackNames, double bpm)
+{
+    events.clear();
+    bytes.clear();
+    if (notes.empty())
+        return bytes;
+
+    // One track per channel, in channel order, but only when there is more than one channel
+    std::array<bool, 16> channelUsed {};
+    int numChannels = 0;
+    for (const auto& note : notes)
+    {
+        auto& used = channelUsed[(size_t) (juce::jlimit(1, 16, NoteSpecs::getChannel(note, outputChannel)) - 1)];
+        numChannels += used ? 0 : 1;
+        used = true;
+    }
+
+    events.reserve(notes.size() * 2);
+    for (const auto& note : notes)
+    {
+        const int channelIndex = juce::jlimit(1, 16, NoteSpecs::getChannel(note, outputChannel)) - 1;
+        const int track = numChannels > 1 ? channelIndex : 0;
+        const auto onTick = beatsToTicks(note.startBeats, ticksPerQuarterNote);
+        const auto offTick = juce::jmax(onTick + 1, beatsToTicks((double) note.startBeats + note.durationBeats, ticksPerQuarterNote));
+
+        events.push_back(packEvent(track, onTick, NOTE_ON_STATUS | channelIndex, note.pitch & 127, note.velocity & 127));
+        events.push_back(packEvent(track, offTick, NOTE_OFF_STATUS | channelIndex, note.pitch & 127, 0));
+    }
+
+    // The only sort: by track, then tick, with note-offs (0x8n) ahead of note-ons (0x9n) so a repeated pitch retriggers
+    std::sort(events.begin(), events.end());
+
+    // Header, then each track's events. 4 bytes of delta time and 3 of message is the most any event takes
+    bytes.reserve(14 + (size_t) numChannels * 32 + 7 + events.size() * 7);
+    bytes.insert(bytes.end(), { 'M', 'T', 'h', 'd' });
+    writeUInt32(6);
+    writeUInt16(MIDI_FILE_TYPE);
+    writeUInt16(numChannels > 1 ? numChannels : 1);
+    writeUInt16(ticksPerQuarterNote);
+
+    // Only the first track carries the tempo, as type 1 files expect
+    auto microsecondsPerQuarterNote = bpm > 0.0 ? (juce::uint32) juce::jlimit(1.0, (double) MAX_TEMPO_MICROSECONDS, std::round(60000000.0 / bpm)) : 0u;
+
+    for (size_t first = 0; first < events.size();)
+    {
+        const int track = trackOf(events[first]);
+        size_t end = first;
+        while (end < events.size() && trackOf(events[end]) == track)
+            ++end;
+
+        juce::String name;
+        if (numChannels > 1)
+            name = trackNames.count(track + 1) > 0 ? trackNames.at(track + 1) : "Channel " + juce::String(track + 1);
+
+        writeTrack(first, end, name, microsecondsPerQuarterNote);
+        microsecondsPerQuarterNote = 0;
+        first = end;
+    }
+
+    return bytes;
+}
+
+/**
+ * @brief Appends one MTrk chunk holding events [firstEvent, endEvent)
+ * @param name Track name meta event to start the track with; none if empty
+ * @param microsecondsPerQuarterNote Tempo meta event to start the track with; none if 0
+ */
+void MidiFileWriter::writeTrack(size_t firstEvent, size_t endEvent, const juce::String& name, juce::uint32 microsecondsPerQuarterNote)
+{
+    bytes.insert(bytes.end(), { 'M', 'T', 'r', 'k' });
+    const auto lengthOffset = bytes.size();
+    writeUInt32(0); // Chunk length, filled in once the track is written
+
+    if (name.isNotEmpty())
+    {
+        const auto numNameBytes = (juce::uint32) name.getNumBytesAsUTF8();
+        bytes.insert(bytes.end(), { 0x00, 0xff, TRACK_NAME_META_TYPE });
+        writeVariableLength(numNameBytes);
+        bytes.insert(bytes.end(), name.toRawUTF8(), name.toRawUTF8() + numNameBytes);
+    }
+
+    if (microsecondsPerQuarterNote != 0)
+    {
+        bytes.insert(bytes.end(), { 0x00, 0xff, TEMPO_META_TYPE, 0x03 });
+        bytes.insert(bytes.end(), { (juce::uint8) (microsecondsPerQuarterNote >> 16), (juce::uint8) (microsecondsPerQuarterNote >> 8),
+                                    (juce::uint8) microsecondsPerQuarterNote });
+    }
+
+    juce::uint32 previousTick = 0;
+    for (size_t i = firstEvent; i < endEvent; ++i)
+    {
+        const auto event = events[i];
+        const auto tick = tickOf(event);
+        writeVariableLength(tick - previousTick);
+        previousTick = tick;
+
+        bytes.push_back((juce::uint8) (event >> 16));
+        bytes.push_back((juce::uint8) (event >> 8));
+        bytes.push_back((juce::uint8) event);
+    }
+
+    bytes.insert(bytes.end(), { 0x00, 0xff, 0x2f, 0x00 }); // End of track
+
+    const auto length = (juce::uint32) (bytes.size() - lengthOffset - 4);
+    for (int i = 0; i < 4; ++i)
+        bytes[lengthOffset + (size_t) i] = (juce::uint8) (length >> (24 - 8 * i));
+}
+
+/// Big-endian groups of 7 bits, high bit set on all but the last
+void MidiFileWriter::writeVariableLength(juce::uint32 value)
+{
+    juce::uint8 groups[5];
+    int numGroups = 0;
+    do
+    {
+        groups[numGroups++] = (juce::uint8) (value & 0x7f);
+        value >>= 7;
+    }
+    while (value != 0);
+
+    while (--numGroups > 0)
+        bytes.push_back((juce::uint8) (groups[numGroups] | 0x80));
+    bytes.push_back(groups[0]);
+}
+
+void MidiFileWriter::writeUInt32(juce::uint32 value)
+{
+    bytes.insert(bytes.end(), { (juce::uint8) (value >> 24), (juce::uint8) (value >> 16), (juce::uint8) (value >> 8), (juce::uint8) value });
+}
+
+void MidiFileWriter::writeUInt16(int value)
+{
+    bytes.insert(bytes.end(), { (juce::uint8) (value >> 8), (juce::uint8) value });
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <JuceHeader.h>
+#include "NoteSpec.h"
+
+/**
+ * MidiFileWriter - Serialises a note model straight to Standard MIDI File bytes.
+ *
+ * Every note becomes a packed note-on/note-off pair with an integer sort key (track, tick, off before on), the pairs
+ * are put in order with one sort, and the tracks are written as variable-length delta times into a byte buffer. No
+ * juce::MidiMessage, MidiMessageSequence or note-off matching is involved. The event and byte buffers are kept
+ * between calls, so writing a phrase of a similar size again does not allocate. Not thread-safe: one writer per thread.
+ */
+class MidiFileWriter
+{
+public:
+    /// Serialise notes as a type 1 file. A multi-part model gets one track per channel, named from trackNames
+    /// (channel -> name, "Channel N" when missing); a single-part model is one unnamed track
+    /// @param outputChannel Channel of notes that belong to no part (NoteSpec::channel 0)
+    /// @param bpm Tempo written at the start of the first track, so the file imports at the tempo it was made at; none if 0
+    /// @return The file's bytes, valid until the next call. Empty if there are no notes
+    const std::vector<juce::uint8>& write(const std::vector<NoteSpec>& notes, int ticksPerQuarterNote, int outputChannel,
+                                          const std::map<int, juce::String>& trackNames = {}, double bpm = 0.0);
+
+private:
+    void writeTrack(size_t firstEvent, size_t endEvent, const juce::String& name, juce::uint32 microsecondsPerQuarterNote);
+    void writeVariableLength(juce::uint32 value);
+    void writeUInt32(juce::uint32 value);
+    void writeUInt16(int value);
+
+    std::vector<juce::uint64> events; // (track << 56) | (tick << 24) | (status << 16) | (pitch << 8) | velocity
+    std::vector<juce::uint8> bytes;
+};
@@ -0,0 +1,151 @@
+#include "MidiFileWriter.h"
+
+/**
+ * MidiFileWriterTests - juce::UnitTest coverage of MidiFileWriter, read back through juce::MidiFile. Registered in the
+ * "Kiwi" category; run with juce::UnitTestRunner().runTestsInCategory("Kiwi").
+ *
+ * MidiFileWriterBenchmark compares MidiFileWriter with the juce::MidiMessageSequence / juce::MidiFile path it replaced.
+ * It is registered in the "Kiwi Benchmarks" category; run it with juce::UnitTestRunner().runTestsInCategory("Kiwi Benchmarks").
+ */
+namespace MidiFileWriterTestData
+{
+    constexpr int ticksPerQuarterNote = 480;
+
+    /// numNotes overlapping notes on channel 1, in start order
+    inline std::vector<NoteSpec> makeNotes(int numNotes)
+    {
+        std::vector<NoteSpec> notes;
+        notes.reserve((size_t) numNotes);
+        for (int i = 0; i < numNotes; ++i)
+            notes.push_back(NoteSpecs::make(i * 0.25, 0.5 + (i % 4) * 0.25, 36 + i % 60, 40 + i % 80));
+        return notes;
+    }
+
+    inline bool readBack(const std::vector<juce::uint8>& bytes, juce::MidiFile& midiFile)
+    {
+        juce::MemoryInputStream in(bytes.data(), bytes.size(), false);
+        return midiFile.readFrom(in);
+    }
+
+    inline int countNoteOns(const juce::MidiMessageSequence& track)
+    {
+        int numNoteOns = 0;
+        for (const auto* event : track)
+            if (event->message.isNoteOn())
+                ++numNoteOns;
+        return numNoteOns;
+    }
+}
+
+class MidiFileWriterTests : public juce::UnitTest
+{
+public:
+    MidiFileWriterTests() : juce::UnitTest("MidiFileWriter", "Kiwi") {}
+
+    void runTest() override
+    {
+        using namespace MidiFileWriterTestData;
+
+        beginTest("A single-part model is one track with its tempo and every note");
+        {
+            MidiFileWriter writer;
+            const auto& bytes = writer.write(makeNotes(64), ticksPerQuarterNote, 1, {}, 90.0);
+
+            juce::MidiFile midiFile;
+            expect(readBack(bytes, midiFile));
+            expectEquals(midiFile.getNumTracks(), 1);
+            expectEquals(countNoteOns(*midiFile.getTrack(0)), 64);
+
+            juce::MidiMessageSequence tempoEvents;
+            midiFile.findAllTempoEvents(tempoEvents);
+            expectEquals(tempoEvents.getNumEvents(), 1);
+            expectWithinAbsoluteError(60.0 / tempoEvents.getEventPointer(0)->message.getTempoSecondsPerQuarterNote(), 90.0, 0.001);
+        }
+
+        beginTest("A multi-part model gets a named track per channel and one tempo event");
+        {
+            auto notes = makeNotes(8);
+            for (size_t i = 0; i < notes.size(); ++i)
+                notes[i].channel = (juce::uint8) (i % 2 == 0 ? 1 : 10);
+
+            MidiFileWriter writer;
+            const auto& bytes = writer.write(notes, ticksPerQuarterNote, 1, { { 10, "drums" } }, 120.0);
+
+            juce::MidiFile midiFile;
+            expect(readBack(bytes, midiFile));
+            expectEquals(midiFile.getNumTracks(), 2);
+            expectEquals(countNoteOns(*midiFile.getTrack(1)), 4);
+
+            juce::MidiMessageSequence tempoEvents;
+            midiFile.findAllTempoEvents(tempoEvents);
+            expectEquals(tempoEvents.getNumEvents(), 1);
+        }
+
+        beginTest("No tempo is written without one");
+        {
+            MidiFileWriter writer;
+            juce::MidiFile midiFile;
+            expect(readBack(writer.write(makeNotes(4), ticksPerQuarterNote, 1), midiFile));
+
+            juce::MidiMessageSequence tempoEvents;
+            midiFile.findAllTempoEvents(tempoEvents);
+            expectEquals(tempoEvents.getNumEvents(), 0);
+        }
+    }
+};
+
+class MidiFileWriterBenchmark : public juce::UnitTest
+{
+public:
+    MidiFileWriterBenchmark() : juce::UnitTest("MidiFileWriter vs juce::MidiFile", "Kiwi Benchmarks") {}
+
+    void runTest() override
+    {
+        using namespace MidiFileWriterTestData;
+
+        for (int numNotes : { 1000, 10000, 100000 })
+        {
+            beginTest(juce::String(numNotes) + " notes");
+            const auto notes = makeNotes(numNotes);
+
+            MidiFileWriter writer;
+            auto startMs = juce::Time::getMillisecondCounterHiRes();
+            const auto numWriterBytes = writer.write(notes, ticksPerQuarterNote, 1, {}, 120.0).size();
+            const auto writerMs = juce::Time::getMillisecondCounterHiRes() - startMs;
+
+            // The second export of a similar phrase reuses the writer's buffers
+            startMs = juce::Time::getMillisecondCounterHiRes();
+            writer.write(notes, ticksPerQuarterNote, 1, {}, 120.0);
+            const auto reusedMs = juce::Time::getMillisecondCounterHiRes() - startMs;
+
+            // The path MidiFileWriter replaced: a message sequence, note-off matching, then juce::MidiFile
+            startMs = juce::Time::getMillisecondCounterHiRes();
+            juce::MidiMessageSequence track;
+            track.addEvent(juce::MidiMessage::tempoMetaEvent(500000), 0.0);
+            for (const auto& note : notes)
+            {
+                track.addEvent(juce::MidiMessage::noteOn(1, note.pitch, note.velocity), note.startBeats * ticksPerQuarterNote);
+                track.addEvent(juce::MidiMessage::noteOff(1, note.pitch), (note.startBeats + note.durationBeats) * ticksPerQuarterNote);
+            }
+            track.updateMatchedPairs();
+
+            juce::MidiFile midiFile;
+            midiFile.setTicksPerQuarterNote(ticksPerQuarterNote);
+            midiFile.addTrack(track);
+            juce::MemoryOutputStream out;
+            midiFile.writeTo(out);
+            const auto juceMs = juce::Time::getMillisecondCounterHiRes() - startMs;
+
+            juce::MidiFile writtenFile;
+            expect(readBack(writer.write(notes, ticksPerQuarterNote, 1, {}, 120.0), writtenFile));
+            expectEquals(countNoteOns(*writtenFile.getTrack(0)), numNotes);
+
+            logMessage(juce::String(numNotes) + " notes, " + juce::String((int) (numWriterBytes / 1024)) + " KB: MidiFileWriter "
+                       + juce::String(writerMs, 2) + " ms (" + juce::String(reusedMs, 2) + " ms with reused buffers), juce::MidiFile "
+                       + juce::String(juceMs, 2) + " ms");
+        }
+    }
+};
+
+static MidiFileWriterTests midiFileWriterTests;
+static MidiFileWriterBenchmark midiFileWriterBenchmark;
@@ -3,31 +3,16 @@
 
 class MidiNote { 
     public:
-        MidiNote(MidiNoteEvent note, int onSamples, int offSamples);
+        MidiNote(MidiNoteEvent note, double onBeats, double offBeats);
 
         ~MidiNote() = default;
 
-        bool isFinished() const { return noteOffCountdownSamples < 0 && noteOnCountdownSamples < 0;}
-        
-        bool hasBeenCounted() const { return counted; }
-        void markAsCounted() { counted = true; }
-
-        void processNote(int blockSize, juce::MidiBuffer& midiMessages);
-        
-        void reset(); 
+        const MidiNoteEvent& getNoteEvent() const { return note; }
+        double getOnBeats() const { return onBeats; }
+        double getOffBeats() const { return offBeats; }
 
     private:
         MidiNoteEvent note; 
-        int noteOnCountdownSamples; // How many samples from now until the next note-on event should be triggered
-        int noteOffCountdownSamples; // How many samples from now until the next note-off event should be triggered
-
-        // Original timing parameters for resetting the sequence -> essential for replay functionality
-        int originalOnSamples; 
-        int originalOffSamples; 
-
-        bool counted = false; // Keeps track of whether note has finished playing and been counted towards sequence completion to avoid
-
-        void noteOn(int blockSize, juce::MidiBuffer& midiMessages);
-        
-        void noteOff(int blockSize, juce::MidiBuffer& midiMessages);
-};
\ No newline at end of file
+        double onBeats; // Beats from the start of the sequence until the note-on event should be triggered
+        double offBeats; // Beats from the start of the sequence until the note-off event should be triggered
+};
@@ -0,0 +1,381 @@
+#include "NoteJsonParser.h"
+
+#if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+ #define KIWI_NOTE_PARSER_SSE2 1
+ #include <emmintrin.h>
+#elif defined (__ARM_NEON) && defined (__aarch64__)
+ #define KIWI_NOTE_PARSER_NEON 1
+ #include <arm_neon.h>
+#endif
+
+// Anonymous namespace: scanning and number parsing helpers used only within this .cpp file 
+namespace
+{
+    inline bool isWhitespace(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+
+    /// Cursor over the UTF-8 bytes of a document
+    struct Reader
+    {
+        const char* pos;
+        const char* end;
+
+        bool atEnd() const { return pos >= end; }
+        char peek() const { return pos < end ? *pos : '\0'; }
+
+        /// Skip whitespace, 16 bytes at a time when a vector unit is available (pretty-printed output is mostly indentation)
+        void skipWhitespace()
+        {
+           #if KIWI_NOTE_PARSER_SSE2
+            const auto space = _mm_set1_epi8(' ');
+            const auto newline = _mm_set1_epi8('\n');
+            const auto carriageReturn = _mm_set1_epi8('\r');
+            const auto tab = _mm_set1_epi8('\t');
+
+            while (end - pos >= 16)
+            {
+                const auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+                const auto whitespace = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, newline)),
+                                                     _mm_or_si128(_mm_cmpeq_epi8(chunk, carriageReturn), _mm_cmpeq_epi8(chunk, tab)));
+                const auto nonWhitespaceMask = ~_mm_movemask_epi8(whitespace) & 0xffff;
+
+                if (nonWhitespaceMask != 0)
+                {
+                    int firstSet = 0;
+                    while ((nonWhitespaceMask & (1 << firstSet)) == 0)
+                        ++firstSet;
+                    pos += firstSet;
+                    return;
+                }
+
+                pos += 16;
+            }
+           #elif KIWI_NOTE_PARSER_NEON
+            while (end - pos >= 16)
+            {
+                const auto chunk = vld1q_u8(reinterpret_cast<const uint8_t*>(pos));
+                const auto whitespace = vorrq_u8(vorrq_u8(vceqq_u8(chunk, vdupq_n_u8(' ')), vceqq_u8(chunk, vdupq_n_u8('\n'))),
+                                                 vorrq_u8(vceqq_u8(chunk, vdupq_n_u8('\r')), vceqq_u8(chunk, vdupq_n_u8('\t'))));
+
+                if (vminvq_u8(whitespace) == 0)
+                    break; // At least one non-whitespace byte in this chunk: find it with the scalar loop below
+
+                pos += 16;
+            }
+           #endif
+
+            while (pos < end && isWhitespace(*pos))
+                ++pos;
+        }
+
+        bool consume(char expected)
+        {
+            skipWhitespace();
+            if (peek() != expected)
+                return false;
+            ++pos;
+            return true;
+        }
+
+        /// Read a string without escapes (all keys in the schema are plain ASCII)
+        bool readKey(const char*& keyStart, size_t& keyLength)
+        {
+            if (! consume('"'))
+                return false;
+
+            keyStart = pos;
+            while (pos < end && *pos != '"')
+            {
+                if (*pos == '\\')
+                    return false; // Escaped keys are not part of the schema
+                ++pos;
+            }
+
+            if (atEnd())
+                return false;
+
+            keyLength = (size_t) (pos - keyStart);
+            ++pos; // Closing quote
+            return consume(':');
+        }
+
+        /// Read a JSON number without going through strtod (locale-independent, no null terminator needed)
+        bool readNumber(double& value)
+        {
+            skipWhitespace();
+
+            bool negative = false;
+            if (peek() == '-')
+            {
+                negative = true;
+                ++pos;
+            }
+
+            juce::uint64 mantissa = 0;
+            int decimalExponent = 0;
+            int numDigits = 0;
+
+            while (pos < end && *pos >= '0' && *pos <= '9')
+            {
+                if (numDigits < 18)
+                    mantissa = mantissa * 10 + (juce::uint64) (*pos - '0');
+                else
+                    ++decimalExponent; // Digits beyond double precision only scale the value
+                ++numDigits;
+                ++pos;
+            }
+
+            if (peek() == '.')
+            {
+                ++pos;
+                while (pos < end && *pos >= '0' && *pos <= '9')
+                {
+                    if (numDigits < 18)
+                    {
+                        mantissa = mantissa * 10 + (juce::uint64) (*pos - '0');
+                        --decimalExponent;
+                    }
+                    ++numDigits;
+                    ++pos;
+                }
+            }
+
+            if (numDigits == 0)
+                return false;
+
+            if (peek() == 'e' || peek() == 'E')
+            {
+                ++pos;
+                bool negativeExponent = false;
+                if (peek() == '+' || peek() == '-')
+                    negativeExponent = (*pos++ == '-');
+
+                int exponent = 0;
+                int exponentDigits = 0;
+                while (pos < end && *pos >= '0' && *pos <= '9')
+                {
+                    exponent = juce::jmin(exponent * 10 + (*pos - '0'), 1000);
+                    ++exponentDigits;
+                    ++pos;
+                }
+
+                if (exponentDigits == 0)
+                    return false;
+
+                decimalExponent += negativeExponent ? -exponent : exponent;
+            }
+
+            value = (double) mantissa * std::pow(10.0, decimalExponent);
+            if (negative)
+                value = -value;
+            return true;
+        }
+    };
+
+    /// Skip one array or object (the "parts" list of a multi-part document), tracking strings so brackets inside
+    /// part names don't count
+    bool skipValue(Reader& reader)
+    {
+        reader.skipWhitespace();
+        if (reader.peek() != '[' && reader.peek() != '{')
+            return false;
+
+        int depth = 0;
+        bool inString = false;
+        while (! reader.atEnd())
+        {
+            const char c = *reader.pos++;
+            if (inString)
+            {
+                if (c == '\\')
+                    ++reader.pos; // Whatever is escaped can't end the string
+                else if (c == '"')
+                    inString = false;
+            }
+            else if (c == '"')
+                inString = true;
+            else if (c == '[' || c == '{')
+                ++depth;
+            else if ((c == ']' || c == '}') && --depth == 0)
+                return true;
+        }
+
+        return false;
+    }
+
+    bool keyEquals(const char* key, size_t length, const char* expected)
+    {
+        return std::strlen(expected) == length && std::memcmp(key, expected, length) == 0;
+    }
+
+    /// Parse one note at the reader's position: a keyed object, or a compact [start, duration, pitch, velocity] tuple.
+    /// Notes of a multi-part response add a channel field, or a fifth tuple element. An object must have all four
+    /// note fields; {} or a note missing one is malformed, not a note with zeros in it
+    bool readNote(Reader& reader, NoteSpec& note, int* numClamped)
+    {
+        double startBeats = 0.0, durationBeats = 0.0, midiNote = 0.0, velocity = 0.0, channel = 0.0;
+
+        if (reader.consume('['))
+        {
+            if (! (reader.readNumber(startBeats) && reader.consume(',') && reader.readNumber(durationBeats) && reader.consume(',')
+                   && reader.readNumber(midiNote) && reader.consume(',') && reader.readNumber(velocity)))
+                return false;
+            if (reader.consume(',') && ! reader.readNumber(channel))
+                return false;
+            if (! reader.consume(']'))
+                return false;
+        }
+        else if (! reader.consume('{'))
+        {
+            return false;
+        }
+        else
+        {
+            int fieldsSeen = 0; // One bit per required field
+            do
+            {
+                const char* key = nullptr;
+                size_t keyLength = 0;
+                if (! reader.readKey(key, keyLength))
+                    return false;
+
+                double value = 0.0;
+                if (! reader.readNumber(value))
+                    return false;
+
+                if (keyEquals(key, keyLength, "start_beats"))          { startBeats = value; fieldsSeen |= 1; }
+                else if (keyEquals(key, keyLength, "duration_beats")) { durationBeats = value; fieldsSeen |= 2; }
+                else if (keyEquals(key, keyLength, "midi_note"))      { midiNote = value; fieldsSeen |= 4; }
+                else if (keyEquals(key, keyLength, "velocity"))       { velocity = value; fieldsSeen |= 8; }
+                else if (keyEquals(key, keyLength, "channel"))        channel = value;
+                else return false; // Unknown field: let juce::JSON deal with it
+            }
+            while (reader.consume(','));
+
+            if (! reader.consume('}') || fieldsSeen != 15)
+                return false;
+        }
+
+        note = NoteSpecs::make(startBeats, durationBeats, midiNote, velocity, numClamped);
+        note.channel = NoteSpecs::makeChannel(channel, numClamped);
+        return true;
+    }
+
+    /// Upper bound on the number of notes: one per '{' or '[', minus the root object and the notes array (each note
+    /// opens exactly one of them in either format). Vectorised where available
+    size_t countElementOpeners(const char* data, size_t numBytes)
+    {
+        size_t count = 0;
+        size_t i = 0;
+
+       #if KIWI_NOTE_PARSER_SSE2
+        const auto brace = _mm_set1_epi8('{');
+        const auto bracket = _mm_set1_epi8('[');
+        for (; i + 16 <= numBytes; i += 16)
+        {
+            const auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            auto mask = (unsigned int) _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, brace), _mm_cmpeq_epi8(chunk, bracket)));
+            while (mask != 0)
+            {
+                mask &= mask - 1;
+                ++count;
+            }
+        }
+       #elif KIWI_NOTE_PARSER_NEON
+        const auto brace = vdupq_n_u8('{');
+        const auto bracket = vdupq_n_u8('[');
+        for (; i + 16 <= numBytes; i += 16)
+        {
+            const auto chunk = vld1q_u8(reinterpret_cast<const uint8_t*>(data + i));
+            const auto matches = vshrq_n_u8(vorrq_u8(vceqq_u8(chunk, brace), vceqq_u8(chunk, bracket)), 7);
+            count += vaddvq_u8(matches);
+        }
+       #endif
+
+        for (; i < numBytes; ++i)
+            if (data[i] == '{' || data[i] == '[')
+                ++count;
+
+        return count;
+    }
+}
+
+/**
+ * @brief Parses a {"notes":[...]} document straight into NoteSpecs. A multi-part document's "parts" list may come
+ *        before or after the notes; it is skipped here and read by NoteSpecs::partsFromJSON 
+ * @param data UTF-8 text of the document
+ * @param numBytes Length of the text in bytes
+ * @param notes Buffer the parsed notes are appended to
+ * @param numClamped Counts values that had to be brought into MIDI range; may be null
+ * @return true on success; false if the document is not in the expected shape, in which case notes is left unchanged
+ */
+bool NoteJsonParser::parseDocument(const char* data, size_t numBytes, std::vector<NoteSpec>& notes, int* numClamped)
+{
+    const auto originalSize = notes.size();
+    const auto maxNotes = countElementOpeners(data, numBytes);
+    notes.reserve(originalSize + (maxNotes > 2 ? maxNotes - 2 : 0));
+
+    auto fail = [&notes, originalSize]
+    {
+        notes.resize(originalSize);
+        return false;
+    };
+
+    Reader reader { data, data + numBytes };
+    if (! reader.consume('{'))
+        return fail();
+
+    bool sawNotes = false;
+    do
+    {
+        const char* key = nullptr;
+        size_t keyLength = 0;
+        if (! reader.readKey(key, keyLength))
+            return fail();
+
+        if (keyEquals(key, keyLength, "parts") && skipValue(reader))
+            continue;
+
+        if (! keyEquals(key, keyLength, "notes") || sawNotes || ! reader.consume('['))
+            return fail();
+
+        sawNotes = true;
+        if (! reader.consume(']'))
+        {
+            do
+            {
+                NoteSpec note;
+                if (! readNote(reader, note, numClamped))
+                    return fail();
+                notes.push_back(note);
+            }
+            while (reader.consume(','));
+
+            if (! reader.consume(']'))
+                return fail();
+        }
+    }
+    while (reader.consume(','));
+
+    if (! sawNotes || ! reader.consume('}'))
+        return fail();
+
+    reader.skipWhitespace();
+    return reader.atEnd() ? true : fail();
+}
+
+/**
+ * @brief Parses a single note object or compact tuple 
+ * @param data UTF-8 text of the note
+ * @param numBytes Length of the text in bytes
+ * @param note Receives the parsed note
+ * @return true if the text is exactly one note in the expected shape
+ */
+bool NoteJsonParser::parseNote(const char* data, size_t numBytes, NoteSpec& note)
+{
+    Reader reader { data, data + numBytes };
+    if (! readNote(reader, note, nullptr))
+        return false;
+
+    reader.skipWhitespace();
+    return reader.atEnd();
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <JuceHeader.h>
+#include "NoteSpec.h"
+
+/**
+ * NoteJsonParser - Specialised, allocation-free parser for the model's {"notes":[{...}]} output.
+ *
+ * Each note may be a keyed object or a compact [start_beats, duration_beats, midi_note, velocity] tuple; the two
+ * forms can be mixed. Notes of a multi-part response carry their part's channel as an extra field or fifth element,
+ * and the document's "parts" list is skipped.
+ *
+ * The schema is fixed (four numeric fields per note), so instead of building a juce::var tree with a DynamicObject
+ * per note, the parser walks the UTF-8 bytes once and writes NoteSpecs straight into the caller's buffer. Structural
+ * scanning (whitespace skipping, counting note objects to size the buffer) uses SSE2 or NEON where available and a
+ * scalar loop elsewhere. Anything outside the expected shape makes it return false so the caller can fall back to
+ * juce::JSON.
+ */
+namespace NoteJsonParser
+{
+    /// Parse a whole {"notes":[...]} document, appending to notes. Reserves once up front from a SIMD count of '{' and '['
+    /// @return false (with notes restored to their original size) if the document is not in the expected shape
+    /// @param numClamped Counts pitch/velocity values that had to be brought into MIDI range; may be null
+    bool parseDocument(const char* data, size_t numBytes, std::vector<NoteSpec>& notes, int* numClamped = nullptr);
+
+    /// Parse a single {start_beats, duration_beats, midi_note, velocity[, channel]} object or [start, duration, pitch, velocity[, channel]] tuple
+    /// @return false if the text is not exactly one such note
+    bool parseNote(const char* data, size_t numBytes, NoteSpec& note);
+}
@@ -0,0 +1,121 @@
+#include "NoteJsonParser.h"
+
+/**
+ * NoteJsonParserTests - juce::UnitTest coverage of the specialised note parser and its juce::JSON fallback.
+ * Registered in the "Kiwi" category; run with juce::UnitTestRunner().runTestsInCategory("Kiwi").
+ *
+ * NoteJsonParserBenchmark compares NoteJsonParser with juce::JSON at 100, 10k and 1M notes. It is registered in the
+ * "Kiwi Benchmarks" category; run it with juce::UnitTestRunner().runTestsInCategory("Kiwi Benchmarks").
+ */
+namespace NoteJsonParserTestData
+{
+    /// A {"notes":[...]} document of numNotes keyed notes, as the model writes it
+    inline std::string makeDocument(int numNotes)
+    {
+        std::string document = "{\"notes\":[";
+        document.reserve((size_t) numNotes * 80 + 16);
+
+        for (int i = 0; i < numNotes; ++i)
+        {
+            if (i > 0)
+                document += ",";
+            document += "{\"start_beats\":" + std::to_string(i * 0.5) + ",\"duration_beats\":0.5,\"midi_note\":"
+                      + std::to_string(36 + i % 60) + ",\"velocity\":" + std::to_string(40 + i % 80) + "}";
+        }
+
+        return document + "]}";
+    }
+}
+
+class NoteJsonParserTests : public juce::UnitTest
+{
+public:
+    NoteJsonParserTests() : juce::UnitTest("NoteJsonParser", "Kiwi") {}
+
+    void runTest() override
+    {
+        beginTest("Keyed notes and compact tuples parse, mixed in one document");
+        {
+            const std::string document = "{\"notes\":[{\"start_beats\":0,\"duration_beats\":1,\"midi_note\":60,\"velocity\":90},"
+                                         "[1.5,0.5,64,100,10]]}";
+            std::vector<NoteSpec> notes;
+            expect(NoteJsonParser::parseDocument(document.data(), document.size(), notes));
+            expectEquals((int) notes.size(), 2);
+            expectEquals((int) notes[0].pitch, 60);
+            expectEquals((int) notes[1].velocity, 100);
+            expectEquals((int) notes[1].channel, 10);
+        }
+
+        beginTest("An empty object or one missing a note field is not a note");
+        {
+            for (const juce::String text : { "{}",
+                                             "{\"start_beats\":0,\"duration_beats\":1,\"midi_note\":60}",
+                                             "{\"duration_beats\":1,\"midi_note\":60,\"velocity\":90}" })
+            {
+                NoteSpec note;
+                expect(! NoteJsonParser::parseNote(text.toRawUTF8(), text.getNumBytesAsUTF8(), note), text);
+                expect(! NoteSpecs::fromVar(juce::JSON::parse(text)).has_value(), text);
+            }
+        }
+
+        beginTest("A document with an incomplete note falls back and drops only that note");
+        {
+            const juce::String document = "{\"notes\":[{},{\"start_beats\":2,\"duration_beats\":1,\"midi_note\":67,\"velocity\":80}]}";
+
+            std::vector<NoteSpec> notes;
+            expect(! NoteJsonParser::parseDocument(document.toRawUTF8(), document.getNumBytesAsUTF8(), notes));
+            expect(notes.empty());
+
+            const auto model = NoteSpecs::fromJSON(document);
+            expectEquals(NoteSpecs::size(model), 1);
+            expectEquals((int) (*model)[0].pitch, 67);
+        }
+    }
+};
+
+class NoteJsonParserBenchmark : public juce::UnitTest
+{
+public:
+    NoteJsonParserBenchmark() : juce::UnitTest("NoteJsonParser vs juce::JSON", "Kiwi Benchmarks") {}
+
+    void runTest() override
+    {
+        for (int numNotes : { 100, 10000, 1000000 })
+        {
+            beginTest(juce::String(numNotes) + " notes");
+
+            const auto document = NoteJsonParserTestData::makeDocument(numNotes);
+            const auto documentText = juce::String::fromUTF8(document.data(), (int) document.size());
+
+            std::vector<NoteSpec> parsed;
+            auto startMs = juce::Time::getMillisecondCounterHiRes();
+            const bool ok = NoteJsonParser::parseDocument(document.data(), document.size(), parsed);
+            const auto parserMs = juce::Time::getMillisecondCounterHiRes() - startMs;
+
+            // The path the parser replaced: a var tree, then one NoteSpec per element
+            std::vector<NoteSpec> fromJson;
+            startMs = juce::Time::getMillisecondCounterHiRes();
+            const auto notesArray = juce::JSON::parse(documentText)["notes"];
+            if (auto* elements = notesArray.getArray())
+            {
+                fromJson.reserve((size_t) elements->size());
+                for (const auto& element : *elements)
+                    if (auto note = NoteSpecs::fromVar(element))
+                        fromJson.push_back(*note);
+            }
+            const auto jsonMs = juce::Time::getMillisecondCounterHiRes() - startMs;
+
+            expect(ok);
+            expectEquals((int) parsed.size(), numNotes);
+            expectEquals((int) fromJson.size(), numNotes);
+            expect(parsed.empty() || (parsed.back().pitch == fromJson.back().pitch && parsed.back().startBeats == fromJson.back().startBeats));
+
+            logMessage(juce::String(numNotes) + " notes, " + juce::String((int) (document.size() / 1024)) + " KB: NoteJsonParser "
+                       + juce::String(parserMs, 2) + " ms, juce::JSON " + juce::String(jsonMs, 2) + " ms ("
+                       + juce::String(jsonMs / juce::jmax(parserMs, 0.001), 1) + "x)");
+        }
+    }
+};
+
+static NoteJsonParserTests noteJsonParserTests;
+static NoteJsonParserBenchmark noteJsonParserBenchmark;
@@ -0,0 +1,243 @@
+#include "NoteRepair.h"
+#include "NoteJsonParser.h"
+#include "IncrementalNoteParser.h"
+
+#define DEFAULT_REPAIRED_DURATION_BEATS 0.5 // Length given to a zero-length last note, or one with no later note to reach
+#define MAX_REPAIRED_DURATION_BEATS 4.0     // Cap when a zero-length note is extended to the next note
+#define SAME_START_TOLERANCE_BEATS 1.0e-4
+
+// Anonymous namespace: helpers used only within this .cpp file
+namespace
+{
+    /// Cuts the JSON out of whatever surrounds it: code fences, leading prose and a bare array without its
+    /// {"notes": ...} wrapper. Trailing text is left for the parsers to reject, since a truncated document has no end
+    juce::String unwrapDocument(const juce::String& modelText, NoteRepair::Report& report)
+    {
+        auto text = modelText.trim();
+
+        if (text.startsWith("```"))
+        {
+            text = text.fromFirstOccurrenceOf("\n", false, false); // Drops the fence and its language tag
+            if (text.trimEnd().endsWith("```"))
+                text = text.trimEnd().dropLastCharacters(3);
+            text = text.trim();
+            report.strippedWrapper = true;
+        }
+
+        const int objectStart = text.indexOfChar('{');
+        const int arrayStart = text.indexOfChar('[');
+        if (objectStart < 0 && arrayStart < 0)
+            return {};
+
+        // A bare notes array: either [[...]] tuples or [{...}] objects before any enclosing object
+        if (arrayStart >= 0 && (objectStart < 0 || arrayStart < objectStart))
+        {
+            report.strippedWrapper = true;
+            return "{\"notes\":" + text.substring(arrayStart) + (text.trimEnd().endsWith("]") ? "}" : "");
+        }
+
+        if (objectStart > 0)
+            report.strippedWrapper = true;
+
+        return text.substring(objectStart);
+    }
+
+    /// Drops anything after the document's final closing brace, e.g. an explanation the model added afterwards
+    juce::String trimTrailingText(const juce::String& document, NoteRepair::Report& report)
+    {
+        const int lastBrace = document.lastIndexOfChar('}');
+        if (lastBrace < 0 || document.substring(lastBrace + 1).trim().isEmpty())
+            return document;
+
+        report.strippedWrapper = true;
+        return document.substring(0, lastBrace + 1);
+    }
+}
+
+bool NoteRepair::Report::anyRepairs() const
+{
+    return strippedWrapper || salvagedTruncated || droppedElements > 0 || clampedValues > 0 || fixedTimings > 0 || removedDuplicates > 0;
+}
+
+juce::String NoteRepair::Report::describe() const
+{
+    juce::StringArray parts;
+    if (strippedWrapper)        parts.add("stripped wrapper text");
+    if (salvagedTruncated)      parts.add("salvaged truncated output");
+    if (droppedElements > 0)    parts.add("dropped " + juce::String(droppedElements) + " invalid elements");
+    if (clampedValues > 0)      parts.add("clamped " + juce::String(clampedValues) + " values");
+    if (fixedTimings > 0)       parts.add("fixed " + juce::String(fixedTimings) + " timings");
+    if (removedDuplicates > 0)  parts.add("removed " + juce::String(removedDuplicates) + " duplicates");
+    return parts.joinIntoString(", ");
+}
+
+void NoteRepair::Report::merge(const Report& other)
+{
+    strippedWrapper = strippedWrapper || other.strippedWrapper;
+    salvagedTruncated = salvagedTruncated || other.salvagedTruncated;
+    droppedElements += other.droppedElements;
+    clampedValues += other.clampedValues;
+    fixedTimings += other.fixedTimings;
+    removedDuplicates += other.removedDuplicates;
+}
+
+/**
+ * @brief Parses model output as leniently as possible. Tries, in order: the fast parser on the unwrapped document,
+ *        juce::JSON with element-by-element conversion, and finally pulling every complete note out of a document
+ *        that does not parse at all (e.g. one cut off mid-array)
+ * @param modelText The model's output text
+ * @param report Receives what was repaired
+ * @return The repaired notes, or an empty model if nothing could be recovered
+ */
+NoteSpecArray NoteRepair::parse(const juce::String& modelText, Report& report)
+{
+    const auto unwrapped = unwrapDocument(modelText, report);
+    if (unwrapped.isEmpty())
+        return NoteSpecs::fromVector({});
+
+    std::vector<NoteSpec> notes;
+    auto document = trimTrailingText(unwrapped, report);
+    int numClamped = 0;
+    bool parsed = NoteJsonParser::parseDocument(document.toRawUTF8(), document.getNumBytesAsUTF8(), notes, &numClamped);
+
+    if (parsed)
+        report.clampedValues += numClamped;
+    else
+    {
+        notes.clear(); // Whatever the fast parser got through before it gave up is parsed again below
+        auto notesArray = juce::JSON::parse(document)["notes"];
+        if (notesArray.isArray())
+        {
+            parsed = true;
+            notes.reserve((size_t) notesArray.size());
+            for (const auto& element : *notesArray.getArray())
+            {
+                if (auto note = NoteSpecs::fromVar(element, &report.clampedValues))
+                    notes.push_back(*note);
+                else
+                    report.droppedElements++;
+            }
+        }
+    }
+
+    if (! parsed)
+    {
+        // The streaming parser only needs each element to be complete, not the document
+        IncrementalNoteParser salvage([&notes](const NoteSpec& note) { notes.push_back(note); });
+        salvage.feed(unwrapped);
+        report.salvagedTruncated = ! notes.empty();
+    }
+
+    repairNotes(notes, report);
+    return NoteSpecs::fromVector(std::move(notes));
+}
+
+/**
+ * @brief Fixes what can be fixed on a single note without seeing the rest of the sequence
+ * @param note The note to fix
+ * @param report Counts the fix
+ * @return true if the note was changed
+ */
+bool NoteRepair::repairNote(NoteSpec& note, Report& report)
+{
+    bool changed = false;
+
+    if (note.startBeats < 0.0f)
+    {
+        note.startBeats = 0.0f;
+        changed = true;
+    }
+
+    if (! (note.durationBeats > 0.0f))
+    {
+        note.durationBeats = (float) DEFAULT_REPAIRED_DURATION_BEATS;
+        changed = true;
+    }
+
+    if (changed)
+        report.fixedTimings++;
+    return changed;
+}
+
+/**
+ * @brief Repairs timings across the sequence and merges duplicate notes
+ * @param notes The notes to repair in place; order is kept
+ * @param report Counts the fixes
+ */
+void NoteRepair::repairNotes(std::vector<NoteSpec>& notes, Report& report)
+{
+    if (notes.empty())
+        return;
+
+    // Sort an index by (channel, pitch, start) so duplicates sit next to each other, and by start alone to find the next note
+    std::vector<size_t> byPitch(notes.size()), byStart(notes.size());
+    for (size_t i = 0; i < notes.size(); ++i)
+        byPitch[i] = byStart[i] = i;
+
+    std::sort(byStart.begin(), byStart.end(), [&notes](size_t a, size_t b) { return notes[a].startBeats < notes[b].startBeats; });
+
+    // A zero or negative duration becomes the gap to the next note that starts later, like a legato line
+    for (size_t k = 0; k < byStart.size(); ++k)
+    {
+        auto& note = notes[byStart[k]];
+        if (note.startBeats < 0.0f)
+        {
+            note.startBeats = 0.0f;
+            report.fixedTimings++;
+        }
+
+        if (note.durationBeats > 0.0f)
+            continue;
+
+        double duration = DEFAULT_REPAIRED_DURATION_BEATS;
+        for (size_t next = k + 1; next < byStart.size(); ++next)
+        {
+            const double gap = notes[byStart[next]].startBeats - note.startBeats;
+            if (gap > SAME_START_TOLERANCE_BEATS)
+            {
+                duration = juce::jmin(gap, MAX_REPAIRED_DURATION_BEATS);
+                break;
+            }
+        }
+
+        note.durationBeats = (float) duration;
+        report.fixedTimings++;
+    }
+
+    std::sort(byPitch.begin(), byPitch.end(), [&notes](size_t a, size_t b)
+    {
+        if (notes[a].channel != notes[b].channel)
+            return notes[a].channel < notes[b].channel;
+        return notes[a].pitch != notes[b].pitch ? notes[a].pitch < notes[b].pitch
+                                                : (notes[a].startBeats != notes[b].startBeats ? notes[a].startBeats < notes[b].startBeats : a < b);
+    });
+
+    // The same pitch starting twice at once on one channel can only sound once: keep the first, with the longer length
+    // and louder velocity. Two parts playing the same pitch are not duplicates
+    std::vector<bool> removed(notes.size(), false);
+    int numRemoved = 0;
+    for (size_t k = 1; k < byPitch.size(); ++k)
+    {
+        auto& kept = notes[byPitch[k - 1]];
+        const auto& candidate = notes[byPitch[k]];
+        if (candidate.channel != kept.channel || candidate.pitch != kept.pitch
+            || std::abs(candidate.startBeats - kept.startBeats) > SAME_START_TOLERANCE_BEATS)
+            continue;
+
+        kept.durationBeats = juce::jmax(kept.durationBeats, candidate.durationBeats);
+        kept.velocity = juce::jmax(kept.velocity, candidate.velocity);
+        removed[byPitch[k]] = true;
+        byPitch[k] = byPitch[k - 1]; // Later duplicates compare against the kept note
+        numRemoved++;
+    }
+
+    report.removedDuplicates += numRemoved;
+    if (numRemoved == 0)
+        return;
+
+    size_t write = 0;
+    for (size_t read = 0; read < notes.size(); ++read)
+        if (! removed[read])
+            notes[write++] = notes[read];
+    notes.resize(write);
+}
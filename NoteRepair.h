@@ -0,0 +1,41 @@
+#pragma once
+#include <JuceHeader.h>
+#include "NoteSpec.h"
+
+/**
+ * NoteRepair - Validation and repair of model output, so bad output is fixed locally instead of re-requested.
+ *
+ * Recovers notes from text wrapped in code fences or prose, bare note arrays, documents cut off mid-array and
+ * elements that are not notes, then brings the notes themselves into shape: out-of-range pitch and velocity are
+ * clamped, negative starts and zero, negative or missing durations are fixed, and duplicate notes are merged.
+ * Everything it changed is counted in a Report; only output with no recoverable note at all is worth asking again.
+ */
+namespace NoteRepair
+{
+    /// What was repaired, for logging and analytics. All zero/false when the output was already clean
+    struct Report
+    {
+        bool strippedWrapper = false;   // Code fences, prose or a missing {"notes": ...} wrapper around the notes
+        bool salvagedTruncated = false; // Document did not parse; complete notes were recovered from it one by one
+        int droppedElements = 0;        // notes[] elements that were not a note in either format
+        int clampedValues = 0;          // Pitch/velocity outside MIDI range or non-numeric values
+        int fixedTimings = 0;           // Negative starts, and zero or negative durations
+        int removedDuplicates = 0;      // Notes with the same pitch and start as an earlier one
+
+        bool anyRepairs() const;
+
+        /// Comma-separated summary, e.g. "stripped wrapper, fixed 2 timings". Empty if nothing was repaired
+        juce::String describe() const;
+
+        void merge(const Report& other);
+    };
+
+    /// Parse model text into notes, repairing whatever can be repaired. Returns an empty model if nothing is recoverable
+    NoteSpecArray parse(const juce::String& modelText, Report& report);
+
+    /// Fix one note's timing in place, e.g. as it arrives in a stream. Returns true if it was changed
+    bool repairNote(NoteSpec& note, Report& report);
+
+    /// Fix timings (zero durations extend to the next note) and remove duplicates, keeping document order
+    void repairNotes(std::vector<NoteSpec>& notes, Report& report);
+}
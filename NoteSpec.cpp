@@ -0,0 +1,277 @@
+#include "NoteSpec.h"
+#include "NoteJsonParser.h"
+
+#define MAX_PARTS 16 // One per MIDI channel
+
+/**
+ * @brief Converts raw values into a NoteSpec, bringing each into range 
+ * @param numClamped Incremented once for each value that was out of range or not a number; may be null
+ * @return The note
+ */
+NoteSpec NoteSpecs::make(double startBeats, double durationBeats, double pitch, double velocity, int* numClamped)
+{
+    int clamped = 0;
+    auto finiteOr = [&clamped](double value, double fallback)
+    {
+        if (std::isfinite(value))
+            return value;
+        ++clamped;
+        return fallback;
+    };
+    auto clampToMidi = [&clamped](double value, int minimum)
+    {
+        const auto rounded = (int) juce::jlimit(-1.0e6, 1.0e6, value);
+        if (rounded < minimum || rounded > 127)
+            ++clamped;
+        return (juce::uint8) juce::jlimit(minimum, 127, rounded);
+    };
+
+    NoteSpec note;
+    note.startBeats = (float) finiteOr(startBeats, 0.0);
+    note.durationBeats = (float) finiteOr(durationBeats, 0.0);
+    note.pitch = clampToMidi(finiteOr(pitch, 60.0), 0);
+    note.velocity = clampToMidi(finiteOr(velocity, 100.0), 1);
+
+    if (numClamped != nullptr)
+        *numClamped += clamped;
+    return note;
+}
+
+/**
+ * @brief Brings a parsed channel into range. 0 (no part) is kept as it is 
+ * @param channel The channel as written by the model
+ * @param numClamped Incremented if the channel was out of range or not a number; may be null
+ * @return The channel, 0-16
+ */
+juce::uint8 NoteSpecs::makeChannel(double channel, int* numClamped)
+{
+    if (std::isfinite(channel) && channel >= 0.0 && channel <= 16.0)
+        return (juce::uint8) channel;
+
+    if (numClamped != nullptr)
+        ++*numClamped;
+    return (juce::uint8) (std::isfinite(channel) && channel > 16.0 ? 16 : 0);
+}
+
+/**
+ * @brief Converts one element of the notes array into a NoteSpec, clamping pitch and velocity into MIDI range 
+ * @param noteJSON A parsed {start_beats, duration_beats, midi_note, velocity[, channel]} object or compact 4- or
+ *                 5-number tuple
+ * @param numClamped Counts values that had to be brought into range; may be null
+ * @return The note, or nothing if the element is neither
+ */
+std::optional<NoteSpec> NoteSpecs::fromVar(const juce::var& noteJSON, int* numClamped)
+{
+    if (auto* tuple = noteJSON.getArray())
+    {
+        if (tuple->size() != 4 && tuple->size() != 5)
+            return std::nullopt;
+
+        auto note = make((double) (*tuple)[0], (double) (*tuple)[1], (double) (*tuple)[2], (double) (*tuple)[3], numClamped);
+        if (tuple->size() == 5)
+            note.channel = makeChannel((double) (*tuple)[4], numClamped);
+        return note;
+    }
+
+    // An object missing one of the note fields is malformed rather than a note with zeros in it
+    auto* noteObj = noteJSON.getDynamicObject();
+    if (noteObj == nullptr
+        || ! noteObj->hasProperty("start_beats") || ! noteObj->hasProperty("duration_beats")
+        || ! noteObj->hasProperty("midi_note") || ! noteObj->hasProperty("velocity"))
+        return std::nullopt;
+
+    auto note = make((double) noteObj->getProperty("start_beats"), (double) noteObj->getProperty("duration_beats"),
+                     (double) noteObj->getProperty("midi_note"), (double) noteObj->getProperty("velocity"), numClamped);
+    if (noteObj->hasProperty("channel"))
+        note.channel = makeChannel((double) noteObj->getProperty("channel"), numClamped);
+    return note;
+}
+
+/**
+ * @brief Reads the part names and channels of a multi-part document. The parts array is cut out and parsed alone, so
+ *        it can be read from a response that was cut off later on, or that has prose around it 
+ * @param document The model's output text
+ * @return One entry per valid part, first one wins for each channel; empty if the document declares no parts
+ */
+NoteSpecs::PartList NoteSpecs::partsFromJSON(const juce::String& document)
+{
+    PartList parts;
+
+    const int key = document.indexOf("\"parts\"");
+    const int arrayStart = key >= 0 ? document.indexOfChar(key, '[') : -1;
+    if (arrayStart < 0)
+        return parts;
+
+    // Find the matching bracket, skipping over any inside part names
+    int depth = 0, arrayEnd = -1;
+    bool inString = false, escaped = false;
+    for (int i = arrayStart; i < document.length() && arrayEnd < 0; ++i)
+    {
+        const auto c = document[i];
+        if (inString)
+        {
+            if (escaped)
+                escaped = false;
+            else if (c == '\\')
+                escaped = true;
+            else if (c == '"')
+                inString = false;
+        }
+        else if (c == '"')
+            inString = true;
+        else if (c == '[')
+            ++depth;
+        else if (c == ']' && --depth == 0)
+            arrayEnd = i;
+    }
+
+    if (arrayEnd < 0)
+        return parts;
+
+    auto partsArray = juce::JSON::parse(document.substring(arrayStart, arrayEnd + 1));
+    if (! partsArray.isArray())
+        return parts;
+
+    for (const auto& element : *partsArray.getArray())
+    {
+        const int channel = (int) element.getProperty("channel", 0);
+        const auto name = element.getProperty("name", {}).toString().trim();
+        const bool channelTaken = std::any_of(parts.begin(), parts.end(), [channel](const Part& part) { return part.channel == channel; });
+
+        if (channel >= 1 && channel <= 16 && name.isNotEmpty() && ! channelTaken && (int) parts.size() < MAX_PARTS)
+            parts.push_back({ name, channel });
+    }
+
+    return parts;
+}
+
+/**
+ * @brief Parses the model's JSON output into the note model. This is the only place a response's notes are parsed.
+ *        The specialised NoteJsonParser handles the expected shape; anything else goes through juce::JSON 
+ * @param sequenceJSON The {"notes":[...]} document returned by the model
+ * @return The parsed notes, in document order
+ */
+NoteSpecArray NoteSpecs::fromJSON(const juce::String& sequenceJSON)
+{
+    std::vector<NoteSpec> notes;
+
+    if (NoteJsonParser::parseDocument(sequenceJSON.toRawUTF8(), sequenceJSON.getNumBytesAsUTF8(), notes))
+        return fromVector(std::move(notes));
+
+    DBG("Unexpected note JSON shape - falling back to juce::JSON");
+
+    auto notesJson = juce::JSON::parse(sequenceJSON);
+    if (auto* notesObj = notesJson.getDynamicObject())
+    {
+        auto notesArray = notesObj->getProperty("notes");
+        if (notesArray.isArray())
+        {
+            notes.reserve((size_t) notesArray.size());
+            for (const auto& element : *notesArray.getArray())
+                if (auto note = fromVar(element))
+                    notes.push_back(*note);
+        }
+    }
+
+    return fromVector(std::move(notes));
+}
+
+NoteSpecArray NoteSpecs::fromVector(std::vector<NoteSpec> notes)
+{
+    return std::make_shared<const std::vector<NoteSpec>>(std::move(notes));
+}
+
+std::vector<NoteSpec> NoteSpecs::inRange(const NoteSpecArray& notes, double startBeats, double endBeats)
+{
+    std::vector<NoteSpec> selected;
+    if (notes != nullptr)
+        for (const auto& note : *notes)
+            if (note.startBeats >= startBeats && note.startBeats < endBeats)
+                selected.push_back(note);
+    return selected;
+}
+
+/**
+ * @brief Replaces one beat range of a note model, leaving the rest of it untouched 
+ * @param notes The model to edit; it is not changed
+ * @param startBeats Start of the range
+ * @param endBeats End of the range (exclusive)
+ * @param replacement The new notes for the range, timed from the start of the model
+ * @return The edited model
+ */
+NoteSpecArray NoteSpecs::spliceRange(const NoteSpecArray& notes, double startBeats, double endBeats, const std::vector<NoteSpec>& replacement)
+{
+    std::vector<NoteSpec> spliced;
+    spliced.reserve((size_t) size(notes) + replacement.size());
+
+    if (notes != nullptr)
+        for (const auto& note : *notes)
+            if (note.startBeats < startBeats || note.startBeats >= endBeats)
+                spliced.push_back(note);
+
+    for (const auto& note : replacement)
+        if (note.startBeats >= startBeats && note.startBeats < endBeats)
+            spliced.push_back(note);
+
+    std::stable_sort(spliced.begin(), spliced.end(), [](const NoteSpec& a, const NoteSpec& b) { return a.startBeats < b.startBeats; });
+    return fromVector(std::move(spliced));
+}
+
+/**
+ * @brief Writes notes in the compact tuple form with as few characters as possible (no spaces, no trailing zeros) 
+ * @param notes The notes to write
+ * @param maxNotes Notes beyond this are left out, keeping context within a predictable token budget
+ * @return A JSON array such as [[0,0.5,60,100],[0.5,0.5,62,96]]
+ */
+juce::String NoteSpecs::toCompactJSON(const NoteSpecArray& notes, int maxNotes)
+{
+    auto formatBeats = [](float beats)
+    {
+        auto text = juce::String(beats, 3);
+        if (text.containsChar('.'))
+            text = text.trimCharactersAtEnd("0").trimCharactersAtEnd(".");
+        return text;
+    };
+
+    juce::String json = "[";
+    const int numNotes = juce::jmin(size(notes), maxNotes);
+    for (int i = 0; i < numNotes; ++i)
+    {
+        const auto& note = (*notes)[(size_t) i];
+        if (i > 0)
+            json << ",";
+        json << "[" << formatBeats(note.startBeats) << "," << formatBeats(note.durationBeats) << ","
+             << (int) note.pitch << "," << (int) note.velocity;
+        if (note.channel > 0)
+            json << "," << (int) note.channel;
+        json << "]";
+    }
+    return json + "]";
+}
+
+void NoteSpecs::writePacked(juce::OutputStream& out, const std::vector<NoteSpec>& notes)
+{
+    for (const auto& note : notes)
+    {
+        out.writeFloat(note.startBeats);
+        out.writeFloat(note.durationBeats);
+        out.writeByte((char) note.pitch);
+        out.writeByte((char) note.velocity);
+        out.writeByte((char) note.channel);
+    }
+}
+
+std::vector<NoteSpec> NoteSpecs::readPacked(juce::InputStream& in, int numNotes)
+{
+    std::vector<NoteSpec> notes((size_t) juce::jmax(0, numNotes));
+    for (auto& note : notes)
+    {
+        note.startBeats = in.readFloat();
+        note.durationBeats = in.readFloat();
+        note.pitch = (juce::uint8) in.readByte();
+        note.velocity = (juce::uint8) in.readByte();
+        note.channel = (juce::uint8) juce::jlimit(0, 16, (int) (juce::uint8) in.readByte());
+    }
+
+    return notes;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <JuceHeader.h>
+
+/**
+ * NoteSpec - One generated note in the model's own units.
+ *
+ * This is the typed, compact form of a {start_beats, duration_beats, midi_note, velocity[, channel]} element. A response
+ * is converted into a NoteSpecArray exactly once; playback scheduling, note counting and MIDI export all read from it.
+ */
+struct NoteSpec
+{
+    float startBeats;     // Beats from the start of the sequence (1 beat = 1 quarter note)
+    float durationBeats;  // Length in beats
+    juce::uint8 pitch;    // MIDI note number (0-127)
+    juce::uint8 velocity; // How hard the note is played (1-127)
+    juce::uint8 channel = 0; // MIDI channel (1-16) of the note's part in a multi-part response, 0 for the output channel
+};
+
+/// Immutable, shareable note model for one generated sequence
+using NoteSpecArray = std::shared_ptr<const std::vector<NoteSpec>>;
+
+namespace NoteSpecs
+{
+    /// One named part of a multi-part response, e.g. { "drums", 10 }
+    struct Part
+    {
+        juce::String name;
+        int channel = 0; // 1-16
+    };
+
+    using PartList = std::vector<Part>;
+
+    /// Build a note from raw parsed values, clamping pitch to 0-127 and velocity to 1-127 (0 would be a note-off).
+    /// Non-finite values become 0 (pitch 60, velocity 100). numClamped, if given, counts every value that was changed
+    NoteSpec make(double startBeats, double durationBeats, double pitch, double velocity, int* numClamped = nullptr);
+
+    /// Bring a parsed part channel into 0-16, counting an out-of-range value in numClamped if given
+    juce::uint8 makeChannel(double channel, int* numClamped = nullptr);
+
+    /// Convert one parsed notes[] element. Returns nothing if the element is neither an object with all four note
+    /// fields nor a 4- or 5-number tuple
+    std::optional<NoteSpec> fromVar(const juce::var& noteJSON, int* numClamped = nullptr);
+
+    /// Read the "parts" list of a multi-part {"parts":[...],"notes":[...]} document. Only the parts array itself has to
+    /// be complete, so a truncated document still names its parts. Returns an empty list for a single-part document
+    PartList partsFromJSON(const juce::String& document);
+
+    /// The channel a note plays on: its part's channel, or outputChannel for a note that belongs to no part
+    inline int getChannel(const NoteSpec& note, int outputChannel) { return note.channel > 0 ? note.channel : outputChannel; }
+
+    /// Parse a {"notes":[...]} document into a note model. Returns an empty model if the document has no notes array
+    NoteSpecArray fromJSON(const juce::String& sequenceJSON);
+
+    /// Wrap notes that were built up elsewhere (e.g. while streaming) into an immutable model
+    NoteSpecArray fromVector(std::vector<NoteSpec> notes);
+
+    /// The notes of a model that start in [startBeats, endBeats), in model order
+    std::vector<NoteSpec> inRange(const NoteSpecArray& notes, double startBeats, double endBeats);
+
+    /// A new model with the notes that start in [startBeats, endBeats) replaced, ordered by start. Notes that start
+    /// before the range and ring on into it are kept; replacement notes outside the range are dropped
+    NoteSpecArray spliceRange(const NoteSpecArray& notes, double startBeats, double endBeats, const std::vector<NoteSpec>& replacement);
+
+    /// Serialise up to maxNotes notes as compact [start,dur,pitch,vel] tuples, e.g. to send back as prompt context.
+    /// Notes of a part get their channel as a fifth element
+    juce::String toCompactJSON(const NoteSpecArray& notes, int maxNotes);
+
+    /// Bytes per note in the packed binary form shared by the generation cache and the plugin state
+    constexpr int packedNoteBytes = 11; // start (float) + duration (float) + pitch + velocity + channel
+
+    /// Write notes in the packed binary form, without a count
+    void writePacked(juce::OutputStream& out, const std::vector<NoteSpec>& notes);
+
+    /// Read numNotes packed notes. The caller checks that the stream holds numNotes * packedNoteBytes bytes
+    std::vector<NoteSpec> readPacked(juce::InputStream& in, int numNotes);
+
+    /// Number of notes in a model, treating a null model as empty
+    inline int size(const NoteSpecArray& notes) { return notes != nullptr ? (int) notes->size() : 0; }
+}
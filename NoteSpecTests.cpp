@@ -0,0 +1,148 @@
+#include "NoteSpec.h"
+#include "RealtimeGuard.h"
+
+/**
+ * NoteSpecTests - juce::UnitTest coverage of the typed note model built from a response. Registered in the "Kiwi"
+ * category; run with juce::UnitTestRunner().runTestsInCategory("Kiwi").
+ *
+ * NoteSpecBenchmark compares parsing a response once into a NoteSpecArray with the three juce::JSON parses it
+ * replaced (note count, playback and export each parsed the response again). Allocations are counted through
+ * RealtimeGuard, so they are only reported in builds with KIWI_REALTIME_GUARD on. It is registered in the
+ * "Kiwi Benchmarks" category; run it with juce::UnitTestRunner().runTestsInCategory("Kiwi Benchmarks").
+ */
+namespace NoteSpecTestData
+{
+    /// A {"notes":[...]} response of numNotes keyed notes
+    inline juce::String makeResponse(int numNotes)
+    {
+        juce::MemoryOutputStream response;
+        response << "{\"notes\":[";
+        for (int i = 0; i < numNotes; ++i)
+            response << (i > 0 ? "," : "") << "{\"start_beats\":" << i * 0.5 << ",\"duration_beats\":0.5,\"midi_note\":"
+                     << 36 + i % 60 << ",\"velocity\":" << 40 + i % 80 << "}";
+        response << "]}";
+        return response.toString();
+    }
+
+    /// What each consumer did before the note model: parse the response and walk its notes array
+    inline int parseAndCountNotes(const juce::String& response)
+    {
+        int numNotes = 0;
+        const auto notesArray = juce::JSON::parse(response)["notes"];
+        if (auto* elements = notesArray.getArray())
+            for (const auto& element : *elements)
+                numNotes += element.isObject() ? 1 : 0;
+        return numNotes;
+    }
+}
+
+class NoteSpecTests : public juce::UnitTest
+{
+public:
+    NoteSpecTests() : juce::UnitTest("NoteSpec", "Kiwi") {}
+
+    void runTest() override
+    {
+        beginTest("Keyed and compact responses give the same model");
+        {
+            const auto keyed = NoteSpecs::fromJSON("{\"notes\":[{\"start_beats\":0.5,\"duration_beats\":1,\"midi_note\":60,\"velocity\":90},"
+                                                   "{\"start_beats\":1.5,\"duration_beats\":0.5,\"midi_note\":200,\"velocity\":0}]}");
+            const auto compact = NoteSpecs::fromJSON("{\"notes\":[[0.5,1,60,90],[1.5,0.5,200,0]]}");
+
+            expectEquals(NoteSpecs::size(keyed), 2);
+            expectEquals(NoteSpecs::size(compact), 2);
+            for (size_t i = 0; i < 2; ++i)
+            {
+                expectEquals((*keyed)[i].startBeats, (*compact)[i].startBeats);
+                expectEquals((int) (*keyed)[i].pitch, (int) (*compact)[i].pitch);
+                expectEquals((int) (*keyed)[i].velocity, (int) (*compact)[i].velocity);
+            }
+
+            // Out-of-range values are clamped into MIDI range once, when the model is built
+            expectEquals((int) (*keyed)[1].pitch, 127);
+            expectEquals((int) (*keyed)[1].velocity, 1);
+        }
+
+        beginTest("The compact note format is under half the size of keyed notes and reads back the same");
+        {
+            std::vector<NoteSpec> phrase;
+            for (int i = 0; i < 64; ++i)
+                phrase.push_back(NoteSpecs::make(i * 0.25, 0.25 + (i % 3) * 0.25, 48 + (i * 7) % 24, 70 + i % 50));
+            const auto model = NoteSpecs::fromVector(phrase);
+
+            // The same phrase as the model writes it in each format
+            juce::String keyed = "{\"notes\":[";
+            for (size_t i = 0; i < phrase.size(); ++i)
+                keyed << (i > 0 ? "," : "") << "{\"start_beats\":" << phrase[i].startBeats << ",\"duration_beats\":"
+                      << phrase[i].durationBeats << ",\"midi_note\":" << (int) phrase[i].pitch << ",\"velocity\":"
+                      << (int) phrase[i].velocity << "}";
+            keyed << "]}";
+            const auto compact = "{\"notes\":" + NoteSpecs::toCompactJSON(model, (int) phrase.size()) + "}";
+
+            logMessage("64 notes: keyed " + juce::String((int) keyed.getNumBytesAsUTF8()) + " bytes, compact "
+                       + juce::String((int) compact.getNumBytesAsUTF8()) + " bytes");
+            expectLessThan(compact.getNumBytesAsUTF8() * 2, keyed.getNumBytesAsUTF8());
+
+            const auto fromKeyed = NoteSpecs::fromJSON(keyed);
+            const auto fromCompact = NoteSpecs::fromJSON(compact);
+            expectEquals(NoteSpecs::size(fromCompact), NoteSpecs::size(fromKeyed));
+            for (size_t i = 0; i < phrase.size(); ++i)
+            {
+                expectEquals((*fromCompact)[i].startBeats, (*fromKeyed)[i].startBeats);
+                expectEquals((*fromCompact)[i].durationBeats, (*fromKeyed)[i].durationBeats);
+                expectEquals((int) (*fromCompact)[i].pitch, (int) (*fromKeyed)[i].pitch);
+            }
+        }
+    }
+};
+
+class NoteSpecBenchmark : public juce::UnitTest
+{
+public:
+    NoteSpecBenchmark() : juce::UnitTest("NoteSpec parse once vs three juce::JSON parses", "Kiwi Benchmarks") {}
+
+    void runTest() override
+    {
+        if (! RealtimeGuard::canCountAllocations())
+            logMessage("Allocation counts need KIWI_REALTIME_GUARD; only timings are reported");
+
+        for (int numNotes : { 1000, 10000, 100000 })
+        {
+            beginTest(juce::String(numNotes) + " notes");
+            const auto response = NoteSpecTestData::makeResponse(numNotes);
+
+            // Before: the note count for analytics, extractSequence and createMidiFile each parsed the response
+            int numCounted = 0;
+            auto startMs = juce::Time::getMillisecondCounterHiRes();
+            int jsonAllocations = 0;
+            {
+                RealtimeGuard::ScopedAllocationCounter allocations;
+                for (int consumer = 0; consumer < 3; ++consumer)
+                    numCounted = NoteSpecTestData::parseAndCountNotes(response);
+                jsonAllocations = allocations.getNumAllocations();
+            }
+            const auto jsonMs = juce::Time::getMillisecondCounterHiRes() - startMs;
+
+            // Now: one parse into the model, which every consumer reads
+            NoteSpecArray model;
+            startMs = juce::Time::getMillisecondCounterHiRes();
+            int modelAllocations = 0;
+            {
+                RealtimeGuard::ScopedAllocationCounter allocations;
+                model = NoteSpecs::fromJSON(response);
+                modelAllocations = allocations.getNumAllocations();
+            }
+            const auto modelMs = juce::Time::getMillisecondCounterHiRes() - startMs;
+
+            expectEquals(numCounted, numNotes);
+            expectEquals(NoteSpecs::size(model), numNotes);
+
+            logMessage(juce::String(numNotes) + " notes: 3 juce::JSON parses " + juce::String(jsonMs, 2) + " ms, "
+                       + juce::String(jsonAllocations) + " allocations; 1 NoteSpecs::fromJSON " + juce::String(modelMs, 2) + " ms, "
+                       + juce::String(modelAllocations) + " allocations, " + juce::String((int) (numNotes * sizeof(NoteSpec) / 1024)) + " KB held");
+        }
+    }
+};
+
+static NoteSpecTests noteSpecTests;
+static NoteSpecBenchmark noteSpecBenchmark;
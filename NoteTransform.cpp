@@ -0,0 +1,405 @@
+#include "NoteTransform.h"
+
+#define DEFAULT_QUANTIZE_GRID 0.25  // Sixteenth notes
+#define DEFAULT_SWING_GRID 0.5      // Eighth notes
+#define SWING_GRID_TOLERANCE 0.05   // Fraction of the grid a note may sit off an off-beat and still be swung
+#define HUMANIZE_TIMING_BEATS 0.02  // Largest timing nudge at depth 1
+#define HUMANIZE_VELOCITY 8.0       // Largest velocity nudge at depth 1
+#define DRUM_CHANNEL 10              // General MIDI percussion: pitches are drum sounds, not notes
+#define LOUDER_FACTOR 1.25
+#define SOFTER_FACTOR 0.8
+
+// Anonymous namespace: helpers used only within this .cpp file
+namespace
+{
+    using NoteTransform::Kind;
+    using NoteTransform::Operation;
+
+    /// Reads "7", "+7", "-5" or "seven" as a number, returning false if the token is neither
+    bool parseNumber(const juce::String& word, double& value)
+    {
+        static const char* numberWords[] = { "one", "two", "three", "four", "five", "six", "seven", "eight", "nine", "ten", "eleven", "twelve" };
+
+        if (word.isNotEmpty() && word.trimCharactersAtStart("+-").containsOnly("0123456789.") && word.containsAnyOf("0123456789"))
+        {
+            value = word.getDoubleValue();
+            return true;
+        }
+
+        for (int i = 0; i < (int) juce::numElementsInArray(numberWords); ++i)
+        {
+            if (word == numberWords[i])
+            {
+                value = i + 1;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /// Reads "80%" as 0.8, returning false if the token is not a percentage
+    bool parsePercent(const juce::String& word, double& fraction)
+    {
+        if (! word.endsWithChar('%') || ! word.dropLastCharacters(1).containsOnly("0123456789."))
+            return false;
+
+        fraction = word.dropLastCharacters(1).getDoubleValue() / 100.0;
+        return true;
+    }
+
+    /// Reads a note value ("1/16", "16th", "sixteenths", "8ths", "quarter") as a grid in beats
+    bool parseGrid(const juce::String& word, double& grid)
+    {
+        if (word.startsWith("1/") && word.substring(2).containsOnly("0123456789") && word.substring(2).getIntValue() > 0)
+        {
+            grid = 4.0 / word.substring(2).getIntValue();
+            return true;
+        }
+
+        if (word.startsWith("quarter") || word == "4th" || word == "4ths")            { grid = 1.0;   return true; }
+        if (word.startsWith("eighth") || word == "8th" || word == "8ths")             { grid = 0.5;   return true; }
+        if (word.startsWith("sixteenth") || word == "16th" || word == "16ths")        { grid = 0.25;  return true; }
+        if (word.startsWith("thirtysecond") || word == "32nd" || word == "32nds")     { grid = 0.125; return true; }
+        return false;
+    }
+
+    /// Reads an interval starting at tokens[i] into semitones, advancing i past it. Returns false if there is none there
+    bool parseInterval(const juce::StringArray& tokens, int& i, bool bareNumberIsSemitones, int& semitones)
+    {
+        const auto word = tokens[i];
+        const auto next = tokens[i + 1]; // Out of range reads return an empty string
+        const auto setSemitones = [&semitones](int size) { semitones = size; return true; };
+
+        double count = 0.0;
+        if (parseNumber(word, count))
+        {
+            if (next.startsWith("semitone") || next == "st" || (next == "half" && tokens[i + 2].startsWith("step")))
+            {
+                i += next == "half" ? 2 : 1;
+                return setSemitones(juce::roundToInt(count));
+            }
+            if (next.startsWith("octave"))
+            {
+                i += 1;
+                return setSemitones(juce::roundToInt(count * 12.0));
+            }
+            if (bareNumberIsSemitones && word.containsAnyOf("0123456789"))
+                return setSemitones(juce::roundToInt(count));
+            return false;
+        }
+
+        if (word.startsWith("octave"))   return setSemitones(12);
+        if (word.startsWith("semitone")) return setSemitones(1);
+        if (word == "tritone")           return setSemitones(6);
+        if (word == "tone")              return setSemitones(2);
+
+        if ((word == "half" || word == "whole") && next.startsWith("step"))
+        {
+            i += 1;
+            return setSemitones(word == "half" ? 1 : 2);
+        }
+
+        // Interval names, e.g. "fifth", "minor third", "perfect fourth"
+        int quality = 0; // -1 minor/diminished, +1 augmented
+        auto degree = word;
+        if (word == "minor" || word == "major" || word == "perfect" || word == "diminished" || word == "augmented")
+        {
+            quality = (word == "minor" || word == "diminished") ? -1 : (word == "augmented" ? 1 : 0);
+            degree = next;
+        }
+
+        static const char* degreeNames[] = { "second", "third", "fourth", "fifth", "sixth", "seventh" };
+        static const int majorSemitones[] = { 2, 4, 5, 7, 9, 11 };
+        for (int d = 0; d < (int) juce::numElementsInArray(degreeNames); ++d)
+        {
+            if (degree == degreeNames[d])
+            {
+                i += degree == word ? 0 : 1;
+                return setSemitones(majorSemitones[d] + quality);
+            }
+        }
+
+        return false;
+    }
+
+    /// Words that carry no edit of their own ("make it swing a little")
+    bool isFillerWord(const juce::String& word)
+    {
+        static const juce::StringArray fillers { "make", "it", "its", "the", "a", "an", "this", "that", "these", "and", "then", "also",
+                                                 "please", "to", "by", "of", "with", "on", "so", "can", "you", "could", "just", "now",
+                                                 "notes", "note", "sequence", "melody", "phrase", "pattern", "part", "loop", "riff",
+                                                 "everything", "all", "whole", "bit", "little", "more", "some", "feel", "groove",
+                                                 "grid", "timing", "pitch", "key", "steps", "step", "up", "down", "higher", "lower" };
+        return fillers.contains(word);
+    }
+
+    bool isSoftener(const juce::String& word)
+    {
+        return word == "slightly" || word == "slight" || word == "light" || word == "lightly" || word == "gentle"
+            || word == "gently" || word == "subtle" || word == "subtly" || word == "touch";
+    }
+
+    //==============================================================================
+    // Kernels: one pass over the contiguous notes each, without per-note allocation
+
+    void transpose(std::vector<NoteSpec>& notes, int semitones)
+    {
+        for (auto& note : notes)
+            if (note.channel != DRUM_CHANNEL)
+                note.pitch = (juce::uint8) juce::jlimit(0, 127, note.pitch + semitones);
+    }
+
+    void quantize(std::vector<NoteSpec>& notes, double grid, double strength)
+    {
+        const float g = (float) grid, s = (float) strength;
+        for (auto& note : notes)
+        {
+            const float start = note.startBeats;
+            const float end = start + note.durationBeats;
+            const float newStart = start + (std::round(start / g) * g - start) * s;
+            const float newEnd = end + (std::round(end / g) * g - end) * s;
+            note.startBeats = newStart;
+            note.durationBeats = newEnd > newStart ? newEnd - newStart : g; // A note rounded to nothing keeps one grid step
+        }
+    }
+
+    void swing(std::vector<NoteSpec>& notes, double grid, double amount)
+    {
+        // Full swing delays every off-beat by a third of the grid: straight eighths become a triplet feel
+        const float g = (float) grid, shift = (float) (amount * grid / 3.0), tolerance = (float) SWING_GRID_TOLERANCE;
+        for (auto& note : notes)
+        {
+            const float position = note.startBeats / g;
+            const float nearest = std::round(position);
+            const bool isOffBeat = std::abs(position - nearest) < tolerance && ((long long) nearest & 1) != 0;
+            const float delay = isOffBeat ? shift : 0.0f;
+            note.startBeats += delay;
+            note.durationBeats = juce::jmax(note.durationBeats - delay, note.durationBeats * 0.5f); // End where it did
+        }
+    }
+
+    void humanize(std::vector<NoteSpec>& notes, double depth, juce::int64 seed)
+    {
+        juce::Random random(seed);
+        const float timing = (float) (HUMANIZE_TIMING_BEATS * depth), velocity = (float) (HUMANIZE_VELOCITY * depth);
+        for (auto& note : notes)
+        {
+            note.startBeats = juce::jmax(0.0f, note.startBeats + (random.nextFloat() * 2.0f - 1.0f) * timing);
+            note.velocity = (juce::uint8) juce::jlimit(1, 127, juce::roundToInt(note.velocity + (random.nextFloat() * 2.0f - 1.0f) * velocity));
+        }
+    }
+
+    void scaleVelocity(std::vector<NoteSpec>& notes, double factor)
+    {
+        const float f = (float) factor;
+        for (auto& note : notes)
+            note.velocity = (juce::uint8) juce::jlimit(1, 127, juce::roundToInt(note.velocity * f));
+    }
+
+    void scaleTime(std::vector<NoteSpec>& notes, double factor)
+    {
+        const float f = (float) factor;
+        for (auto& note : notes)
+        {
+            note.startBeats *= f;
+            note.durationBeats *= f;
+        }
+    }
+
+    /// "1/16", or "1/8T" for a triplet grid
+    juce::String describeGrid(double grid)
+    {
+        const int divisions = juce::roundToInt(4.0 / grid);
+        if (divisions % 3 == 0)
+            return "1/" + juce::String(divisions * 2 / 3) + "T";
+        return "1/" + juce::String(divisions);
+    }
+}
+
+/**
+ * @brief Recognises prompts made only of mechanical edits. Every word has to belong to an edit or be filler, so
+ *        "transpose up a fifth and add a bassline" is left for the model
+ * @param prompt The user's prompt
+ * @return The edits in the order they were written, or an empty pipeline
+ */
+NoteTransform::Pipeline NoteTransform::parseCommand(const juce::String& prompt)
+{
+    // Hyphens between words separate them ("half-time"), but a leading minus still signs a number ("-5")
+    juce::String text = prompt.toLowerCase();
+    for (int i = 1; i < text.length(); ++i)
+        if (text[i] == '-' && juce::CharacterFunctions::isLetter(text[i - 1]))
+            text = text.replaceSection(i, 1, " ");
+
+    juce::StringArray tokens;
+    tokens.addTokens(text, " \t\r\n,.;:!?()", "\"");
+    tokens.removeEmptyStrings();
+
+    Pipeline pipeline;
+    int direction = 1;
+    bool expectInterval = false; // After "transpose", a bare number is a number of semitones
+    bool softened = false;       // A "slightly" that applies to the next edit
+    int velocityDirection = 0;   // Whether a percentage after a velocity edit is added (louder), taken off (softer) or the factor
+
+    auto lastIs = [&pipeline](Kind kind) { return ! pipeline.empty() && pipeline.back().kind == kind; };
+
+    for (int i = 0; i < tokens.size(); ++i)
+    {
+        const auto word = tokens[i];
+        const auto next = tokens[i + 1];
+        double value = 0.0, grid = 0.0;
+
+        if (word == "up" || word == "higher" || word == "raise")
+        {
+            direction = 1;
+            expectInterval = true;
+        }
+        else if (word == "down" || word == "lower" || word == "drop")
+        {
+            direction = -1;
+            expectInterval = true;
+        }
+        else if (word.startsWith("transpos") || word == "shift" || word == "move")
+        {
+            expectInterval = true;
+        }
+        else if ((word == "double" || word == "half") && (next == "time" || next == "speed"))
+        {
+            pipeline.push_back({ Kind::scaleTime, word == "double" ? 0.5 : 2.0 });
+            ++i;
+        }
+        else if (word == "doubletime" || word == "halftime")
+        {
+            pipeline.push_back({ Kind::scaleTime, word == "doubletime" ? 0.5 : 2.0 });
+        }
+        else if (int semitones = 0; parseInterval(tokens, i, expectInterval, semitones))
+        {
+            // A signed number carries its own direction
+            const bool signedNumber = word.startsWithChar('-') || word.startsWithChar('+');
+            pipeline.push_back({ Kind::transpose, (double) (signedNumber ? semitones : direction * semitones) });
+            direction = 1;
+            expectInterval = false;
+        }
+        else if (word.startsWith("quanti") || word == "snap" || word == "tighten" || word == "tighter")
+        {
+            pipeline.push_back({ Kind::quantize, softened ? 0.5 : 1.0, DEFAULT_QUANTIZE_GRID });
+            softened = false;
+        }
+        else if (word.startsWith("swing") || word == "swung" || word.startsWith("shuffle"))
+        {
+            pipeline.push_back({ Kind::swing, softened ? 0.5 : 1.0, DEFAULT_SWING_GRID });
+            softened = false;
+        }
+        else if (word.startsWith("humani") || word.startsWith("loosen") || word == "looser")
+        {
+            pipeline.push_back({ Kind::humanize, softened ? 0.5 : 1.0 });
+            softened = false;
+        }
+        else if (word == "louder" || word == "harder")
+        {
+            pipeline.push_back({ Kind::scaleVelocity, LOUDER_FACTOR });
+            velocityDirection = 1;
+        }
+        else if (word == "softer" || word == "quieter")
+        {
+            pipeline.push_back({ Kind::scaleVelocity, SOFTER_FACTOR });
+            velocityDirection = -1;
+        }
+        else if (word.startsWith("velocit") || word == "dynamics" || word == "volume")
+        {
+            pipeline.push_back({ Kind::scaleVelocity, 0.0 }); // Its factor follows, e.g. "velocity 80%"
+            velocityDirection = 0;
+        }
+        else if (parseGrid(word, grid) && (lastIs(Kind::quantize) || lastIs(Kind::swing)))
+        {
+            pipeline.back().grid = tokens[i - 1].startsWith("triplet") ? grid * 2.0 / 3.0 : grid; // "triplet 8ths"
+        }
+        else if (word.startsWith("triplet") && (lastIs(Kind::quantize) || lastIs(Kind::swing)))
+        {
+            if (! parseGrid(next, grid))
+                pipeline.back().grid *= 2.0 / 3.0; // "8th triplets", or the default grid
+        }
+        else if (parsePercent(word, value) && ! pipeline.empty() && pipeline.back().kind != Kind::transpose
+                 && pipeline.back().kind != Kind::scaleTime)
+        {
+            auto& operation = pipeline.back();
+            if (operation.kind == Kind::swing)
+                operation.amount = juce::jlimit(0.0, 1.5, (value - 0.5) * 6.0); // Swing percentages: 50% straight, 66% triplet
+            else if (operation.kind == Kind::scaleVelocity && velocityDirection != 0)
+                operation.amount = juce::jmax(0.0, 1.0 + velocityDirection * value);
+            else
+                operation.amount = value;
+        }
+        else if (isSoftener(word))
+        {
+            if (! pipeline.empty() && pipeline.back().kind != Kind::transpose && pipeline.back().amount == 1.0)
+                pipeline.back().amount = 0.5; // "swing it slightly"
+            else
+                softened = true;             // "slightly swing it"
+        }
+        else if (! isFillerWord(word))
+        {
+            return {}; // Something only the model can do
+        }
+    }
+
+    // "velocity" with no factor after it doesn't say what to do
+    for (const auto& operation : pipeline)
+        if (operation.kind == Kind::scaleVelocity && operation.amount <= 0.0)
+            return {};
+
+    return pipeline;
+}
+
+/**
+ * @brief Applies each edit as one pass over a copy of the notes, then restores start order if timing moved
+ * @param notes The note model to edit; it is not changed
+ * @param pipeline The edits, applied in order
+ * @param seed Seeds humanize
+ * @return The edited model
+ */
+NoteSpecArray NoteTransform::apply(const NoteSpecArray& notes, const Pipeline& pipeline, juce::int64 seed)
+{
+    std::vector<NoteSpec> edited;
+    if (notes != nullptr)
+        edited = *notes;
+
+    bool timingChanged = false;
+    for (const auto& operation : pipeline)
+    {
+        switch (operation.kind)
+        {
+            case Kind::transpose:     transpose(edited, juce::roundToInt(operation.amount)); break;
+            case Kind::quantize:      quantize(edited, operation.grid, operation.amount); timingChanged = true; break;
+            case Kind::swing:         swing(edited, operation.grid, operation.amount); timingChanged = true; break;
+            case Kind::humanize:      humanize(edited, operation.amount, seed++); timingChanged = true; break;
+            case Kind::scaleVelocity: scaleVelocity(edited, operation.amount); break;
+            case Kind::scaleTime:     scaleTime(edited, operation.amount); break;
+        }
+    }
+
+    const auto byStart = [](const NoteSpec& a, const NoteSpec& b) { return a.startBeats < b.startBeats; };
+    if (timingChanged && ! std::is_sorted(edited.begin(), edited.end(), byStart))
+        std::stable_sort(edited.begin(), edited.end(), byStart);
+
+    return NoteSpecs::fromVector(std::move(edited));
+}
+
+juce::String NoteTransform::describe(const Pipeline& pipeline)
+{
+    juce::StringArray parts;
+    for (const auto& operation : pipeline)
+    {
+        const auto percent = juce::String(juce::roundToInt(operation.amount * 100.0)) + "%";
+        switch (operation.kind)
+        {
+            case Kind::transpose:     parts.add("transpose " + juce::String(operation.amount > 0 ? "+" : "") + juce::String(juce::roundToInt(operation.amount))); break;
+            case Kind::quantize:      parts.add("quantize " + describeGrid(operation.grid) + (operation.amount < 1.0 ? " " + percent : juce::String())); break;
+            case Kind::swing:         parts.add("swing " + describeGrid(operation.grid) + " " + percent); break;
+            case Kind::humanize:      parts.add("humanize " + percent); break;
+            case Kind::scaleVelocity: parts.add("velocity " + percent); break;
+            case Kind::scaleTime:     parts.add(operation.amount < 1.0 ? "double time" : "half time"); break;
+        }
+    }
+    return parts.joinIntoString(", ");
+}
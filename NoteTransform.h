@@ -0,0 +1,35 @@
+#pragma once
+#include <JuceHeader.h>
+#include "NoteSpec.h"
+
+/**
+ * NoteTransform - Instant local edits of a note model: transpose, quantize, swing, humanize, velocity scaling and
+ * tempo doubling/halving.
+ *
+ * Mechanical follow-up prompts ("transpose up a fifth", "make it swing", "quantize to 1/16") are recognised by
+ * parseCommand and applied here instead of going back to the model. Each operation is one tight pass over the
+ * contiguous note array, so a whole pipeline over thousands of notes takes microseconds.
+ */
+namespace NoteTransform
+{
+    enum class Kind { transpose, quantize, swing, humanize, scaleVelocity, scaleTime };
+
+    struct Operation
+    {
+        Kind kind;
+        double amount = 0.0; // Semitones, quantize strength (0-1), swing (1 = triplet feel), humanize depth, velocity or time factor
+        double grid = 0.25;  // Grid in beats for quantize and swing
+    };
+
+    using Pipeline = std::vector<Operation>;
+
+    /// Recognise a prompt that consists only of mechanical edits, e.g. "transpose up a fifth and quantize to 1/16".
+    /// Returns an empty pipeline if anything in the prompt asks for more than that
+    Pipeline parseCommand(const juce::String& prompt);
+
+    /// Apply a pipeline to a note model. The result is sorted by start; humanize is seeded so it can be repeated
+    NoteSpecArray apply(const NoteSpecArray& notes, const Pipeline& pipeline, juce::int64 seed);
+
+    /// Short description for logs and the chat history, e.g. "transpose +7, quantize 1/16"
+    juce::String describe(const Pipeline& pipeline);
+}
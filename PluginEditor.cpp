@@ -13,6 +13,52 @@
 #include <string>
 #include <functional>
 
+#define BEATS_PER_BAR 4
+
+// Anonymous namespace: helpers used only within this .cpp file
+namespace
+{
+    /// Reads a range edit such as "bars 5-8: busier" (1-based, inclusive) or "beats 16-24: sparser" (end-exclusive)
+    /// @return false if the input is an ordinary prompt
+    bool parseRangeEdit(const juce::String& input, double& startBeats, double& endBeats, juce::String& rangePrompt)
+    {
+        if (! input.containsChar(':'))
+            return false;
+
+        juce::StringArray tokens;
+        tokens.addTokens(input.upToFirstOccurrenceOf(":", false, false).toLowerCase(), " -", "");
+        tokens.removeEmptyStrings();
+        tokens.removeString("to");
+
+        if (tokens.size() < 2 || tokens.size() > 3 || ! (tokens[0].startsWith("bar") || tokens[0].startsWith("beat")))
+            return false;
+
+        for (int i = 1; i < tokens.size(); ++i)
+            if (! tokens[i].containsOnly("0123456789."))
+                return false;
+
+        const double first = tokens[1].getDoubleValue();
+        const double last = tokens[tokens.size() - 1].getDoubleValue();
+
+        if (tokens[0].startsWith("bar"))
+        {
+            startBeats = (first - 1.0) * BEATS_PER_BAR;
+            endBeats = last * BEATS_PER_BAR;
+        }
+        else
+        {
+            startBeats = first;
+            endBeats = tokens.size() > 2 ? last : first + 1.0;
+        }
+
+        rangePrompt = input.fromFirstOccurrenceOf(":", false, false).trim();
+        if (rangePrompt.isEmpty())
+            rangePrompt = "A fresh take on this part";
+
+        return startBeats >= 0.0 && endBeats > startBeats;
+    }
+}
+
 //==============================================================================
 KiwiPluginAudioProcessorEditor::KiwiPluginAudioProcessorEditor (KiwiPluginAudioProcessor& p)
     : AudioProcessorEditor (&p), audioProcessor (p)
@@ -20,13 +66,16 @@ KiwiPluginAudioProcessorEditor::KiwiPluginAudioProcessorEditor (KiwiPluginAudioP
     // Set custom LookAndFeel for global font
     setLookAndFeel(&customLookAndFeel);
     
-    // Load existing chat history from processor (persists across editor close/reopen)
-    chatHistory.loadFromHistory(audioProcessor.getChatHistory());
+    // Load the newest page of the chat history from the processor (persists across editor close/reopen)
+    chatHistory.loadFromHistory(audioProcessor.getChatHistorySize(), [this](int first, int count)
+    {
+        return audioProcessor.getChatHistoryPage(first, count);
+    });
     chatHistory.setOnMidiDragged([this](const ChatEntry& entry)
     {
         juce::DynamicObject::Ptr props(new juce::DynamicObject());
-        props->setProperty("has_midi_file", entry.midiFile.existsAsFile());
-        props->setProperty("midi_file_bytes", (double) entry.midiFile.getSize());
+        props->setProperty("has_midi_file", entry.midiExport != nullptr);
+        props->setProperty("midi_file_bytes", entry.midiExport != nullptr ? (double) entry.midiExport->getSizeBytes() : 0.0);
         props->setProperty("prompt_length", (int) entry.prompt.length());
         analytics.trackEvent("midi_dragged", juce::var(props.get()));
     });
@@ -64,6 +113,22 @@ KiwiPluginAudioProcessorEditor::KiwiPluginAudioProcessorEditor (KiwiPluginAudioP
     };
     addAndMakeVisible(replayButton);
 
+    // Setup launch quantization selector: where triggered sequences start relative to the host grid 
+    launchQuantizationBox.addItem("Now", 1);
+    launchQuantizationBox.addItem("Beat", 2);
+    launchQuantizationBox.addItem("Bar", 3);
+    launchQuantizationBox.setSelectedId((int) audioProcessor.getLaunchQuantization() + 1, juce::dontSendNotification);
+    launchQuantizationBox.onChange = [this] {
+        audioProcessor.setLaunchQuantization((SequenceScheduler::LaunchQuantization) (launchQuantizationBox.getSelectedId() - 1));
+    };
+    addAndMakeVisible(launchQuantizationBox);
+
+    // Setup variation count selector: how many alternative sequences each prompt requests 
+    for (int count = 1; count <= 4; ++count)
+        variationCountBox.addItem("x" + juce::String(count), count);
+    variationCountBox.setSelectedId(1, juce::dontSendNotification);
+    addAndMakeVisible(variationCountBox);
+
     // Setup text entry field 
     textEntry.setMultiLine(true);
     textEntry.setReturnKeyStartsNewLine(false);
@@ -72,9 +137,15 @@ KiwiPluginAudioProcessorEditor::KiwiPluginAudioProcessorEditor (KiwiPluginAudioP
     textEntry.setFont(textEntryFont);
     textEntry.setColour(juce::TextEditor::textColourId, juce::Colours::black);
     textEntry.setColour(juce::TextEditor::backgroundColourId, juce::Colour(0xFF9CCC65));
+    textEntry.setTextToShowWhenEmpty("Describe a sequence, or \"bars 5-8: busier\" to redo part of the last one", juce::Colours::black.withAlpha(0.5f));
     textEntry.onReturnKey = [this] { 
         juce::String userInput = textEntry.getText();
         DBG("ENTER PRESSED: " + userInput);
+
+        // A leading '!' bypasses the generation cache and always asks the model for a fresh result
+        const bool forceFresh = userInput.startsWith("!");
+        if (forceFresh)
+            userInput = userInput.substring(1).trim();
         
         if (userInput.isNotEmpty())
         {
@@ -92,8 +163,12 @@ KiwiPluginAudioProcessorEditor::KiwiPluginAudioProcessorEditor (KiwiPluginAudioP
                 analytics.trackEvent("prompt_submitted", juce::var(props.get()));
             }
 
-            juce::String savedPrompt = userInput; // Save prompt before clearing
             textEntry.clear(); // Clear immediately 
+
+            // A new prompt supersedes whatever is still generating; the old request's stream is aborted
+            if (activeGeneration.isValid() && ! activeGeneration.isCancelled() && audioProcessor.isGeneratorLoading())
+                trackCancellation("superseded");
+            activeGeneration.cancel();
             
             // Show loading indicator
             isLoading = true;
@@ -108,32 +183,94 @@ KiwiPluginAudioProcessorEditor::KiwiPluginAudioProcessorEditor (KiwiPluginAudioP
             DBG("Loading started - isLoading: " + juce::String(isLoading ? "true" : "false"));
             DBG("Image valid: " + juce::String(kiwiImage.isValid() ? "true" : "false"));
 
+            // "bars 5-8: busier" regenerates part of the current phrase instead of writing a new one
+            double rangeStartBeats = 0.0, rangeEndBeats = 0.0;
+            juce::String rangePrompt;
+            if (audioProcessor.getCurrentNoteCount() > 0 && parseRangeEdit(userInput, rangeStartBeats, rangeEndBeats, rangePrompt))
+            {
+                requestRangeRegeneration(userInput, rangeStartBeats, rangeEndBeats, rangePrompt);
+                return;
+            }
+
+            // Several variations fan out on the generator's worker pool and arrive one by one. A mechanical edit of the
+            // current phrase ("transpose up a fifth") has only one answer, so it is applied once whatever the count
+            const int numVariations = variationCountBox.getSelectedId();
+            if (numVariations > 1 && ! audioProcessor.isTransformCommand(userInput))
+            {
+                requestVariations(userInput, numVariations, forceFresh);
+                return;
+            }
+
+            // Long pieces are generated section by section, all at once, and start playing with their first section
+            if (audioProcessor.isLongFormPrompt(userInput))
+            {
+                requestLongForm(userInput, forceFresh);
+                return;
+            }
+
             // Create a safe pointer to this editor - becomes null if editor is destroyed
             juce::Component::SafePointer<KiwiPluginAudioProcessorEditor> safeThis(this);
+            auto draftPlayed = std::make_shared<bool>(false); // Only touched on the message thread
+            auto draftEntryIndex = std::make_shared<int>(-1); // History index of the local draft's entry, once added
             
             // Send to API - this runs async on background thread
-            audioProcessor.sendPromptToGenerator(userInput, audioProcessor.getRecentPromptsForContext(2), [safeThis, savedPrompt, requestStartMs, &processor = audioProcessor](juce::String response) {
+            activeGeneration = audioProcessor.sendPromptToGenerator(userInput, audioProcessor.getRecentPromptsForContext(2), [safeThis, requestStartMs, forceFresh, draftPlayed, draftEntryIndex, &processor = audioProcessor](const GenerationResult& result) {
                 // This callback runs on main thread after API response
                 // Verify we're on the message thread 
                 jassert(juce::MessageManager::getInstance()->isThisTheMessageThread());
-                DBG("OpenAI Response received");
+                DBG("Generation result received for request " + juce::String((juce::int64) result.requestId));
+
+                // A local draft plays straight away and can be dragged out; the spinner keeps going until the refined result arrives
+                if (result.provisional)
+                {
+                    if (!processor.getSequenceStatus())
+                    {
+                        processor.playResult(result);
+                        *draftPlayed = true;
+                    }
+
+                    // The refined result replaces this entry when it arrives
+                    ChatEntry entry(result.prompt, "Local draft", processor.createMidiExport(result.notes), result.notes);
+                    *draftEntryIndex = processor.addChatEntry(entry);
+                    if (safeThis != nullptr)
+                        safeThis->chatHistory.addChatEntry(entry);
+                    return;
+                }
 
                 const auto latencyMs = (int) std::round(juce::Time::getMillisecondCounterHiRes() - requestStartMs);
-                const bool isError = response.startsWithIgnoreCase("Error:") || response.startsWithIgnoreCase("API error");
+                const bool isError = ! result.succeeded();
+                juce::StringArray partNames;
+                for (const auto& part : result.parts)
+                    partNames.add(part.name);
+
+                const juce::String response = isError ? "Error: " + result.error
+                                            : result.transform.isNotEmpty() ? "Applied locally: " + result.transform
+                                            : partNames.isEmpty() ? juce::String("Sequence generated")
+                                                                  : "Sequence generated: " + partNames.joinIntoString(", ");
+
+                // The result owns its notes, so playback and the MIDI file both come from this request alone.
+                // A refined result takes over from its own draft, and an edit of the playing phrase replaces it
+                if (!processor.getSequenceStatus() || (*draftPlayed && !isError) || result.transform.isNotEmpty())
+                    processor.playResult(result);
+                else
+                    DBG("playResult() SKIPPED - sequence already in progress");
+
+                // When refinement fails the draft already in the chat history stands as the answer
+                const bool keepDraft = isError && *draftEntryIndex >= 0;
                 
                 // Check if editor still exists before accessing its members 
                 if (safeThis == nullptr)
                 {
                     DBG("Editor was destroyed - skipping UI updates but continuing audio processing");
 
-                    // Editor is gone but we can still trigger audio and persist history (processor outlives editor)
-                    if(!processor.getSequenceStatus()) { 
-                        processor.triggerNote();
-                    }
-                    
-                    juce::File midiFile = processor.createMidiFile();
-                    ChatEntry entry(savedPrompt, "Sequence generated", midiFile);
-                    processor.addChatEntry(entry);
+                    // Editor is gone but we can still persist history (processor outlives editor)
+                    if (keepDraft)
+                        return;
+                    ChatEntry entry(result.prompt, response, processor.createMidiExport(result.notes), result.notes);
+                    if (*draftEntryIndex >= 0)
+                        processor.replaceChatEntry(*draftEntryIndex, entry);
+                    else
+                        processor.addChatEntry(entry);
                     return;
                 }
                 
@@ -146,35 +283,67 @@ KiwiPluginAudioProcessorEditor::KiwiPluginAudioProcessorEditor (KiwiPluginAudioP
                 safeThis->chatHistory.setVisible(true);
                 safeThis->repaint();
 
-                // Trigger sequence generation after response is received
-                DBG("About to call triggerNote. sequenceInProgress: " + juce::String(processor.getSequenceStatus() ? "true" : "false"));
-                if(!processor.getSequenceStatus()) { 
-                    processor.triggerNote();
-                    DBG("triggerNote() called");
-                }
-                else {
-                    DBG("triggerNote() SKIPPED - sequence already in progress");
-                }
-
                 {
                     juce::DynamicObject::Ptr props(new juce::DynamicObject());
                     props->setProperty("latency_ms", latencyMs);
                     props->setProperty("result", isError ? "error" : "ok");
                     if (!isError)
-                        props->setProperty("note_count", processor.getLastGeneratedNoteCount());
+                        props->setProperty("note_count", NoteSpecs::size(result.notes));
+                    props->setProperty("cache_hit", result.fromCache);
+                    props->setProperty("cache_bypassed", forceFresh);
+                    props->setProperty("source", result.transform.isNotEmpty() ? "transform" : (result.fromCache ? "cache" : (result.fromLocal ? "local" : "remote")));
+                    if (result.transform.isNotEmpty())
+                        props->setProperty("transform", result.transform);
+                    props->setProperty("part_count", juce::jmax(1, (int) result.parts.size()));
+                    props->setProperty("backend", result.backend);
+                    props->setProperty("note_format", result.compactFormat ? "compact" : "verbose");
+                    if (result.outputTokens > 0)
+                        props->setProperty("output_tokens", result.outputTokens);
+                    props->setProperty("repaired", result.repairs.anyRepairs());
+                    if (result.repairs.anyRepairs())
+                        props->setProperty("repairs", result.repairs.describe());
+                    props->setProperty("local_draft_played", *draftPlayed);
+                    props->setProperty("cache_hits", processor.getGenerationCacheHits());
+                    props->setProperty("cache_misses", processor.getGenerationCacheMisses());
+                    props->setProperty("latency_p95_ms", (int) std::round(processor.getGenerationLatencyP95Ms()));
+                    props->setProperty("hedged_requests", processor.getHedgedRequestCount());
+                    props->setProperty("hedge_wins", processor.getHedgeWinCount());
                     safeThis->analytics.trackEvent(isError ? "generation_failed" : "generation_completed", juce::var(props.get()));
                 }
                 
-                // Create MIDI file automatically 
-                juce::File midiFile = processor.createMidiFile();
+                if (keepDraft)
+                    return;
                 
-                // Add to chat history: UI component for display, processor for persistence across editor close/reopen
-                ChatEntry entry(savedPrompt, "Sequence generated", midiFile);
+                // Export MIDI automatically; it stays in memory until the entry is dragged out 
+                auto midiExport = processor.createMidiExport(result.notes);
+                
+                // Add to chat history: UI component for display, processor for persistence across editor close/reopen.
+                // A refined result takes its draft's place
+                ChatEntry entry(result.prompt, response, midiExport, result.notes);
+                if (*draftEntryIndex >= 0)
+                {
+                    safeThis->chatHistory.replaceChatEntry(*draftEntryIndex, entry);
+                    processor.replaceChatEntry(*draftEntryIndex, entry);
+                    return;
+                }
+
                 safeThis->chatHistory.addChatEntry(entry);
                 processor.addChatEntry(entry);
-            });
+            }, forceFresh);
         }
     };
+    // Escape abandons the request in flight and returns to the chat history
+    textEntry.onEscapeKey = [this] {
+        if (! isLoading)
+            return;
+
+        trackCancellation("escape");
+        activeGeneration.cancel();
+        stopTimer();
+        isLoading = false;
+        chatHistory.setVisible(true);
+        repaint();
+    };
     addAndMakeVisible(textEntry);
     
     // Setup chat history
@@ -246,13 +415,259 @@ void KiwiPluginAudioProcessorEditor::resized()
     // Position the text entry field at the bottom 
     textEntry.setBounds(10, getHeight() - 110, getWidth() - 110, 100);
     
-    // Position the replay button aligned with the text entry field
-    replayButton.setBounds(getWidth() - 90, getHeight() - 110, 80, 100); 
+    // Position the replay button aligned with the text entry field, with the variation and launch quantization selectors below it
+    replayButton.setBounds(getWidth() - 90, getHeight() - 110, 80, 40); 
+    variationCountBox.setBounds(getWidth() - 90, getHeight() - 65, 80, 25);
+    launchQuantizationBox.setBounds(getWidth() - 90, getHeight() - 35, 80, 25);
     
     // Chat history takes up the rest of the space above
     chatHistory.setBounds(10, 10, getWidth() - 20, getHeight() - 130);
 }
 
+/**
+ * @brief Requests several variations of a prompt. The first variation to arrive starts playing and clears the loading
+ *        screen; every successful variation is added to the chat history with its own MIDI file as it arrives 
+ * @param prompt The user's prompt
+ * @param numVariations How many variations to request
+ * @param forceFresh Skip the generation cache 
+ */
+void KiwiPluginAudioProcessorEditor::requestVariations(const juce::String& prompt, int numVariations, bool forceFresh)
+{
+    juce::Component::SafePointer<KiwiPluginAudioProcessorEditor> safeThis(this);
+    auto firstArrived = std::make_shared<bool>(false); // Only touched on the message thread
+
+    activeGeneration = audioProcessor.sendPromptVariationsToGenerator(prompt, audioProcessor.getRecentPromptsForContext(2), numVariations,
+        [safeThis, firstArrived, &processor = audioProcessor](const GenerationResult& result)
+    {
+        jassert(juce::MessageManager::getInstance()->isThisTheMessageThread());
+
+        const bool isError = ! result.succeeded();
+        const auto label = "Variation " + juce::String(result.variationIndex + 1) + " of " + juce::String(result.variationCount);
+        DBG(label + (isError ? " failed: " + result.error : " received"));
+
+        // The first usable variation plays straight away, the rest are there to audition from the chat history
+        const bool isFirstUsable = ! isError && ! *firstArrived;
+        if (isFirstUsable)
+        {
+            *firstArrived = true;
+            if (! processor.getSequenceStatus())
+                processor.playResult(result);
+        }
+
+        // Leave the loading screen on the first usable variation, or once the whole batch has come back without one
+        if (safeThis != nullptr && safeThis->isLoading && (isFirstUsable || ! processor.isGeneratorLoading()))
+        {
+            safeThis->stopTimer();
+            safeThis->isLoading = false;
+            safeThis->chatHistory.setVisible(true);
+            safeThis->repaint();
+        }
+
+        if (safeThis != nullptr)
+        {
+            juce::DynamicObject::Ptr props(new juce::DynamicObject());
+            props->setProperty("variation_index", result.variationIndex);
+            props->setProperty("variation_count", result.variationCount);
+            props->setProperty("latency_ms", (int) std::round(result.latencyMs));
+            props->setProperty("queue_wait_ms", (int) std::round(result.queueWaitMs));
+            props->setProperty("worker_count", processor.getGenerationWorkerCount());
+            props->setProperty("result", isError ? "error" : "ok");
+            props->setProperty("cache_hit", result.fromCache);
+            props->setProperty("source", result.fromCache ? "cache" : (result.fromLocal ? "local" : "remote"));
+            props->setProperty("backend", result.backend);
+            props->setProperty("note_format", result.compactFormat ? "compact" : "verbose");
+            if (result.outputTokens > 0)
+                props->setProperty("output_tokens", result.outputTokens);
+            props->setProperty("repaired", result.repairs.anyRepairs());
+            if (! isError)
+                props->setProperty("note_count", NoteSpecs::size(result.notes));
+            safeThis->analytics.trackEvent(isError ? "variation_failed" : "variation_completed", juce::var(props.get()));
+        }
+
+        if (isError)
+            return;
+
+        // Each variation gets its own entry and MIDI file: UI component for display, processor for persistence
+        ChatEntry entry(result.prompt, label, processor.createMidiExport(result.notes), result.notes);
+        if (safeThis != nullptr)
+            safeThis->chatHistory.addChatEntry(entry);
+        processor.addChatEntry(entry);
+    }, forceFresh);
+}
+
+/**
+ * @brief Requests a long piece section by section. The first section starts playing and clears the loading screen,
+ *        and is added to the chat history so it can be dragged out straight away; the whole piece replaces that entry
+ *        once every section has arrived 
+ * @param prompt The user's prompt
+ * @param forceFresh Skip the generation cache 
+ */
+void KiwiPluginAudioProcessorEditor::requestLongForm(const juce::String& prompt, bool forceFresh)
+{
+    juce::Component::SafePointer<KiwiPluginAudioProcessorEditor> safeThis(this);
+    const auto requestStartMs = juce::Time::getMillisecondCounterHiRes();
+    auto sectionsFromLocal = std::make_shared<int>(0); // Only touched on the message thread
+    auto sectionEntryIndex = std::make_shared<int>(-1); // History index of the first section's entry, once added
+
+    activeGeneration = audioProcessor.sendLongFormPromptToGenerator(prompt, audioProcessor.getRecentPromptsForContext(2),
+        [safeThis, requestStartMs, sectionsFromLocal, sectionEntryIndex, &processor = audioProcessor](const GenerationResult& section)
+    {
+        jassert(juce::MessageManager::getInstance()->isThisTheMessageThread());
+
+        const auto label = section.sectionName + " (section " + juce::String(section.sectionIndex + 1) + " of " + juce::String(section.sectionCount) + ")";
+        DBG("Long-form " + label + " playing" + (section.fromLocal ? " (local)" : ""));
+
+        if (section.fromLocal)
+            ++*sectionsFromLocal;
+
+        if (section.sectionIndex > 0)
+            return;
+
+        // The first section is playing: leave the loading screen while the rest of the piece is generated 
+        if (safeThis != nullptr && safeThis->isLoading)
+        {
+            safeThis->stopTimer();
+            safeThis->isLoading = false;
+            safeThis->chatHistory.setVisible(true);
+            safeThis->repaint();
+        }
+
+        if (safeThis != nullptr)
+        {
+            juce::DynamicObject::Ptr props(new juce::DynamicObject());
+            props->setProperty("first_section_ms", (int) std::round(juce::Time::getMillisecondCounterHiRes() - requestStartMs));
+            props->setProperty("section_count", section.sectionCount);
+            props->setProperty("source", section.fromCache ? "cache" : (section.fromLocal ? "local" : "remote"));
+            props->setProperty("backend", section.backend);
+            safeThis->analytics.trackEvent("long_form_started", juce::var(props.get()));
+        }
+
+        // The whole piece replaces this entry when it arrives
+        ChatEntry entry(section.prompt, label, processor.createMidiExport(section.notes), section.notes);
+        *sectionEntryIndex = processor.addChatEntry(entry);
+        if (safeThis != nullptr)
+            safeThis->chatHistory.addChatEntry(entry);
+    },
+        [safeThis, requestStartMs, sectionsFromLocal, sectionEntryIndex, &processor = audioProcessor](const GenerationResult& piece)
+    {
+        jassert(juce::MessageManager::getInstance()->isThisTheMessageThread());
+
+        const bool isError = ! piece.succeeded();
+        const juce::String response = isError ? "Error: " + piece.error
+                                              : "Piece generated (" + juce::String(piece.sectionCount) + " sections)";
+
+        // Already playing if its sections streamed into the timeline; a prompt that turned out not to be long-form plays here 
+        if (! processor.getSequenceStatus())
+            processor.playResult(piece);
+
+        if (safeThis != nullptr)
+        {
+            safeThis->stopTimer();
+            safeThis->isLoading = false;
+            safeThis->chatHistory.setVisible(true);
+            safeThis->repaint();
+
+            juce::DynamicObject::Ptr props(new juce::DynamicObject());
+            props->setProperty("latency_ms", (int) std::round(juce::Time::getMillisecondCounterHiRes() - requestStartMs));
+            props->setProperty("result", isError ? "error" : "ok");
+            props->setProperty("section_count", piece.sectionCount);
+            props->setProperty("sections_local", *sectionsFromLocal);
+            props->setProperty("backend", piece.backend);
+            props->setProperty("note_format", piece.compactFormat ? "compact" : "verbose");
+            if (piece.outputTokens > 0)
+                props->setProperty("output_tokens", piece.outputTokens);
+            props->setProperty("repaired", piece.repairs.anyRepairs());
+            if (! isError)
+                props->setProperty("note_count", NoteSpecs::size(piece.notes));
+            safeThis->analytics.trackEvent(isError ? "long_form_failed" : "long_form_completed", juce::var(props.get()));
+        }
+
+        // If the piece failed, the first section already in the chat history stands as the answer
+        if (isError && *sectionEntryIndex >= 0)
+            return;
+
+        ChatEntry entry(piece.prompt, response, processor.createMidiExport(piece.notes), piece.notes);
+        if (*sectionEntryIndex >= 0)
+        {
+            if (safeThis != nullptr)
+                safeThis->chatHistory.replaceChatEntry(*sectionEntryIndex, entry);
+            processor.replaceChatEntry(*sectionEntryIndex, entry);
+            return;
+        }
+
+        if (safeThis != nullptr)
+            safeThis->chatHistory.addChatEntry(entry);
+        processor.addChatEntry(entry);
+    }, forceFresh);
+}
+
+/**
+ * @brief Regenerates one range of the current phrase. The new notes are spliced into the phrase: if it is playing,
+ *        only that range of the playing timeline changes, otherwise the edited phrase starts playing 
+ * @param userInput The range edit as typed, shown in the chat history
+ * @param startBeats Start of the range
+ * @param endBeats End of the range (exclusive)
+ * @param prompt What the range should become
+ */
+void KiwiPluginAudioProcessorEditor::requestRangeRegeneration(const juce::String& userInput, double startBeats, double endBeats, const juce::String& prompt)
+{
+    juce::Component::SafePointer<KiwiPluginAudioProcessorEditor> safeThis(this);
+    const auto requestStartMs = juce::Time::getMillisecondCounterHiRes();
+
+    activeGeneration = audioProcessor.regenerateRange(startBeats, endBeats, prompt,
+        [safeThis, userInput, requestStartMs, &processor = audioProcessor](const GenerationResult& result)
+    {
+        jassert(juce::MessageManager::getInstance()->isThisTheMessageThread());
+
+        const bool isError = ! result.succeeded();
+        const juce::String response = isError ? "Error: " + result.error
+                                              : "Beats " + juce::String(result.rangeStartBeats) + "-" + juce::String(result.rangeEndBeats) + " regenerated";
+        DBG(response);
+
+        // A playing phrase already has the new range swapped in 
+        if (! processor.getSequenceStatus())
+            processor.playResult(result);
+
+        if (safeThis != nullptr)
+        {
+            safeThis->stopTimer();
+            safeThis->isLoading = false;
+            safeThis->chatHistory.setVisible(true);
+            safeThis->repaint();
+
+            juce::DynamicObject::Ptr props(new juce::DynamicObject());
+            props->setProperty("latency_ms", (int) std::round(juce::Time::getMillisecondCounterHiRes() - requestStartMs));
+            props->setProperty("result", isError ? "error" : "ok");
+            props->setProperty("range_beats", result.rangeEndBeats - result.rangeStartBeats);
+            props->setProperty("source", result.fromLocal ? "local" : "remote");
+            props->setProperty("backend", result.backend);
+            if (result.outputTokens > 0)
+                props->setProperty("output_tokens", result.outputTokens);
+            props->setProperty("repaired", result.repairs.anyRepairs());
+            if (! isError)
+                props->setProperty("note_count", NoteSpecs::size(result.notes));
+            safeThis->analytics.trackEvent(isError ? "range_regeneration_failed" : "range_regenerated", juce::var(props.get()));
+        }
+
+        ChatEntry entry(userInput, response, isError ? nullptr : processor.createMidiExport(result.notes), result.notes);
+        if (safeThis != nullptr)
+            safeThis->chatHistory.addChatEntry(entry);
+        processor.addChatEntry(entry);
+    });
+}
+
+/**
+ * @brief Records that the request in flight was abandoned 
+ * @param reason "superseded" when a new prompt replaced it, "escape" when the user cancelled it
+ */
+void KiwiPluginAudioProcessorEditor::trackCancellation(const juce::String& reason)
+{
+    juce::DynamicObject::Ptr props(new juce::DynamicObject());
+    props->setProperty("reason", reason);
+    props->setProperty("request_id", activeGeneration.getRequestId());
+    analytics.trackEvent("generation_cancelled", juce::var(props.get()));
+}
+
 void KiwiPluginAudioProcessorEditor::timerCallback()
 {
     // Rotate kiwi image
@@ -28,11 +28,18 @@ public:
     void timerCallback() override;
 
 private:
+    void requestVariations(const juce::String& prompt, int numVariations, bool forceFresh);
+    void requestLongForm(const juce::String& prompt, bool forceFresh);
+    void requestRangeRegeneration(const juce::String& userInput, double startBeats, double endBeats, const juce::String& prompt);
+    void trackCancellation(const juce::String& reason);
+
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
     KiwiPluginAudioProcessor& audioProcessor;
     juce::TextEditor textEntry;
     juce::TextButton replayButton;
+    juce::ComboBox launchQuantizationBox;
+    juce::ComboBox variationCountBox;
 
     ChatHistoryComponent chatHistory;
 
@@ -42,6 +49,7 @@ private:
     CustomLookAndFeel customLookAndFeel;
 
     AnalyticsService analytics;
+    GenerationHandle activeGeneration; // Request started by the last prompt; cancelled when the next one is sent
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (KiwiPluginAudioProcessorEditor)
 };
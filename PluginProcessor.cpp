@@ -12,7 +12,12 @@
 #include "MidiNote.h"
 #include "Generator.h"
 #include "ChatEntry.h"
+#include "PluginState.h"
 #include "AnalyticsService.h"
+#include "RealtimeGuard.h"
+
+#define MIDI_BUFFER_BYTES_PER_EVENT 16 // Sample position + size header + 3-byte note message, rounded up 
+#define MAX_CONTEXT_NOTES 32 // Notes of each previous generation sent back as context when the compact format is on 
 
 using namespace std; 
 
@@ -29,6 +34,10 @@ KiwiPluginAudioProcessor::KiwiPluginAudioProcessor()
                        )
 #endif
 {
+    // Allow the maximum sequence length to be configured without a rebuild 
+    auto configuredMaxNotes = juce::SystemStats::getEnvironmentVariable("KIWI_MAX_SEQUENCE_NOTES", "").getIntValue();
+    if (configuredMaxNotes > 0)
+        maxSequenceLength = configuredMaxNotes;
 }
 
 KiwiPluginAudioProcessor::~KiwiPluginAudioProcessor()
@@ -110,6 +119,29 @@ void KiwiPluginAudioProcessor::prepareToPlay (double sampleRate, int samplesPerB
     juce::ignoreUnused (samplesPerBlock);
     currentSampleRate = (sampleRate > 0.0 ? sampleRate : 44100.0);
 
+    // Reserve note storage and MIDI output capacity for the largest sequence we will ever play, 
+    // so nothing has to grow once playback is running 
+    sequenceGenerator.prepareToPlay(maxSequenceLength);
+    reservedMidiBytes = (size_t) maxSequenceLength * 2 * MIDI_BUFFER_BYTES_PER_EVENT;
+}
+
+/**
+ * @brief Chooses where newly triggered sequences start relative to the host grid. Applies to the next trigger or replay 
+ * @param newQuantization Start immediately, on the next beat, or on the next bar 
+ */
+void KiwiPluginAudioProcessor::setLaunchQuantization(SequenceScheduler::LaunchQuantization newQuantization)
+{
+    launchQuantization = newQuantization;
+    sequenceGenerator.setLaunchQuantization(newQuantization);
+}
+
+/**
+ * @brief Sets the maximum number of notes a sequence may contain. Takes effect on the next prepareToPlay 
+ * @param maxNotes Maximum notes per sequence 
+ */
+void KiwiPluginAudioProcessor::setMaxSequenceLength(int maxNotes)
+{
+    maxSequenceLength = juce::jmax(1, maxNotes);
 }
 
 void KiwiPluginAudioProcessor::releaseResources()
@@ -145,20 +177,57 @@ bool KiwiPluginAudioProcessor::isBusesLayoutSupported (const BusesLayout& layout
 #endif
 
 /**
- * @brief Method updates output tempo with host tempo
+ * @brief Method updates the host transport snapshot (tempo, ppq position and bar grid) used to schedule this block 
  */
 void KiwiPluginAudioProcessor::configureTempo() {
 
-    // Get current tempo and time signature from host, if available
+    hostPosition.sampleRate = currentSampleRate.load();
+    hostPosition.isPlaying = false;
+    hostPosition.hasPpqPosition = false;
+    hostPosition.hasBarStart = false;
+
+    // Get current tempo, position and time signature from host, if available
     if (auto* playHead = getPlayHead())
     {
-        juce::AudioPlayHead::CurrentPositionInfo posInfo;
-        if (playHead->getCurrentPosition (posInfo))
+        if (auto position = playHead->getPosition())
         {
-            if (posInfo.bpm > 0.0)
-                bpm = posInfo.bpm;
+            if (auto hostBpm = position->getBpm(); hostBpm.hasValue() && *hostBpm > 0.0)
+                bpm = *hostBpm;
+
+            hostPosition.isPlaying = position->getIsPlaying();
+
+            if (auto ppq = position->getPpqPosition())
+            {
+                hostPosition.hasPpqPosition = true;
+                hostPosition.ppqPosition = *ppq;
+            }
+
+            if (auto barStart = position->getPpqPositionOfLastBarStart())
+            {
+                hostPosition.hasBarStart = true;
+                hostPosition.ppqOfLastBarStart = *barStart;
+            }
+
+            if (auto timeSignature = position->getTimeSignature(); timeSignature.hasValue() && timeSignature->denominator > 0)
+                hostPosition.beatsPerBar = timeSignature->numerator * 4.0 / timeSignature->denominator;
         }
     }
+
+    hostPosition.bpm = bpm.load();
+}
+
+/**
+ * @brief Makes a generation result current and hands it to the audio thread for playback. Call on the message thread 
+ * @param result The result to play; failed results are ignored
+ */
+void KiwiPluginAudioProcessor::playResult(const GenerationResult& result)
+{
+    // A streamed response is already playing from its first note, so there is nothing left to start 
+    if (result.streamed || ! result.succeeded())
+        return;
+
+    sequenceGenerator.setCurrentNotes(result.notes);
+    sequenceGenerator.extractSequence(result.requestId);  // Builds the playback timeline from the note model 
 }
 
 bool KiwiPluginAudioProcessor::isGeneratorLoading()
@@ -167,24 +236,57 @@ bool KiwiPluginAudioProcessor::isGeneratorLoading()
 }
 
 
-void KiwiPluginAudioProcessor::sendPromptToGenerator(const juce::String& prompt, const juce::StringArray& recentPrompts,
-                                                     std::function<void(juce::String)> callback)
+GenerationHandle KiwiPluginAudioProcessor::sendPromptToGenerator(const juce::String& prompt, const juce::StringArray& recentPrompts,
+                                                                 Generator::ResultCallback callback, bool forceFresh)
+{
+    return sequenceGenerator.sendToGenerator(prompt, recentPrompts, callback, forceFresh); 
+}
+
+GenerationHandle KiwiPluginAudioProcessor::sendPromptVariationsToGenerator(const juce::String& prompt, const juce::StringArray& recentPrompts, int numVariations,
+                                                                           Generator::ResultCallback callback, bool forceFresh)
+{
+    return sequenceGenerator.sendVariationsToGenerator(prompt, recentPrompts, numVariations, callback, forceFresh);
+}
+
+GenerationHandle KiwiPluginAudioProcessor::sendLongFormPromptToGenerator(const juce::String& prompt, const juce::StringArray& recentPrompts,
+                                                                         Generator::ResultCallback onSection, Generator::ResultCallback onComplete,
+                                                                         bool forceFresh)
+{
+    return sequenceGenerator.sendLongFormToGenerator(prompt, recentPrompts, onSection, onComplete, forceFresh);
+}
+
+GenerationHandle KiwiPluginAudioProcessor::regenerateRange(double startBeats, double endBeats, const juce::String& prompt,
+                                                           Generator::ResultCallback callback)
+{
+    return sequenceGenerator.regenerateRange(sequenceGenerator.getCurrentNotes(), startBeats, endBeats, prompt, callback);
+}
+
+int KiwiPluginAudioProcessor::addChatEntry(const ChatEntry& entry)
+{
+    KIWI_ASSERT_NOT_REALTIME();
+    const juce::ScopedLock lock(chatHistoryLock);
+    chatHistory.append(entry);
+    return chatHistory.size() - 1;
+}
+
+void KiwiPluginAudioProcessor::replaceChatEntry(int entryIndex, const ChatEntry& entry)
 {
-    sequenceGenerator.sendToGenerator(prompt, recentPrompts, callback); 
+    KIWI_ASSERT_NOT_REALTIME();
+    const juce::ScopedLock lock(chatHistoryLock);
+    chatHistory.replace(entryIndex, entry);
 }
 
-void KiwiPluginAudioProcessor::addChatEntry(const ChatEntry& entry)
+int KiwiPluginAudioProcessor::getChatHistorySize() const
 {
     const juce::ScopedLock lock(chatHistoryLock);
-    if (chatHistory.size() >= 10)
-        chatHistory.erase(chatHistory.begin());
-    chatHistory.push_back(entry);
+    return chatHistory.size();
 }
 
-std::vector<ChatEntry> KiwiPluginAudioProcessor::getChatHistory() const
+std::vector<ChatEntry> KiwiPluginAudioProcessor::getChatHistoryPage(int first, int count) const
 {
+    KIWI_ASSERT_NOT_REALTIME();
     const juce::ScopedLock lock(chatHistoryLock);
-    return chatHistory;
+    return chatHistory.getPage(first, count);
 }
 
 juce::StringArray KiwiPluginAudioProcessor::getRecentPromptsForContext(int maxPromptCount) const
@@ -193,15 +295,26 @@ juce::StringArray KiwiPluginAudioProcessor::getRecentPromptsForContext(int maxPr
     if (maxPromptCount <= 0)
         return recentPrompts;
 
+    KIWI_ASSERT_NOT_REALTIME();
+    const bool includeGeneratedNotes = sequenceGenerator.isCompactNoteFormatEnabled();
     const juce::ScopedLock lock(chatHistoryLock);
-    const int historySize = (int) chatHistory.size();
+
+    // Only the last maxPromptCount entries are touched, however long the history is
+    const int historySize = chatHistory.size();
     const int startIndex = juce::jmax(0, historySize - maxPromptCount);
 
     for (int i = startIndex; i < historySize; ++i)
     {
-        const juce::String prompt = chatHistory[(size_t) i].prompt.trim();
-        if (prompt.isNotEmpty())
-            recentPrompts.add(prompt);
+        juce::String prompt = chatHistory.getPrompt(i).trim();
+        if (prompt.isEmpty())
+            continue;
+
+        // With the compact format on, the model also sees what it answered, at a few tokens per note
+        if (includeGeneratedNotes)
+            if (auto notes = chatHistory.getNotes(i); NoteSpecs::size(notes) > 0)
+                prompt << " -> generated [start,dur,pitch,vel]: " << NoteSpecs::toCompactJSON(notes, MAX_CONTEXT_NOTES);
+
+        recentPrompts.add(prompt);
     }
 
     return recentPrompts;
@@ -222,25 +335,25 @@ void KiwiPluginAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, j
         buffer.clear (i, 0, buffer.getNumSamples());
 
     midiMessages.clear(); 
+
+    // The host owns the output buffer, so reserve it here: this only allocates the first time the host hands us a smaller buffer 
+    midiMessages.ensureSize(reservedMidiBytes);
+
+    // From here on nothing may allocate or lock - debug builds assert if it does 
+    const RealtimeGuard::ScopedRealtimeContext realtimeContext;
     
     int blockSize = buffer.getNumSamples(); // Gets the current audio sample block size from the audio buffer
-    this->configureTempo(); // Configures tempo each block so that playback dynamically adapts to host tempo changes 
+    this->configureTempo(); // Reads the host transport each block so that playback follows tempo changes and the host grid 
     
-    // If button was pressed, schedule the sequence to start 
-    if (!sequenceInProgress && shouldGenerateSequence)
-    {
+    // If a sequence was published since the last block, start it - this only swaps a pointer 
+    if (sequenceGenerator.startPublishedSequence(midiMessages))
         sequenceInProgress = true; 
-        shouldGenerateSequence = false; 
-        sequenceGenerator.extractSequence(bpm, currentSampleRate);  // parses API response into usable notes 
-    }
 
     // If a sequence is in progress, process the notes and add MIDI events to the buffer as needed 
     if(sequenceInProgress) { 
-        sequenceGenerator.processSequence(blockSize, midiMessages);
-        if(sequenceGenerator.isSequenceFinished()) {
-            DBG("processBlock: Sequence finished.");
-            sequenceInProgress = false;
-        }
+        sequenceGenerator.processSequence(hostPosition, blockSize, midiMessages);
+        if(sequenceGenerator.isSequenceFinished())
+            sequenceInProgress = false; // No DBG here: building the log string would allocate on the audio thread
     }
 
 }
@@ -249,16 +362,19 @@ void KiwiPluginAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, j
  * @brief Resets the note sequence so that it can be played from the beginning again 
  */
 void KiwiPluginAudioProcessor::replaySequence() {
-        DBG("replaySequence called. noteSequence size: " + juce::String((int)sequenceGenerator.getNoteSequence().size()) + ", sequenceInProgress: " + juce::String(sequenceInProgress ? "true" : "false"));
-        if (!sequenceGenerator.getNoteSequence().empty() && !sequenceInProgress) {
-            sequenceGenerator.resetSequence();
-            shouldGenerateSequence = true;
-            DBG("shouldGenerateSequence set to true");
+        DBG("replaySequence called. note count: " + juce::String(sequenceGenerator.getNoteCount()) + ", sequenceInProgress: " + juce::String(sequenceInProgress ? "true" : "false"));
+        if (sequenceGenerator.getNoteCount() > 0 && !sequenceInProgress) {
+            sequenceGenerator.extractSequence(); // Republishes a fresh timeline that starts from the beginning 
+            DBG("Sequence republished for replay");
         }
 } 
 
-juce::File KiwiPluginAudioProcessor::createMidiFile() {
-        return sequenceGenerator.createMidiFile(bpm);
+MidiExportPtr KiwiPluginAudioProcessor::createMidiExport() {
+        return sequenceGenerator.createMidiExport(bpm.load());
+}
+
+MidiExportPtr KiwiPluginAudioProcessor::createMidiExport(const NoteSpecArray& notes) {
+        return sequenceGenerator.createMidiExport(notes, bpm.load());
 }
 
 
@@ -274,17 +390,67 @@ juce::AudioProcessorEditor* KiwiPluginAudioProcessor::createEditor()
 }
 
 //==============================================================================
+/**
+ * @brief Saves the chat history and the current note model with the project, in the binary PluginState format. The
+ *        history's log already holds PluginState records, so it is copied as it is 
+ * @param destData Block the host stores with the project
+ */
 void KiwiPluginAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
+    // Hosts save from their own threads: the note model is copied under the generator's lock
+    const auto currentNotes = sequenceGenerator.getCurrentNotes();
+    const auto partNames = sequenceGenerator.getPartNames();
+
+    const juce::ScopedLock lock(chatHistoryLock);
+
+    juce::MemoryOutputStream out(destData, false);
+    PluginState::writeHeader(out, currentNotes, partNames, chatHistory.size());
+    chatHistory.writeRecords(out);
 }
 
+/**
+ * @brief Restores a state saved by getStateInformation. The block is read on the calling thread, which may be any
+ *        thread the host loads projects from; the state is applied on the message thread, which owns the note model
+ * @param data The saved block
+ * @param sizeInBytes Size of the block
+ */
 void KiwiPluginAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
+    auto state = std::make_shared<PluginState>();
+    if (sizeInBytes <= 0 || ! state->read(data, (size_t) sizeInBytes))
+    {
+        DBG("Ignoring unreadable plugin state");
+        return;
+    }
+
+    if (juce::MessageManager::getInstance()->isThisTheMessageThread())
+    {
+        applyState(*state);
+        return;
+    }
+
+    juce::WeakReference<KiwiPluginAudioProcessor> processor(this);
+    juce::MessageManager::callAsync([processor, state]()
+    {
+        if (processor != nullptr)
+            processor->applyState(*state);
+    });
+}
+
+/**
+ * @brief Applies a read state. The current note model is decoded straight away so it can be replayed and edited; the
+ *        history's records are copied into its log and only decoded when a page is shown 
+ * @param state A state that read successfully
+ */
+void KiwiPluginAudioProcessor::applyState(const PluginState& state)
+{
+    jassert(juce::MessageManager::getInstance()->isThisTheMessageThread());
+
+    sequenceGenerator.setPartNames(state.getPartNames());
+    sequenceGenerator.setCurrentNotes(state.getCurrentNotes());
+
+    const juce::ScopedLock lock(chatHistoryLock);
+    chatHistory.restore(state);
 }
 
 //==============================================================================
@@ -12,7 +12,10 @@
 #include "MidiNote.h"
 #include "Generator.h"
 #include "ChatEntry.h"
+#include "PluginState.h"
+#include "ChatHistoryStore.h"
 #include "AnalyticsService.h"
+#include "RealtimeGuard.h"
 
 using namespace std; 
 //==============================================================================
@@ -57,45 +60,79 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
-    void triggerNote() {shouldGenerateSequence = true;}
+    void playResult(const GenerationResult& result);
 
     bool getSequenceStatus() {return sequenceInProgress;};
+    void setMaxSequenceLength(int maxNotes);
+    void setLaunchQuantization(SequenceScheduler::LaunchQuantization newQuantization);
+    SequenceScheduler::LaunchQuantization getLaunchQuantization() const { return launchQuantization; }
+    int getMaxSequenceLength() const { return maxSequenceLength; }
     bool isGeneratorLoading();
     void configureTempo();
-    void setSequence();
     
     // Delegate to Generator 
-    void sendPromptToGenerator(const juce::String& prompt,  const juce::StringArray& recentPrompts, std::function<void(juce::String)> callback);
+    GenerationHandle sendPromptToGenerator(const juce::String& prompt,  const juce::StringArray& recentPrompts, Generator::ResultCallback callback, bool forceFresh = false);
+
+    GenerationHandle sendPromptVariationsToGenerator(const juce::String& prompt, const juce::StringArray& recentPrompts, int numVariations,
+                                         Generator::ResultCallback callback, bool forceFresh = false);
+
+    GenerationHandle sendLongFormPromptToGenerator(const juce::String& prompt, const juce::StringArray& recentPrompts,
+                                                   Generator::ResultCallback onSection, Generator::ResultCallback onComplete,
+                                                   bool forceFresh = false);
+    bool isLongFormPrompt(const juce::String& prompt) const { return sequenceGenerator.isLongFormPrompt(prompt); }
+    bool isTransformCommand(const juce::String& prompt) const { return sequenceGenerator.isTransformCommand(prompt); }
+
+    // Regenerate one beat range of the current phrase and splice the new notes in
+    GenerationHandle regenerateRange(double startBeats, double endBeats, const juce::String& prompt, Generator::ResultCallback callback);
+    int getCurrentNoteCount() const { return sequenceGenerator.getNoteCount(); }
 
     void replaySequence();
 
-    juce::File createMidiFile();
+    MidiExportPtr createMidiExport();
+    MidiExportPtr createMidiExport(const NoteSpecArray& notes);
+    int getGenerationWorkerCount() const { return sequenceGenerator.getWorkerCount(); }
+    int getQueuedGenerationCount() const { return sequenceGenerator.getQueuedRequestCount(); }
+    double getGenerationLatencyP95Ms() const { return sequenceGenerator.getLatencyPercentileMs(0.95); }
+    int getHedgedRequestCount() const { return sequenceGenerator.getHedgesLaunched(); }
+    int getHedgeWinCount() const { return sequenceGenerator.getHedgesWon(); }
    
-    int getLastGeneratedNoteCount() const { return sequenceGenerator.getNoteCountFromSequenceJSON(); }
+    int getGenerationCacheHits() const { return sequenceGenerator.getCacheHitCount(); }
+    int getGenerationCacheMisses() const { return sequenceGenerator.getCacheMissCount(); }
+    void setGenerationPolicy(Generator::Policy newPolicy) { sequenceGenerator.setPolicy(newPolicy); }
+    Generator::Policy getGenerationPolicy() const { return sequenceGenerator.getPolicy(); }
 
     // Chat history (persists across editor close/reopen - processor outlives editor)
-    void addChatEntry(const ChatEntry& entry);
-    std::vector<ChatEntry> getChatHistory() const;
+    int addChatEntry(const ChatEntry& entry); // Returns the new entry's index
+    void replaceChatEntry(int entryIndex, const ChatEntry& entry);
+    int getChatHistorySize() const;
+    std::vector<ChatEntry> getChatHistoryPage(int first, int count) const; // Oldest first; 0 is the oldest entry
     juce::StringArray getRecentPromptsForContext(int maxPromptCount) const;
 
 private:
+    void applyState(const PluginState& state);
+
+    std::atomic<double> currentSampleRate { 44100.0 }; // Default sampling rate in Hz of the audio processing environment
 
-    double currentSampleRate = 44100.0; // Default sampling rate in Hz of the audio processing environment
+    // Real-time buffer sizing: everything the audio thread touches is reserved in prepareToPlay from these limits 
+    int maxSequenceLength = 2048;   // Maximum notes per sequence (KIWI_MAX_SEQUENCE_NOTES overrides the default)
+    size_t reservedMidiBytes = 0;   // Output MidiBuffer capacity needed to hold a whole sequence in one block
 
-    // Sequence generation flags 
-    bool shouldGenerateSequence = false;
-    bool sequenceInProgress = false; 
+    // Sequence playback flag, written by the audio thread and read by the editor 
+    std::atomic<bool> sequenceInProgress { false }; 
 
     Generator sequenceGenerator; // Object responsible for communicating with OpenAI API and managing note sequences
 
     // Timing parameters
     double defaultBpm = 140.0;
-    double bpm = defaultBpm;
+    std::atomic<double> bpm { defaultBpm }; // Latest host tempo, read on the message thread for MIDI export
+    SequenceScheduler::HostPosition hostPosition; // Host transport snapshot for the current block (audio thread only)
+    SequenceScheduler::LaunchQuantization launchQuantization = SequenceScheduler::LaunchQuantization::nextBeat;
 
     // Chat history (persists across editor open/close)
-    std::vector<ChatEntry> chatHistory;
+    ChatHistoryStore chatHistory { [this](const NoteSpecArray& notes) { return createMidiExport(notes); } };
     mutable juce::CriticalSection chatHistoryLock;
 
     //==============================================================================
+    JUCE_DECLARE_WEAK_REFERENCEABLE (KiwiPluginAudioProcessor)
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (KiwiPluginAudioProcessor)
 };
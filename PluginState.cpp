@@ -0,0 +1,175 @@
+#include "PluginState.h"
+
+#define STATE_MAGIC 0x3153504b // "KPS1"
+#define STATE_VERSION 1
+#define ENTRY_FLAG_MIDI_FILE 0x01
+#define MIN_RECORD_BYTES 19 // Length, two empty strings, timestamp, flags and a zero note count
+
+// Anonymous namespace: helpers used only within this .cpp file
+namespace
+{
+    /// Reads a note count and skips the packed notes after it
+    /// @return false if the count is negative or the notes run past the end of the stream
+    bool skipNotes(juce::MemoryInputStream& in, int& numNotes, size_t& notesOffset)
+    {
+        numNotes = in.readInt();
+        notesOffset = (size_t) in.getPosition();
+
+        const auto numBytes = (juce::int64) numNotes * NoteSpecs::packedNoteBytes;
+        if (numNotes < 0 || numBytes > in.getNumBytesRemaining())
+            return false;
+
+        return in.setPosition(in.getPosition() + numBytes);
+    }
+}
+
+/**
+ * @brief Encodes the part of the state that comes before the history records
+ * @param out Stream to append the state to
+ * @param currentNotes The note model that plays and exports next
+ * @param partNames Part name of each channel, for naming the tracks of multi-part exports
+ * @param numEntries Number of history records that will follow
+ */
+void PluginState::writeHeader(juce::OutputStream& out,
+                              const NoteSpecArray& currentNotes,
+                              const std::map<int, juce::String>& partNames,
+                              int numEntries)
+{
+    out.writeInt(STATE_MAGIC);
+    out.writeInt(STATE_VERSION);
+
+    out.writeInt(NoteSpecs::size(currentNotes));
+    if (currentNotes != nullptr)
+        NoteSpecs::writePacked(out, *currentNotes);
+
+    out.writeInt((int) partNames.size());
+    for (const auto& [channel, name] : partNames)
+    {
+        out.writeInt(channel);
+        out.writeString(name);
+    }
+
+    out.writeInt(numEntries);
+}
+
+/**
+ * @brief Encodes one chat entry as a record
+ * @param out Stream to append the record to
+ * @param chatEntry The entry; its notes are stored, its MIDI export only as a flag and its MidiFileStore key
+ */
+void PluginState::writeEntry(juce::OutputStream& out, const ChatEntry& chatEntry)
+{
+    // Built separately so its length can go in front of it
+    juce::MemoryOutputStream record;
+    record.writeString(chatEntry.prompt);
+    record.writeString(chatEntry.response);
+    record.writeInt64(chatEntry.timestamp.toMilliseconds());
+    record.writeByte((char) (chatEntry.midiExport != nullptr ? ENTRY_FLAG_MIDI_FILE : 0));
+    record.writeInt(NoteSpecs::size(chatEntry.notes));
+    if (chatEntry.notes != nullptr)
+        NoteSpecs::writePacked(record, *chatEntry.notes);
+    record.writeString(chatEntry.midiExport != nullptr ? chatEntry.midiExport->getKey() : juce::String());
+
+    out.writeInt((int) record.getDataSize());
+    out.write(record.getData(), record.getDataSize());
+}
+
+/**
+ * @brief Indexes one record. Strings and the timestamp are read; notes are only located
+ * @param in Stream positioned at the record's length; left just past the record
+ * @param entry Filled in from the record
+ * @return false if the record is truncated or malformed
+ */
+bool PluginState::readEntry(juce::MemoryInputStream& in, Entry& entry)
+{
+    const int entryBytes = in.readInt();
+    const auto entryStart = in.getPosition();
+    if (entryBytes < 0 || entryBytes > in.getNumBytesRemaining())
+        return false;
+
+    entry.prompt = in.readString();
+    entry.response = in.readString();
+    entry.timestamp = juce::Time(in.readInt64());
+    entry.hasMidiFile = (in.readByte() & ENTRY_FLAG_MIDI_FILE) != 0;
+
+    size_t notesOffset = 0;
+    if (! skipNotes(in, entry.numNotes, notesOffset) || in.getPosition() > entryStart + entryBytes)
+        return false;
+
+    // Added after the notes, so records written without it still read
+    entry.midiKey = in.getPosition() < entryStart + entryBytes ? in.readString() : juce::String();
+    if (in.getPosition() > entryStart + entryBytes)
+        return false;
+
+    entry.recordOffset = (size_t) entryStart;
+    entry.recordBytes = (size_t) entryBytes;
+    entry.notesOffset = notesOffset - (size_t) entryStart;
+
+    // Fields a later version added after the notes are skipped
+    return in.setPosition(entryStart + entryBytes);
+}
+
+/**
+ * @brief Indexes a saved state. Strings and timestamps are read now; notes are only located
+ * @param savedData The block written by writeHeader() and writeEntry()
+ * @param numBytes Size of the block
+ * @return false if the block is empty, foreign, truncated or from a newer format version
+ */
+bool PluginState::read(const void* savedData, size_t numBytes)
+{
+    data.replaceAll(savedData, numBytes);
+    entries.clear();
+    partNames.clear();
+
+    juce::MemoryInputStream in(data, false);
+    if (in.getNumBytesRemaining() < 8 || in.readInt() != STATE_MAGIC)
+        return false;
+
+    const int version = in.readInt();
+    if (version < 1 || version > STATE_VERSION)
+    {
+        DBG("Unsupported plugin state version: " + juce::String(version));
+        return false;
+    }
+
+    if (! skipNotes(in, numCurrentNotes, currentNotesOffset))
+        return false;
+
+    const int numParts = in.readInt();
+    for (int i = 0; i < numParts && ! in.isExhausted(); ++i)
+    {
+        const int channel = in.readInt();
+        partNames[channel] = in.readString();
+    }
+
+    // The count comes from the block, so it is checked against what the block can hold before anything is reserved
+    const int numEntries = in.readInt();
+    if (numEntries < 0 || (juce::int64) numEntries * MIN_RECORD_BYTES > in.getNumBytesRemaining())
+        return false;
+
+    recordsStart = (size_t) in.getPosition();
+    entries.reserve((size_t) numEntries);
+
+    for (int i = 0; i < numEntries; ++i)
+    {
+        Entry entry;
+        if (! readEntry(in, entry))
+            return false;
+
+        entries.push_back(std::move(entry));
+    }
+
+    recordsEnd = (size_t) in.getPosition();
+    return true;
+}
+
+NoteSpecArray PluginState::getCurrentNotes() const
+{
+    if (numCurrentNotes <= 0)
+        return nullptr;
+
+    // read() checked that the notes lie inside the block
+    juce::MemoryInputStream in(static_cast<const char*>(data.getData()) + currentNotesOffset,
+                               (size_t) numCurrentNotes * NoteSpecs::packedNoteBytes, false);
+    return NoteSpecs::fromVector(NoteSpecs::readPacked(in, numCurrentNotes));
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "NoteSpec.h"
+#include "ChatEntry.h"
+
+/**
+ * PluginState - Versioned binary form of what a project saves with the plugin: the chat history and the current note
+ * model, so reopening a project brings back every generated sequence without asking the API again.
+ *
+ * Layout (little-endian): magic "KPS1", format version, current notes, part names, then the history entries as
+ * records. Each record starts with its own byte length, so a reader skips fields added by later versions, and stores
+ * its prompt, response, timestamp, note model in the packed NoteSpecs form and the key of its MIDI file; raw API JSON
+ * is never saved. The same records make up ChatHistoryStore's log, so history moves between the two as raw bytes.
+ * Reading only walks the record headers: notes stay encoded until an entry is decoded, so a long history costs little
+ * at project load.
+ */
+class PluginState
+{
+public:
+    /// One history record, with its notes still encoded
+    struct Entry
+    {
+        juce::String prompt;
+        juce::String response;
+        juce::Time timestamp;
+        bool hasMidiFile = false;
+        juce::String midiKey;    // MidiFileStore key of the entry's export; empty if none, or if saved without one
+        int numNotes = 0;
+        size_t recordOffset = 0; // Where the record (after its length) starts in the block it was read from
+        size_t recordBytes = 0;
+        size_t notesOffset = 0;  // Where the packed notes start, from the start of the record
+    };
+
+    /// Encode everything that comes before the history records
+    static void writeHeader(juce::OutputStream& out,
+                            const NoteSpecArray& currentNotes,
+                            const std::map<int, juce::String>& partNames,
+                            int numEntries);
+
+    /// Encode one history entry as a length-prefixed record
+    static void writeEntry(juce::OutputStream& out, const ChatEntry& entry);
+
+    /// Read the length-prefixed record at the stream's position and move past it, without decoding its notes
+    /// @return false if the record is truncated or malformed
+    static bool readEntry(juce::MemoryInputStream& in, Entry& entry);
+
+    /// Take a copy of a saved block and index its records, without decoding any notes
+    /// @return false if the block is not a state this version can read
+    bool read(const void* data, size_t numBytes);
+
+    const std::vector<Entry>& getEntries() const { return entries; }
+    const std::map<int, juce::String>& getPartNames() const { return partNames; }
+    const juce::MemoryBlock& getData() const { return data; }
+
+    /// The part of the block that holds the history records, back to back
+    size_t getRecordsStart() const { return recordsStart; }
+    size_t getRecordsEnd() const { return recordsEnd; }
+
+    /// Decode the current note model
+    NoteSpecArray getCurrentNotes() const;
+
+private:
+    juce::MemoryBlock data;
+    std::vector<Entry> entries;
+    std::map<int, juce::String> partNames;
+    size_t currentNotesOffset = 0;
+    int numCurrentNotes = 0;
+    size_t recordsStart = 0;
+    size_t recordsEnd = 0;
+};
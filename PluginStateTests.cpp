@@ -0,0 +1,150 @@
+#include "PluginState.h"
+
+/**
+ * PluginStateTests - juce::UnitTest coverage of reading saved plugin states. Registered in the "Kiwi" category; run
+ * with juce::UnitTestRunner().runTestsInCategory("Kiwi").
+ *
+ * PluginStateBenchmark times saving and restoring a history of hundreds of entries. It is registered in the
+ * "Kiwi Benchmarks" category so the regular tests stay fast; run it with
+ * juce::UnitTestRunner().runTestsInCategory("Kiwi Benchmarks") and read the timings from the log.
+ */
+namespace PluginStateTestData
+{
+    /// A history entry with numNotes notes, as a generation would leave it
+    inline ChatEntry makeEntry(int index, int numNotes)
+    {
+        std::vector<NoteSpec> notes;
+        notes.reserve((size_t) numNotes);
+        for (int i = 0; i < numNotes; ++i)
+            notes.push_back(NoteSpecs::make(i * 0.5, 0.5, 48 + (index + i) % 36, 64 + i % 64));
+
+        return ChatEntry("prompt " + juce::String(index), "Generated " + juce::String(numNotes) + " notes",
+                         nullptr, NoteSpecs::fromVector(std::move(notes)));
+    }
+
+    /// Encodes a whole state the way getStateInformation does
+    inline juce::MemoryBlock save(const NoteSpecArray& currentNotes, const std::vector<ChatEntry>& history)
+    {
+        juce::MemoryOutputStream out;
+        PluginState::writeHeader(out, currentNotes, { { 10, "drums" } }, (int) history.size());
+        for (const auto& entry : history)
+            PluginState::writeEntry(out, entry);
+
+        return out.getMemoryBlock();
+    }
+
+    /// Decodes the notes of one indexed entry, as the history does when an entry is shown or exported
+    inline std::vector<NoteSpec> decodeNotes(const PluginState& state, const PluginState::Entry& entry)
+    {
+        juce::MemoryInputStream in(static_cast<const char*>(state.getData().getData()) + entry.recordOffset + entry.notesOffset,
+                                   (size_t) entry.numNotes * NoteSpecs::packedNoteBytes, false);
+        return NoteSpecs::readPacked(in, entry.numNotes);
+    }
+}
+
+class PluginStateTests : public juce::UnitTest
+{
+public:
+    PluginStateTests() : juce::UnitTest("PluginState", "Kiwi") {}
+
+    void runTest() override
+    {
+        using namespace PluginStateTestData;
+
+        beginTest("A saved state reads back with every entry and its notes");
+        {
+            const std::vector<ChatEntry> history { makeEntry(0, 3), makeEntry(1, 0), makeEntry(2, 17) };
+            const auto block = save(history[2].notes, history);
+
+            PluginState state;
+            expect(state.read(block.getData(), block.getSize()));
+            expectEquals((int) state.getEntries().size(), 3);
+            expectEquals(NoteSpecs::size(state.getCurrentNotes()), 17);
+            expectEquals(state.getPartNames().at(10), juce::String("drums"));
+
+            for (size_t i = 0; i < history.size(); ++i)
+            {
+                const auto& entry = state.getEntries()[i];
+                expectEquals(entry.prompt, history[i].prompt);
+                expectEquals(entry.numNotes, NoteSpecs::size(history[i].notes));
+
+                const auto notes = decodeNotes(state, entry);
+                for (size_t n = 0; n < notes.size(); ++n)
+                    expectEquals((int) notes[n].pitch, (int) (*history[i].notes)[n].pitch);
+            }
+        }
+
+        beginTest("An entry count the block cannot hold is rejected before anything is reserved");
+        {
+            const auto block = save(nullptr, { makeEntry(0, 4) });
+
+            // Overwrite the entry count, the last int of the header, with one no block of this size could hold
+            juce::MemoryOutputStream header;
+            PluginState::writeHeader(header, nullptr, { { 10, "drums" } }, 1);
+            juce::MemoryBlock corrupted(block);
+            const int hugeCount = std::numeric_limits<int>::max();
+            corrupted.copyFrom(&hugeCount, (int) header.getDataSize() - (int) sizeof(int), sizeof(int));
+
+            PluginState state;
+            expect(! state.read(corrupted.getData(), corrupted.getSize()));
+            expect(state.getEntries().empty());
+        }
+
+        beginTest("A truncated state is rejected");
+        {
+            const auto block = save(nullptr, { makeEntry(0, 4), makeEntry(1, 4) });
+
+            PluginState state;
+            expect(! state.read(block.getData(), block.getSize() - 5));
+        }
+    }
+};
+
+class PluginStateBenchmark : public juce::UnitTest
+{
+public:
+    PluginStateBenchmark() : juce::UnitTest("PluginState save/restore", "Kiwi Benchmarks") {}
+
+    void runTest() override
+    {
+        using namespace PluginStateTestData;
+
+        for (int numEntries : { 100, 500, 1000 })
+        {
+            beginTest(juce::String(numEntries) + " entries of 64 notes");
+
+            std::vector<ChatEntry> history;
+            history.reserve((size_t) numEntries);
+            for (int i = 0; i < numEntries; ++i)
+                history.push_back(makeEntry(i, 64));
+
+            auto startMs = juce::Time::getMillisecondCounterHiRes();
+            const auto block = save(history.back().notes, history);
+            const auto saveMs = juce::Time::getMillisecondCounterHiRes() - startMs;
+
+            // Restoring only indexes the records; notes are decoded when an entry is used
+            PluginState state;
+            startMs = juce::Time::getMillisecondCounterHiRes();
+            const bool restored = state.read(block.getData(), block.getSize());
+            const auto restoreMs = juce::Time::getMillisecondCounterHiRes() - startMs;
+
+            // For comparison: decoding every entry's notes, as an eager format would at project load
+            size_t numDecoded = 0;
+            startMs = juce::Time::getMillisecondCounterHiRes();
+            for (const auto& entry : state.getEntries())
+                numDecoded += decodeNotes(state, entry).size();
+            const auto decodeAllMs = juce::Time::getMillisecondCounterHiRes() - startMs;
+
+            expect(restored);
+            expectEquals((int) state.getEntries().size(), numEntries);
+            expectEquals((int) numDecoded, numEntries * 64);
+
+            logMessage(juce::String(numEntries) + " entries, " + juce::String((int) block.getSize() / 1024) + " KB: save "
+                       + juce::String(saveMs, 2) + " ms, restore " + juce::String(restoreMs, 2) + " ms, decoding every entry "
+                       + juce::String(decodeAllMs, 2) + " ms");
+        }
+    }
+};
+
+static PluginStateTests pluginStateTests;
+static PluginStateBenchmark pluginStateBenchmark;
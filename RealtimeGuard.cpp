@@ -0,0 +1,112 @@
+#include "RealtimeGuard.h"
+#include <cstdlib>
+#include <new>
+
+// Anonymous namespace: per-thread guard state used only within this .cpp file 
+namespace
+{
+   #if KIWI_REALTIME_GUARD
+    thread_local int realtimeDepth = 0; // Number of nested ScopedRealtimeContexts on this thread
+    thread_local juce::int64 numAllocations = 0; // Allocations made by this thread, read by ScopedAllocationCounter
+
+    /// Assert if the calling thread is inside a real-time context. The guard is disarmed while the assertion is
+    /// reported so that the allocations made by JUCE's assertion logging don't recurse back into here
+    void checkHeapAccessAllowed() noexcept
+    {
+        if (realtimeDepth > 0)
+        {
+            const auto depth = realtimeDepth;
+            realtimeDepth = 0;
+            jassertfalse; // Heap allocation or deallocation on the audio thread
+            realtimeDepth = depth;
+        }
+    }
+
+    void freeChecked(void* ptr) noexcept
+    {
+        if (ptr != nullptr)
+            checkHeapAccessAllowed();
+
+        std::free(ptr);
+    }
+
+    void* allocateChecked(std::size_t size)
+    {
+        checkHeapAccessAllowed();
+        ++numAllocations;
+
+        if (auto* ptr = std::malloc(size > 0 ? size : 1))
+            return ptr;
+
+        throw std::bad_alloc();
+    }
+   #endif
+}
+
+bool RealtimeGuard::isRealtimeContext() noexcept
+{
+   #if KIWI_REALTIME_GUARD
+    return realtimeDepth > 0;
+   #else
+    return false;
+   #endif
+}
+
+RealtimeGuard::ScopedRealtimeContext::ScopedRealtimeContext() noexcept
+{
+   #if KIWI_REALTIME_GUARD
+    ++realtimeDepth;
+   #endif
+}
+
+RealtimeGuard::ScopedRealtimeContext::~ScopedRealtimeContext() noexcept
+{
+   #if KIWI_REALTIME_GUARD
+    --realtimeDepth;
+   #endif
+}
+
+bool RealtimeGuard::canCountAllocations() noexcept
+{
+    return KIWI_REALTIME_GUARD != 0;
+}
+
+RealtimeGuard::ScopedAllocationCounter::ScopedAllocationCounter() noexcept
+{
+   #if KIWI_REALTIME_GUARD
+    startCount = numAllocations;
+   #endif
+}
+
+int RealtimeGuard::ScopedAllocationCounter::getNumAllocations() const noexcept
+{
+   #if KIWI_REALTIME_GUARD
+    return (int) (numAllocations - startCount);
+   #else
+    return 0;
+   #endif
+}
+
+#if KIWI_REALTIME_GUARD
+// Replacement global allocation functions so any allocation or free inside a ScopedRealtimeContext is caught in debug builds
+void* operator new(std::size_t size)                           { return allocateChecked(size); }
+void* operator new[](std::size_t size)                         { return allocateChecked(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    checkHeapAccessAllowed();
+    ++numAllocations;
+    return std::malloc(size > 0 ? size : 1);
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    checkHeapAccessAllowed();
+    ++numAllocations;
+    return std::malloc(size > 0 ? size : 1);
+}
+void operator delete(void* ptr) noexcept                       { freeChecked(ptr); }
+void operator delete[](void* ptr) noexcept                     { freeChecked(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept          { freeChecked(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept        { freeChecked(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept   { freeChecked(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { freeChecked(ptr); }
+#endif
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Debug-only detection of allocations and locks on the audio thread. Enabled by default in debug builds;
+// define KIWI_REALTIME_GUARD=0 to turn it off (e.g. when running under a host that allocates inside our callback).
+#ifndef KIWI_REALTIME_GUARD
+ #define KIWI_REALTIME_GUARD JUCE_DEBUG
+#endif
+
+/**
+ * RealtimeGuard - Marks code that must stay real-time safe.
+ *
+ * While a ScopedRealtimeContext is alive on a thread, any heap allocation made by that thread hits an assertion
+ * (via the replaced global operator new), as does any lock taken through KIWI_ASSERT_NOT_REALTIME-guarded code.
+ * The same replacement counts each thread's allocations, for benchmarks that compare how much code allocates.
+ * In release builds everything here compiles to nothing.
+ */
+namespace RealtimeGuard
+{
+    /// True if the calling thread is currently inside a ScopedRealtimeContext
+    bool isRealtimeContext() noexcept;
+
+    class ScopedRealtimeContext
+    {
+    public:
+        ScopedRealtimeContext() noexcept;
+        ~ScopedRealtimeContext() noexcept;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedRealtimeContext)
+    };
+
+    /// True if allocations can be counted, i.e. the guard's operator new is compiled in
+    bool canCountAllocations() noexcept;
+
+    /// Counts the heap allocations the calling thread makes while it is alive. Always 0 if canCountAllocations() is false
+    class ScopedAllocationCounter
+    {
+    public:
+        ScopedAllocationCounter() noexcept;
+        int getNumAllocations() const noexcept;
+
+    private:
+        juce::int64 startCount = 0;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedAllocationCounter)
+    };
+}
+
+/// Place before taking a lock (or doing anything else that may block) to catch it being reached from the audio thread
+#if KIWI_REALTIME_GUARD
+ #define KIWI_ASSERT_NOT_REALTIME() jassert(! RealtimeGuard::isRealtimeContext())
+#else
+ #define KIWI_ASSERT_NOT_REALTIME()
+#endif
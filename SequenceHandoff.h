@@ -0,0 +1,95 @@
+#pragma once
+#include <JuceHeader.h>
+
+/**
+ * SequenceHandoff - Lock-free single-producer/single-consumer slot for publishing prepared sequences to the audio thread.
+ *
+ * The message thread builds a payload off the audio thread and publish()es it. The audio thread calls acquire() at the
+ * top of each block, which only swaps pointers: the published payload becomes active and the previously active one is
+ * pushed onto a lock-free retire list. Retired payloads are deleted by the producer on its next publish()/collectGarbage(),
+ * so the audio thread never allocates or frees memory.
+ */
+template <typename Payload>
+class SequenceHandoff
+{
+public:
+    SequenceHandoff() = default;
+
+    ~SequenceHandoff()
+    {
+        delete pending.exchange(nullptr);
+        delete active;
+        collectGarbage();
+    }
+
+    //==============================================================================
+    // Producer side (message thread)
+
+    /// Makes a payload available to the audio thread, replacing any payload it has not picked up yet
+    void publish(std::unique_ptr<Payload> payload)
+    {
+        collectGarbage();
+
+        auto* node = new Node { std::move(payload), nullptr };
+        delete pending.exchange(node, std::memory_order_acq_rel); // Unclaimed payloads are superseded
+    }
+
+    /// Frees payloads the audio thread has finished with
+    void collectGarbage()
+    {
+        auto* node = retiredHead.exchange(nullptr, std::memory_order_acquire);
+        while (node != nullptr)
+        {
+            auto* next = node->nextRetired;
+            delete node;
+            node = next;
+        }
+    }
+
+    //==============================================================================
+    // Consumer side (audio thread)
+
+    /// Swaps in the most recently published payload, if any. Wait-free apart from the retire push, never allocates
+    /// @return The newly activated payload, or nullptr if nothing new was published since the last call
+    Payload* acquire() noexcept
+    {
+        auto* next = pending.exchange(nullptr, std::memory_order_acq_rel);
+        if (next == nullptr)
+            return nullptr;
+
+        if (active != nullptr)
+            retire(active);
+
+        active = next;
+        return active->payload.get();
+    }
+
+    /// True if a payload is waiting to be acquired. Lets the consumer finish with its active payload before swapping
+    bool hasPending() const noexcept { return pending.load(std::memory_order_acquire) != nullptr; }
+
+    /// The payload currently owned by the audio thread, or nullptr if nothing has been published yet
+    Payload* getActive() const noexcept { return active != nullptr ? active->payload.get() : nullptr; }
+
+private:
+    struct Node
+    {
+        std::unique_ptr<Payload> payload;
+        Node* nextRetired;
+    };
+
+    void retire(Node* node) noexcept
+    {
+        node->nextRetired = retiredHead.load(std::memory_order_relaxed);
+        while (! retiredHead.compare_exchange_weak(node->nextRetired, node,
+                                                   std::memory_order_release,
+                                                   std::memory_order_relaxed))
+        {
+        }
+    }
+
+    std::atomic<Node*> pending { nullptr };     // Published by the producer, claimed by the consumer
+    std::atomic<Node*> retiredHead { nullptr }; // Lock-free stack of payloads waiting to be freed by the producer
+    Node* active = nullptr;                     // Owned exclusively by the consumer
+
+    JUCE_DECLARE_NON_COPYABLE(SequenceHandoff)
+};
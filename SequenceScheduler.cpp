@@ -0,0 +1,245 @@
+#include "SequenceScheduler.h"
+
+/**
+ * @brief Flattens the notes into a sorted timeline of note-on/note-off events and rewinds the playhead
+ * @param notes The note sequence to schedule, with on/off positions in beats relative to the start of the sequence
+ */
+void SequenceScheduler::loadSequence(const std::vector<MidiNote>& notes)
+{
+    events.clear();
+    events.reserve(notes.size() * 2);
+    removedNoteIds.reserve(notes.size());
+    nextNoteId = 0;
+
+    for (const auto& note : notes)
+    {
+        events.push_back({ note.getOnBeats(), note.getNoteEvent(), true, nextNoteId });
+        events.push_back({ note.getOffBeats(), note.getNoteEvent(), false, nextNoteId });
+        ++nextNoteId;
+    }
+
+    std::sort(events.begin(), events.end(), isEarlier);
+
+    reset();
+}
+
+/**
+ * @brief Reserves room for maxNotes notes, so inserting and removing notes on the audio thread never allocates
+ * @param maxNotes The most notes the timeline will hold at once
+ */
+void SequenceScheduler::reserve(int maxNotes)
+{
+    events.reserve((size_t) maxNotes * 2);
+    removedNoteIds.reserve((size_t) maxNotes);
+}
+
+/**
+ * @brief Timeline ordering. Note-offs sort ahead of note-ons at the same position so repeated pitches retrigger instead of being cut short
+ */
+bool SequenceScheduler::isEarlier(const ScheduledEvent& a, const ScheduledEvent& b)
+{
+    if (a.beatPosition != b.beatPosition)
+        return a.beatPosition < b.beatPosition;
+    return ! a.isNoteOn && b.isNoteOn;
+}
+
+/**
+ * @brief Inserts a note into the sorted timeline without reallocating. Called on the audio thread while notes stream in 
+ * @param note The note to insert, positioned in beats from the start of the sequence
+ * @param playIfLate Whether a note whose start has passed plays at the playhead (true) or is dropped (false)
+ * @return true if the note was inserted or dropped as late, false if the reserved capacity is full
+ */
+bool SequenceScheduler::insertNote(const MidiNote& note, bool playIfLate)
+{
+    if (events.size() + 2 > events.capacity())
+        return false;
+
+    double onBeats = note.getOnBeats();
+    double offBeats = note.getOffBeats();
+
+    // A note that arrives after its start time has passed plays as soon as possible, keeping its length, unless it
+    // is part of an edit of a range that has already played
+    const double earliestBeats = launched ? playheadBeats : 0.0;
+    if (onBeats < earliestBeats && ! playIfLate)
+        return true;
+
+    if (onBeats < earliestBeats)
+    {
+        offBeats += earliestBeats - onBeats;
+        onBeats = earliestBeats;
+    }
+
+    const ScheduledEvent noteOn { onBeats, note.getNoteEvent(), true, nextNoteId };
+    const ScheduledEvent noteOff { offBeats, note.getNoteEvent(), false, nextNoteId };
+    ++nextNoteId;
+
+    // Only the unplayed part of the timeline (from the cursor on) may change
+    auto insertSorted = [this](const ScheduledEvent& event)
+    {
+        auto position = std::upper_bound(events.begin() + (std::ptrdiff_t) cursor, events.end(), event, isEarlier);
+        events.insert(position, event);
+    };
+
+    insertSorted(noteOn);
+    insertSorted(noteOff);
+    return true;
+}
+
+/**
+ * @brief Removes unplayed notes from the timeline in place. Called on the audio thread when part of the sequence is
+ *        regenerated; shrinking the vector never reallocates 
+ * @param startBeats Start of the range whose notes are removed
+ * @param endBeats End of the range (exclusive)
+ */
+void SequenceScheduler::removeNotes(double startBeats, double endBeats)
+{
+    // Collect the ids of the unplayed notes in the range. A note's note-off always follows its note-on, so every
+    // note-off to remove is after the cursor too
+    removedNoteIds.clear();
+    for (size_t i = cursor; i < events.size() && removedNoteIds.size() < removedNoteIds.capacity(); ++i)
+    {
+        const auto& event = events[i];
+        if (event.isNoteOn && event.beatPosition >= startBeats && event.beatPosition < endBeats)
+            removedNoteIds.push_back(event.noteId);
+    }
+
+    if (removedNoteIds.empty())
+        return;
+
+    std::sort(removedNoteIds.begin(), removedNoteIds.end());
+
+    // Each removed note-on takes its own note-off with it, whatever other notes share its pitch
+    size_t write = cursor;
+    for (size_t read = cursor; read < events.size(); ++read)
+    {
+        if (std::binary_search(removedNoteIds.begin(), removedNoteIds.end(), events[read].noteId))
+            continue;
+
+        events[write++] = events[read];
+    }
+
+    events.erase(events.begin() + (std::ptrdiff_t) write, events.end());
+}
+
+/**
+ * @brief Adds a single event to the MIDI buffer and keeps track of which notes are currently sounding 
+ */
+void SequenceScheduler::emit(const ScheduledEvent& event, int sampleOffset, juce::MidiBuffer& midiMessages)
+{
+    const int channelIndex = juce::jlimit(1, 16, event.note.midiChannel) - 1;
+    auto& soundingCount = soundingNotes[(size_t) (channelIndex * 128 + (event.note.note & 127))];
+
+    if (event.isNoteOn)
+    {
+        midiMessages.addEvent(juce::MidiMessage::noteOn(event.note.midiChannel, event.note.note, event.note.velocity), sampleOffset);
+        ++soundingCount;
+    }
+    else
+    {
+        midiMessages.addEvent(juce::MidiMessage::noteOff(event.note.midiChannel, event.note.note), sampleOffset);
+        if (soundingCount > 0)
+            --soundingCount;
+    }
+}
+
+/**
+ * @brief Ends every note that is still sounding at the start of the block 
+ * @param midiMessages The MIDI buffer to which the note-off events should be added
+ */
+void SequenceScheduler::releaseSoundingNotes(juce::MidiBuffer& midiMessages)
+{
+    for (size_t i = 0; i < soundingNotes.size(); ++i)
+    {
+        if (soundingNotes[i] == 0)
+            continue;
+
+        midiMessages.addEvent(juce::MidiMessage::noteOff((int) (i / 128) + 1, (int) (i % 128)), 0);
+        soundingNotes[i] = 0;
+    }
+}
+
+/**
+ * @brief Resolves where beat 0 of the sequence falls on the host timeline, based on the launch quantization
+ * @param position The host transport at the start of the first block
+ */
+void SequenceScheduler::launch(const HostPosition& position)
+{
+    launched = true;
+    playheadBeats = 0.0;
+
+    // Without a running transport there is no grid to line up with, so start straight away
+    if (! position.isPlaying || ! position.hasPpqPosition || launchQuantization == LaunchQuantization::immediate)
+    {
+        anchorPpq = position.ppqPosition;
+        return;
+    }
+
+    double gridOrigin = 0.0;
+    double gridLength = 1.0;
+
+    if (launchQuantization == LaunchQuantization::nextBar)
+    {
+        gridOrigin = position.hasBarStart ? position.ppqOfLastBarStart : 0.0;
+        gridLength = juce::jmax(0.25, position.beatsPerBar);
+    }
+
+    // Round up to the next grid line; a launch that is already on a grid line (within rounding error) starts now
+    const double gridsElapsed = (position.ppqPosition - gridOrigin) / gridLength;
+    const double nextGrid = std::ceil(gridsElapsed - 1.0e-6);
+    anchorPpq = gridOrigin + nextGrid * gridLength;
+    playheadBeats = position.ppqPosition - anchorPpq; // Zero or negative: counts up to the launch point
+}
+
+/**
+ * @brief Adds every event that falls inside the current block to the MIDI buffer, then advances the playhead by one block
+ * @param position The host transport for this block, used for tempo and grid alignment
+ * @param blockSize The size of the current audio processing block in samples
+ * @param midiMessages The MIDI buffer to which the note-on and note-off events should be added when triggered
+ */
+void SequenceScheduler::processBlock(const HostPosition& position, int blockSize, juce::MidiBuffer& midiMessages)
+{
+    if (blockSize <= 0 || position.bpm <= 0.0 || position.sampleRate <= 0.0)
+        return;
+
+    if (! launched)
+        launch(position);
+    else if (position.isPlaying && position.hasPpqPosition)
+    {
+        // Follow the host transport while it runs forward. If it jumps backwards (loop, relocate) keep our own
+        // position and re-anchor instead, so notes are never replayed or skipped
+        const double hostBeats = position.ppqPosition - anchorPpq;
+        if (hostBeats >= playheadBeats)
+            playheadBeats = hostBeats;
+        else
+            anchorPpq = position.ppqPosition - playheadBeats;
+    }
+
+    // Beat-to-sample conversion for this block only, using this block's tempo
+    const double samplesPerBeat = position.sampleRate * 60.0 / position.bpm;
+    const double blockEndBeats = playheadBeats + blockSize / samplesPerBeat;
+
+    // Only the events inside [playheadBeats, blockEndBeats) are visited - everything else stays untouched
+    while (cursor < events.size() && events[cursor].beatPosition < blockEndBeats)
+    {
+        const auto& event = events[cursor];
+        const int sampleOffset = juce::jlimit(0, blockSize - 1,
+                                              (int) std::floor((event.beatPosition - playheadBeats) * samplesPerBeat));
+
+        emit(event, sampleOffset, midiMessages);
+        ++cursor;
+    }
+
+    playheadBeats = blockEndBeats;
+}
+
+/**
+ * @brief Rewinds the cursor and playhead so the whole timeline can be replayed, relaunching on the next block
+ */
+void SequenceScheduler::reset()
+{
+    cursor = 0;
+    soundingNotes.fill(0);
+    launched = false;
+    playheadBeats = 0.0;
+    anchorPpq = 0.0;
+}
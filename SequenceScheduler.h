@@ -0,0 +1,101 @@
+#pragma once
+#include <JuceHeader.h>
+#include "MidiNote.h"
+
+/**
+ * SequenceScheduler - Sample-accurate, tempo-following playback of a note sequence.
+ *
+ * Flattens the sequence into one sorted, contiguous timeline of note-on/note-off events positioned in beats and walks it
+ * with a read cursor, so each audio block only costs the events that actually fall inside it. Beats are converted to
+ * sample offsets one block at a time using that block's tempo, so host tempo changes mid-phrase never cause drift.
+ * The sequence is finished once the cursor has passed the last event.
+ */
+class SequenceScheduler
+{
+public:
+    /// Where playback of a newly started sequence lines up with the host's grid
+    enum class LaunchQuantization
+    {
+        immediate, // Start on the first block
+        nextBeat,  // Start on the next beat boundary of the host transport
+        nextBar    // Start on the next bar line of the host transport
+    };
+
+    /// Snapshot of the host transport for one audio block
+    struct HostPosition
+    {
+        double bpm = 120.0;
+        double sampleRate = 44100.0;
+        bool isPlaying = false;
+        bool hasPpqPosition = false;
+        double ppqPosition = 0.0;        // Host position in quarter notes at the start of the block
+        bool hasBarStart = false;
+        double ppqOfLastBarStart = 0.0;  // Host position of the most recent bar line
+        double beatsPerBar = 4.0;        // Bar length in quarter notes
+    };
+
+    struct ScheduledEvent
+    {
+        double beatPosition; // Beats from the start of the sequence
+        MidiNoteEvent note;
+        bool isNoteOn;
+        juce::uint32 noteId; // Shared by a note's note-on and note-off, so each can be found from the other
+    };
+
+    /// Rebuild the event timeline from a note sequence and rewind to the start
+    void loadSequence(const std::vector<MidiNote>& notes);
+
+    /// Reserve timeline capacity so that notes inserted while streaming never allocate on the audio thread
+    void reserve(int maxNotes);
+
+    /// Keep the sequence open for notes that are still streaming in, until endStream() is called
+    void beginStream() { awaitingStreamedNotes = true; }
+    void endStream() { awaitingStreamedNotes = false; }
+
+    /// Insert a note into the timeline while it is playing. A streamed note whose start has already passed is shifted
+    /// to the playhead; with playIfLate false (e.g. a regenerated range) it is dropped instead, since moving a whole
+    /// range to the playhead would sound it as one chord. Never allocates: returns false if the reserved capacity is
+    /// exhausted
+    bool insertNote(const MidiNote& note, bool playIfLate = true);
+
+    /// Remove the notes that start in [startBeats, endBeats) and have not been played yet, e.g. before the range is
+    /// replaced. Each takes its own note-off with it, so overlapping notes of the same pitch keep theirs. Notes already
+    /// sounding are left to finish. Never allocates
+    void removeNotes(double startBeats, double endBeats);
+
+    /// Identifies which published sequence this timeline belongs to, so streamed notes reach the right one
+    void setSequenceId(int newId) { sequenceId = newId; }
+    int getSequenceId() const { return sequenceId; }
+
+    void setLaunchQuantization(LaunchQuantization newQuantization) { launchQuantization = newQuantization; }
+
+    /// Emit every event that falls inside the next blockSize samples and advance the playhead by one block
+    void processBlock(const HostPosition& position, int blockSize, juce::MidiBuffer& midiMessages);
+
+    bool isFinished() const { return cursor >= events.size() && ! awaitingStreamedNotes; }
+
+    /// Emit note-offs for every note that has started but not yet ended, e.g. when this timeline is being replaced
+    void releaseSoundingNotes(juce::MidiBuffer& midiMessages);
+
+    /// Rewind to the start of the timeline so the sequence can be replayed
+    void reset();
+
+private:
+    void launch(const HostPosition& position);
+    void emit(const ScheduledEvent& event, int sampleOffset, juce::MidiBuffer& midiMessages);
+    static bool isEarlier(const ScheduledEvent& a, const ScheduledEvent& b);
+
+    std::vector<ScheduledEvent> events; // Sorted by beatPosition, note-offs before note-ons at the same position
+    size_t cursor = 0;                  // Index of the next event to emit
+    juce::uint32 nextNoteId = 0;        // Id of the next note inserted into the timeline
+    std::vector<juce::uint32> removedNoteIds; // Scratch space for removeNotes, reserved with the timeline
+
+    LaunchQuantization launchQuantization = LaunchQuantization::nextBeat;
+    bool launched = false;              // Set once the launch point has been resolved against the host transport
+    double playheadBeats = 0.0;         // Sequence position at the start of the next block; negative while waiting to launch
+    double anchorPpq = 0.0;             // Host ppq position that corresponds to beat 0 of the sequence
+
+    int sequenceId = 0;
+    bool awaitingStreamedNotes = false; // More notes may still be inserted, so reaching the end is not yet the finish
+    std::array<juce::uint8, 16 * 128> soundingNotes {}; // Started-but-not-ended count per channel/note
+};
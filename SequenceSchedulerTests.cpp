@@ -0,0 +1,159 @@
+#include "SequenceScheduler.h"
+
+/**
+ * SequenceSchedulerTests - juce::UnitTest coverage of edits to a playing timeline. Registered in the "Kiwi" category;
+ * run with juce::UnitTestRunner().runTestsInCategory("Kiwi").
+ */
+class SequenceSchedulerTests : public juce::UnitTest
+{
+public:
+    SequenceSchedulerTests() : juce::UnitTest("SequenceScheduler", "Kiwi") {}
+
+    void runTest() override
+    {
+        beginTest("A range edited after the playhead has passed it is not played as a chord");
+        {
+            SequenceScheduler scheduler;
+            scheduler.loadSequence({ makeNote(60, 0.0, 0.5), makeNote(62, 1.0, 1.5), makeNote(64, 2.0, 2.5), makeNote(65, 3.0, 3.5) });
+            scheduler.reserve(16);
+
+            // Play up to beat 2.75: the notes at beats 0, 1 and 2 have played
+            juce::MidiBuffer played;
+            scheduler.processBlock(position, beatsToSamples(2.75), played);
+            expectEquals(countNoteOns(played), 3);
+
+            // Regenerate beats 0-2, as spliceRegeneratedRange does
+            scheduler.removeNotes(0.0, 2.0);
+            expect(scheduler.insertNote(makeNote(67, 0.5, 1.0), false));
+            expect(scheduler.insertNote(makeNote(69, 1.5, 2.0), false));
+
+            // Only the untouched note at beat 3 is still to come
+            juce::MidiBuffer rest;
+            scheduler.processBlock(position, beatsToSamples(2.0), rest);
+            expectEquals(countNoteOns(rest), 1);
+            expect(scheduler.isFinished());
+        }
+
+        beginTest("A range edited before it plays is played at its own times");
+        {
+            SequenceScheduler scheduler;
+            scheduler.loadSequence({ makeNote(60, 0.0, 0.5), makeNote(62, 2.0, 2.5), makeNote(64, 3.0, 3.5) });
+            scheduler.reserve(16);
+
+            juce::MidiBuffer played;
+            scheduler.processBlock(position, beatsToSamples(1.0), played);
+            expectEquals(countNoteOns(played), 1);
+
+            scheduler.removeNotes(2.0, 4.0);
+            expect(scheduler.insertNote(makeNote(67, 2.0, 2.5), false));
+            expect(scheduler.insertNote(makeNote(69, 3.0, 3.5), false));
+
+            // Still one note-on per block, not both at the playhead
+            juce::MidiBuffer secondBeat, thirdBeat, fourthBeat;
+            scheduler.processBlock(position, beatsToSamples(1.0), secondBeat);
+            scheduler.processBlock(position, beatsToSamples(1.0), thirdBeat);
+            scheduler.processBlock(position, beatsToSamples(1.0), fourthBeat);
+            expectEquals(countNoteOns(secondBeat), 0);
+            expectEquals(countNoteOns(thirdBeat), 1);
+            expectEquals(countNoteOns(fourthBeat), 1);
+        }
+
+        beginTest("Removing a note keeps the note-off of an overlapping note of the same pitch");
+        {
+            SequenceScheduler scheduler;
+            scheduler.loadSequence({ makeNote(60, 0.0, 2.0), makeNote(60, 1.0, 3.0) });
+            scheduler.reserve(16);
+
+            juce::MidiBuffer played;
+            scheduler.processBlock(position, beatsToSamples(0.5), played);
+            expectEquals(countNoteOns(played), 1);
+
+            // The second note goes; the first, already sounding, still ends at beat 2
+            scheduler.removeNotes(1.0, 2.0);
+
+            juce::MidiBuffer untilBeatTwo, rest;
+            scheduler.processBlock(position, beatsToSamples(1.75), untilBeatTwo);
+            scheduler.processBlock(position, beatsToSamples(2.0), rest);
+            expectEquals(countNoteOns(untilBeatTwo), 0);
+            expectEquals(countNoteOffs(untilBeatTwo), 1);
+            expectEquals(countNoteOffs(rest), 0);
+            expect(scheduler.isFinished());
+        }
+
+        beginTest("A late streamed note still plays at the playhead");
+        {
+            SequenceScheduler scheduler;
+            scheduler.loadSequence({ makeNote(60, 0.0, 0.5) });
+            scheduler.reserve(16);
+            scheduler.beginStream();
+
+            juce::MidiBuffer played;
+            scheduler.processBlock(position, beatsToSamples(1.0), played);
+
+            expect(scheduler.insertNote(makeNote(62, 0.25, 0.75)));
+            juce::MidiBuffer late;
+            scheduler.processBlock(position, beatsToSamples(1.0), late);
+            expectEquals(countNoteOns(late), 1);
+        }
+
+        beginTest("A long-form section that arrives after its start plays the rest of its notes in time");
+        {
+            SequenceScheduler scheduler;
+            scheduler.loadSequence({ makeNote(60, 0.0, 1.0), makeNote(62, 2.0, 3.0) });
+            scheduler.reserve(16);
+            scheduler.beginStream();
+
+            // The first section has played and the playhead is halfway into the second one, which has not arrived
+            juce::MidiBuffer played;
+            scheduler.processBlock(position, beatsToSamples(5.5), played);
+            expectEquals(countNoteOns(played), 2);
+
+            // Section two arrives, as receiveLongFormSection appends it
+            for (double onBeats : { 4.0, 4.5, 5.0, 6.0, 7.0 })
+                expect(scheduler.insertNote(makeNote(64, onBeats, onBeats + 0.25), false));
+
+            // Its passed notes are dropped instead of sounding together at the playhead; the others keep their beats
+            juce::MidiBuffer atPlayhead, sixthBeat, seventhBeat;
+            scheduler.processBlock(position, beatsToSamples(0.25), atPlayhead);
+            scheduler.processBlock(position, beatsToSamples(1.0), sixthBeat);
+            scheduler.processBlock(position, beatsToSamples(1.0), seventhBeat);
+            expectEquals(countNoteOns(atPlayhead), 0);
+            expectEquals(countNoteOns(sixthBeat), 1);
+            expectEquals(countNoteOns(seventhBeat), 1);
+        }
+    }
+
+private:
+    static MidiNote makeNote(int pitch, double onBeats, double offBeats)
+    {
+        return MidiNote({ 1, pitch, 100 }, onBeats, offBeats);
+    }
+
+    static int beatsToSamples(double beats)
+    {
+        return (int) std::round(beats * 44100.0 * 60.0 / 120.0);
+    }
+
+    static int countNoteOns(const juce::MidiBuffer& buffer)
+    {
+        int numNoteOns = 0;
+        for (const auto metadata : buffer)
+            if (metadata.getMessage().isNoteOn())
+                ++numNoteOns;
+        return numNoteOns;
+    }
+
+    static int countNoteOffs(const juce::MidiBuffer& buffer)
+    {
+        int numNoteOffs = 0;
+        for (const auto metadata : buffer)
+            if (metadata.getMessage().isNoteOff())
+                ++numNoteOffs;
+        return numNoteOffs;
+    }
+
+    // Transport stopped at 120 bpm: the scheduler launches immediately and runs on its own clock
+    const SequenceScheduler::HostPosition position { 120.0, 44100.0 };
+};
+
+static SequenceSchedulerTests sequenceSchedulerTests;
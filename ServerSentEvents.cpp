@@ -0,0 +1,42 @@
+#include "ServerSentEvents.h"
+
+#define READ_CHUNK_BYTES 1024
+
+/**
+ * @brief Reads a text/event-stream body, calling onEvent with the parsed JSON payload of each "data:" line
+ * @param stream The response body
+ * @param onEvent Called with every payload that parses as a JSON object, in stream order
+ * @param shouldStop Checked between reads; reading ends when it returns true. May be empty
+ */
+void ServerSentEvents::read(juce::InputStream& stream, const std::function<void(const juce::var&)>& onEvent,
+                            const std::function<bool()>& shouldStop)
+{
+    std::string pendingBytes; // Raw bytes are split on newlines first so multi-byte UTF-8 characters are never cut in half
+    char buffer[READ_CHUNK_BYTES];
+
+    while (! stream.isExhausted() && ! (shouldStop && shouldStop()))
+    {
+        const int bytesRead = stream.read(buffer, (int) sizeof(buffer));
+        if (bytesRead <= 0)
+            break;
+
+        pendingBytes.append(buffer, (size_t) bytesRead);
+
+        for (auto lineEnd = pendingBytes.find('\n'); lineEnd != std::string::npos; lineEnd = pendingBytes.find('\n'))
+        {
+            const auto line = juce::String::fromUTF8(pendingBytes.data(), (int) lineEnd).trimEnd();
+            pendingBytes.erase(0, lineEnd + 1);
+
+            if (! line.startsWith("data:"))
+                continue; // Event names, comments and blank separators carry nothing we need
+
+            const auto data = line.substring(5).trim();
+            if (data == "[DONE]")
+                return;
+
+            auto event = juce::JSON::parse(data);
+            if (event.isObject())
+                onEvent(event);
+        }
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <JuceHeader.h>
+
+/**
+ * ServerSentEvents - Reads a text/event-stream response body, as sent by streaming model APIs.
+ *
+ * Only "data:" lines matter here: each one holds a JSON payload that is parsed and passed on as it arrives. Event
+ * names, comments and blank separators are skipped, and "data: [DONE]" ends the stream. Bytes are split into lines
+ * before they are decoded, so a multi-byte UTF-8 character that straddles two reads is never cut in half.
+ */
+namespace ServerSentEvents
+{
+    /// Read events until the stream ends, "[DONE]" arrives or shouldStop returns true. shouldStop is checked between
+    /// reads, so a cancelled request stops promptly; it may be empty
+    void read(juce::InputStream& stream, const std::function<void(const juce::var&)>& onEvent,
+              const std::function<bool()>& shouldStop = {});
+}
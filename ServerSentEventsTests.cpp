@@ -0,0 +1,163 @@
+#include "ServerSentEvents.h"
+#include "IncrementalNoteParser.h"
+#include "GenerationBackend.h"
+
+/**
+ * ServerSentEventsTests - juce::UnitTest coverage of the streaming path: canned server-sent event streams, delivered in
+ * small reads the way a network stream delivers them, go through ServerSentEvents, a backend's stream event reader and
+ * IncrementalNoteParser, as Generator chains them. Registered in the "Kiwi" category; run with
+ * juce::UnitTestRunner().runTestsInCategory("Kiwi").
+ */
+class ServerSentEventsTests : public juce::UnitTest
+{
+public:
+    ServerSentEventsTests() : juce::UnitTest("ServerSentEvents", "Kiwi") {}
+
+    void runTest() override
+    {
+        beginTest("A Responses API stream split across small reads plays its notes before the stream ends");
+        {
+            // The notes document arrives in deltas that cut through keys and numbers
+            const std::string stream =
+                "event: response.created\n"
+                "data: {\"type\":\"response.created\",\"response\":{\"instructions\":\"Composición en 4/4 \xe2\x80\x94 notas\"}}\n\n"
+                + deltaEvent("{\\\"notes\\\":[{\\\"start_beats\\\":0,\\\"dur")
+                + deltaEvent("ation_beats\\\":1,\\\"midi_note\\\":60,\\\"velocity\\\":90},[1,0.5,")
+                + ": keep-alive comment\n\n"
+                + deltaEvent("64,100]]}")
+                + "event: response.completed\n"
+                  "data: {\"type\":\"response.completed\",\"response\":{\"usage\":{\"output_tokens\":42}}}\n\n"
+                  "data: [DONE]\n\n"
+                + deltaEvent("[2,1,67,80]"); // Past [DONE]: never read
+
+            OpenAIResponsesBackend backend("openai", "https://example.invalid/v1/responses", "model", "key");
+            const auto result = runStream(backend, stream, 7);
+
+            expectEquals(result.numEvents, 5);
+            expectEquals(result.text, juce::String("{\"notes\":[{\"start_beats\":0,\"duration_beats\":1,\"midi_note\":60,\"velocity\":90},[1,0.5,64,100]]}"));
+            expectEquals((int) result.notes.size(), 2);
+            expectEquals((int) result.notes[0].pitch, 60);
+            expectEquals((int) result.notes[1].pitch, 64);
+            expectEquals(result.outputTokens, 42);
+            expect(result.streamOk);
+
+            // The first note was out once the second delta was in, before the last delta and the usage event
+            expectEquals(result.eventOfFirstNote, 3);
+        }
+
+        beginTest("A Chat Completions stream with CRLF line endings is read the same way");
+        {
+            const std::string stream =
+                "data: {\"choices\":[{\"delta\":{\"content\":\"{\\\"notes\\\":[[0,1,48,\"}}]}\r\n\r\n"
+                "data: {\"choices\":[{\"delta\":{\"content\":\"100]]}\"}}]}\r\n\r\n"
+                "data: {\"choices\":[],\"usage\":{\"completion_tokens\":9}}\r\n\r\n"
+                "data: [DONE]\r\n\r\n";
+
+            OpenAICompatibleBackend backend("local", "http://localhost:8080/v1/chat/completions", "local", {});
+            const auto result = runStream(backend, stream, 5);
+
+            expectEquals((int) result.notes.size(), 1);
+            expectEquals((int) result.notes[0].pitch, 48);
+            expectEquals(result.outputTokens, 9);
+            expect(result.streamOk);
+        }
+
+        beginTest("A failure event marks the stream as failed");
+        {
+            const std::string stream = deltaEvent("{\\\"notes\\\":[")
+                                     + "data: {\"type\":\"response.failed\",\"response\":{\"error\":{\"message\":\"overloaded\"}}}\n\n";
+
+            OpenAIResponsesBackend backend("openai", "https://example.invalid/v1/responses", "model", "key");
+            const auto result = runStream(backend, stream, 64);
+
+            expect(! result.streamOk);
+            expect(result.notes.empty());
+        }
+
+        beginTest("Reading stops between reads once asked to");
+        {
+            const std::string stream = deltaEvent("a") + deltaEvent("b") + deltaEvent("c");
+            ChunkedInputStream in(stream, 8);
+
+            int numEvents = 0;
+            ServerSentEvents::read(in, [&numEvents](const juce::var&) { ++numEvents; }, [&numEvents] { return numEvents > 0; });
+
+            expectEquals(numEvents, 1);
+            expect(! in.isExhausted());
+        }
+    }
+
+private:
+    /// Hands out a canned body at most chunkBytes at a time, like a network stream that receives it in pieces
+    class ChunkedInputStream : public juce::InputStream
+    {
+    public:
+        ChunkedInputStream(std::string bodyToServe, int maxBytesPerRead)
+            : body(std::move(bodyToServe)), chunkBytes(maxBytesPerRead) {}
+
+        juce::int64 getTotalLength() override { return -1; }
+        bool isExhausted() override { return position >= body.size(); }
+        juce::int64 getPosition() override { return (juce::int64) position; }
+        bool setPosition(juce::int64) override { return false; }
+
+        int read(void* destBuffer, int maxBytesToRead) override
+        {
+            const auto count = juce::jmin((size_t) juce::jmin(maxBytesToRead, chunkBytes), body.size() - position);
+            std::memcpy(destBuffer, body.data() + position, count);
+            position += count;
+            return (int) count;
+        }
+
+    private:
+        std::string body;
+        int chunkBytes;
+        size_t position = 0;
+    };
+
+    struct StreamResult
+    {
+        int numEvents = 0;
+        int eventOfFirstNote = 0; // 1-based index of the event whose delta completed the first note, 0 if none did
+        juce::String text;
+        std::vector<NoteSpec> notes;
+        int outputTokens = 0;
+        bool streamOk = true;
+    };
+
+    /// Runs a canned stream through the same chain as Generator's streaming attempt
+    static StreamResult runStream(const GenerationBackend& backend, const std::string& stream, int chunkBytes)
+    {
+        StreamResult result;
+        IncrementalNoteParser parser([&result](const NoteSpec& note)
+        {
+            if (result.notes.empty())
+                result.eventOfFirstNote = result.numEvents;
+            result.notes.push_back(note);
+        });
+
+        ChunkedInputStream in(stream, chunkBytes);
+        ServerSentEvents::read(in, [&](const juce::var& event)
+        {
+            ++result.numEvents;
+
+            juce::String delta;
+            result.streamOk = backend.readStreamEvent(event, delta) && result.streamOk;
+            if (const auto outputTokens = backend.readOutputTokens(event); outputTokens > 0)
+                result.outputTokens = outputTokens;
+
+            result.text << delta;
+            parser.feed(delta);
+        });
+
+        return result;
+    }
+
+    /// One response.output_text.delta event; text is already escaped for a JSON string
+    static std::string deltaEvent(const std::string& text)
+    {
+        return "event: response.output_text.delta\n"
+               "data: {\"type\":\"response.output_text.delta\",\"delta\":\"" + text + "\"}\n\n";
+    }
+};
+
+static ServerSentEventsTests serverSentEventsTests;